@@ -0,0 +1,500 @@
+/*
+ * Chaos-Game Point-Cloud Renderer for the Sierpinski Tetrahedron
+ * Renders the attractor of the four maps p -> (p + a_i) / 2 by iterating
+ * them in random order instead of ray marching a distance estimator
+ *
+ * - Every thread runs CHAOS_LANES independent chaos-game walkers with
+ *   xorshift128+ streams laid out structure-of-arrays, so the generator
+ *   loops compile to SIMD; each 64-bit draw picks the map for 32 steps
+ * - Points are splatted into a private depth + density buffer per thread,
+ *   so splatting needs no atomics; the buffers are then merged in
+ *   parallel, each thread owning a band of rows
+ * - The merged buffers are shaded from depth gradients into a PPM image,
+ *   and a prefix of the generated points can be exported as a binary PLY
+ *   point cloud
+ *
+ * Generation is ALU-cheap and splatting is random-access, so unlike the
+ * ray marchers this is bound by memory bandwidth and cache size.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <SDL2/SDL.h>
+
+// Walkers per thread; a multiple of the widest SIMD register in floats
+#define CHAOS_LANES 16
+// Map choices per 64-bit random draw (2 bits each)
+#define CHAOS_STEPS_PER_DRAW 32
+// Steps before a walker starts splatting; it is then within 2^-24 of
+// the attractor
+#define CHAOS_BURN_IN 24
+#define CHAOS_MAX_THREADS 64
+#define CAMERA_FOCAL 1.8f
+
+typedef struct {
+    uint64_t points;
+    int threads;
+    int width;
+    int height;
+    float yaw;
+    float pitch;
+    float distance;
+    uint64_t seed;
+    const char* imagePath;
+    const char* exportPath;
+    uint64_t exportPoints;
+} ChaosOptions;
+
+// Camera looking at the origin; q = (dot(p - pos, right), dot(p - pos, up),
+// dot(p - pos, back)) is in front of the camera when q.z < 0
+typedef struct {
+    float pos[3];
+    float right[3];
+    float up[3];
+    float back[3];
+    float scale;  // pixels per unit of uv (= image height)
+    float cx, cy;
+} ChaosCamera;
+
+typedef struct {
+    int index;
+    const ChaosOptions* opt;
+    const ChaosCamera* cam;
+    uint64_t points;
+    float* depth;
+    uint32_t* density;
+    float* exportXyz;
+    uint64_t exportCount;
+    double seconds;
+} ChaosWorker;
+
+typedef struct {
+    ChaosWorker* workers;
+    int workerCount;
+    int width;
+    int rowBegin;
+    int rowEnd;
+    float* depth;
+    uint32_t* density;
+} MergeTask;
+
+static double nowSeconds(void) {
+    return (double)SDL_GetPerformanceCounter() / (double)SDL_GetPerformanceFrequency();
+}
+
+static uint64_t splitMix64(uint64_t* state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+static void setupCamera(ChaosCamera* cam, const ChaosOptions* opt) {
+    float cy = cosf(opt->yaw), sy = sinf(opt->yaw);
+    float cp = cosf(opt->pitch), sp = sinf(opt->pitch);
+
+    cam->back[0] = sy * cp;
+    cam->back[1] = sp;
+    cam->back[2] = cy * cp;
+    for (int i = 0; i < 3; i++) {
+        cam->pos[i] = cam->back[i] * opt->distance;
+    }
+    // right = normalize(cross((0, 1, 0), back)), up = cross(back, right)
+    cam->right[0] = cy;
+    cam->right[1] = 0.0f;
+    cam->right[2] = -sy;
+    cam->up[0] = cam->back[1] * cam->right[2] - cam->back[2] * cam->right[1];
+    cam->up[1] = cam->back[2] * cam->right[0] - cam->back[0] * cam->right[2];
+    cam->up[2] = cam->back[0] * cam->right[1] - cam->back[1] * cam->right[0];
+
+    cam->scale = (float)opt->height;
+    cam->cx = 0.5f * (float)opt->width;
+    cam->cy = 0.5f * (float)opt->height;
+}
+
+// ---------------------------------------------------------------------------
+// Generation and splatting
+// ---------------------------------------------------------------------------
+
+static int chaosWorkerRun(void* data) {
+    ChaosWorker* w = (ChaosWorker*)data;
+    const ChaosCamera* cam = w->cam;
+    const int width = w->opt->width;
+    const float fw = (float)width;
+    const float fh = (float)w->opt->height;
+    const uint64_t draws = w->points / ((uint64_t)CHAOS_LANES * CHAOS_STEPS_PER_DRAW);
+
+    // Per-lane walker state, structure-of-arrays
+    uint64_t s0[CHAOS_LANES], s1[CHAOS_LANES];
+    uint32_t bitsLo[CHAOS_LANES], bitsHi[CHAOS_LANES];
+    float px[CHAOS_LANES], py[CHAOS_LANES], pz[CHAOS_LANES];
+    float depth[CHAOS_LANES];
+    int32_t pixel[CHAOS_LANES];
+
+    uint64_t seedState = w->opt->seed ^ ((uint64_t)w->index * 0xD1B54A32D192ED03ull);
+    for (int l = 0; l < CHAOS_LANES; l++) {
+        s0[l] = splitMix64(&seedState);
+        s1[l] = splitMix64(&seedState) | 1;
+        px[l] = py[l] = pz[l] = 0.0f;
+    }
+
+    double start = nowSeconds();
+    uint64_t exported = 0;
+
+    for (uint64_t draw = 0; draw <= draws; draw++) {
+        // xorshift128+, one 64-bit draw per lane
+        for (int l = 0; l < CHAOS_LANES; l++) {
+            uint64_t x = s0[l];
+            const uint64_t y = s1[l];
+            s0[l] = y;
+            x ^= x << 23;
+            s1[l] = x ^ y ^ (x >> 17) ^ (y >> 26);
+            uint64_t r = s1[l] + y;
+            bitsLo[l] = (uint32_t)r;
+            bitsHi[l] = (uint32_t)(r >> 32);
+        }
+
+        for (int step = 0; step < CHAOS_STEPS_PER_DRAW; step++) {
+            // 32-bit halves keep the lane loop in one vector element width
+            uint32_t* bits = step < CHAOS_STEPS_PER_DRAW / 2 ? bitsLo : bitsHi;
+
+            // Map k moves halfway to vertex a_k; the vertex signs are
+            // x: + - + -, y: + - - +, z: + + - - for k = 0..3
+            for (int l = 0; l < CHAOS_LANES; l++) {
+                uint32_t k = bits[l] & 3u;
+                bits[l] >>= 2;
+                float ax = 1.0f - 2.0f * (float)(k & 1u);
+                float ay = 1.0f - 2.0f * (float)((k ^ (k >> 1)) & 1u);
+                float az = 1.0f - 2.0f * (float)(k >> 1);
+                px[l] = 0.5f * (px[l] + ax);
+                py[l] = 0.5f * (py[l] + ay);
+                pz[l] = 0.5f * (pz[l] + az);
+
+                // Project with the renderer's camera: uv = FOCAL * q.xy / -q.z
+                float dx = px[l] - cam->pos[0];
+                float dy = py[l] - cam->pos[1];
+                float dz = pz[l] - cam->pos[2];
+                float qx = dx * cam->right[0] + dy * cam->right[1] + dz * cam->right[2];
+                float qy = dx * cam->up[0] + dy * cam->up[1] + dz * cam->up[2];
+                float qz = -(dx * cam->back[0] + dy * cam->back[1] + dz * cam->back[2]);
+                float inv = CAMERA_FOCAL * cam->scale / (qz > 1e-6f ? qz : 1e-6f);
+                float sx = cam->cx + qx * inv;
+                float sy = cam->cy - qy * inv;
+
+                // Branch-free so the lane loop vectorizes; coordinates are
+                // clamped before the int conversion, which must not overflow
+                int inside = (qz > 1e-6f) & (sx >= 0.0f) & (sy >= 0.0f) & (sx < fw) & (sy < fh);
+                float cx = sx > 0.0f ? (sx < fw - 1.0f ? sx : fw - 1.0f) : 0.0f;
+                float cy = sy > 0.0f ? (sy < fh - 1.0f ? sy : fh - 1.0f) : 0.0f;
+                int32_t ix = (int32_t)cx;
+                int32_t iy = (int32_t)cy;
+                pixel[l] = inside ? iy * width + ix : -1;
+                depth[l] = qz;
+            }
+
+            // Burn-in at the start; the last draw stops where the burn-in
+            // began so every walker splats exactly draws * 32 points
+            if (draw == draws && step >= CHAOS_BURN_IN) break;
+            if (draw == 0 && step < CHAOS_BURN_IN) continue;
+
+            // Scatter into this thread's private buffers
+            for (int l = 0; l < CHAOS_LANES; l++) {
+                int32_t p = pixel[l];
+                if (p < 0) continue;
+                w->density[p]++;
+                if (depth[l] < w->depth[p]) w->depth[p] = depth[l];
+            }
+
+            if (exported < w->exportCount) {
+                for (int l = 0; l < CHAOS_LANES && exported < w->exportCount; l++, exported++) {
+                    w->exportXyz[exported * 3 + 0] = px[l];
+                    w->exportXyz[exported * 3 + 1] = py[l];
+                    w->exportXyz[exported * 3 + 2] = pz[l];
+                }
+            }
+        }
+    }
+
+    // Only the points actually filled in go to the point cloud
+    w->exportCount = exported;
+    w->seconds = nowSeconds() - start;
+    return 0;
+}
+
+// Nearest depth and summed density over all workers for a band of rows
+static int mergeTaskRun(void* data) {
+    MergeTask* task = (MergeTask*)data;
+    size_t begin = (size_t)task->rowBegin * task->width;
+    size_t end = (size_t)task->rowEnd * task->width;
+
+    for (size_t i = begin; i < end; i++) {
+        float d = task->workers[0].depth[i];
+        uint32_t n = task->workers[0].density[i];
+        for (int t = 1; t < task->workerCount; t++) {
+            float dt = task->workers[t].depth[i];
+            d = dt < d ? dt : d;
+            n += task->workers[t].density[i];
+        }
+        task->depth[i] = d;
+        task->density[i] = n;
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Output
+// ---------------------------------------------------------------------------
+
+// Lambert shading from screen-space depth gradients, modulated by density
+static bool writeImage(const char* path, const float* depth, const uint32_t* density,
+                       int width, int height, uint64_t points) {
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "Could not open %s for writing\n", path);
+        return false;
+    }
+    fprintf(file, "P6\n%d %d\n255\n", width, height);
+
+    // Density of a pixel if every point landed on a uniformly covered image
+    float meanDensity = (float)points / ((float)width * (float)height);
+    const float light[3] = {0.45f, 0.55f, 0.70f};
+    unsigned char* row = (unsigned char*)malloc((size_t)width * 3);
+    if (!row) {
+        fclose(file);
+        return false;
+    }
+
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            size_t i = (size_t)y * width + x;
+            float r = 0.02f, g = 0.015f, b = 0.04f;
+
+            if (density[i] > 0) {
+                float d = depth[i];
+                float dl = (x > 0 && density[i - 1]) ? depth[i - 1] : d;
+                float dr = (x < width - 1 && density[i + 1]) ? depth[i + 1] : d;
+                float du = (y > 0 && density[i - width]) ? depth[i - width] : d;
+                float dd = (y < height - 1 && density[i + width]) ? depth[i + width] : d;
+
+                // Pixel footprint at this depth converts depth deltas to slopes
+                float footprint = d / (CAMERA_FOCAL * (float)height);
+                float gx = (dr - dl) / (2.0f * footprint);
+                float gy = (du - dd) / (2.0f * footprint);
+                float nx = -gx, ny = -gy, nz = 1.0f;
+                float len = sqrtf(nx * nx + ny * ny + nz * nz);
+                float lambert = (nx * light[0] + ny * light[1] + nz * light[2]) / len;
+                if (lambert < 0.0f) lambert = 0.0f;
+
+                float coverage = log2f(1.0f + (float)density[i] / meanDensity) * 0.25f;
+                if (coverage > 1.0f) coverage = 1.0f;
+                float fog = expf(-(d - 2.0f) * 0.35f);
+                if (fog > 1.0f) fog = 1.0f;
+
+                float shade = (0.15f + 0.85f * lambert) * (0.5f + 0.5f * coverage) * fog;
+                r = shade * 0.95f + 0.05f * coverage;
+                g = shade * 0.70f;
+                b = shade * 1.00f + 0.10f * coverage;
+            }
+
+            float c[3] = {r, g, b};
+            for (int k = 0; k < 3; k++) {
+                float v = powf(c[k] < 1.0f ? c[k] : 1.0f, 0.4545f);
+                row[x * 3 + k] = (unsigned char)(v * 255.0f + 0.5f);
+            }
+        }
+        fwrite(row, 1, (size_t)width * 3, file);
+    }
+
+    free(row);
+    return fclose(file) == 0;
+}
+
+static bool writePointCloud(const char* path, const ChaosWorker* workers, int workerCount) {
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "Could not open %s for writing\n", path);
+        return false;
+    }
+
+    uint64_t total = 0;
+    for (int t = 0; t < workerCount; t++) {
+        total += workers[t].exportCount;
+    }
+    fprintf(file, "ply\nformat binary_little_endian 1.0\n"
+                  "comment Sierpinski tetrahedron chaos game\n"
+                  "element vertex %llu\n"
+                  "property float x\nproperty float y\nproperty float z\nend_header\n",
+            (unsigned long long)total);
+
+    bool ok = true;
+    for (int t = 0; t < workerCount && ok; t++) {
+        size_t count = (size_t)workers[t].exportCount * 3;
+        ok = fwrite(workers[t].exportXyz, sizeof(float), count, file) == count;
+    }
+    return (fclose(file) == 0) && ok;
+}
+
+// ---------------------------------------------------------------------------
+// Driver
+// ---------------------------------------------------------------------------
+
+static void printUsage(const char* prog) {
+    fprintf(stderr, "Usage: %s [options]\n", prog);
+    fprintf(stderr, "  --points N          Points to generate, e.g. 200000000 (default)\n");
+    fprintf(stderr, "  --threads N         Worker threads (default: CPU count)\n");
+    fprintf(stderr, "  --size WxH          Image size (default 1024x1024)\n");
+    fprintf(stderr, "  --yaw R --pitch R   Camera angles in radians (default 0.6, 0.35)\n");
+    fprintf(stderr, "  --distance D        Camera distance (default 5.5)\n");
+    fprintf(stderr, "  --seed N            RNG seed\n");
+    fprintf(stderr, "  --output FILE       Image path (default chaos_game.ppm)\n");
+    fprintf(stderr, "  --export FILE       Write a binary PLY point cloud\n");
+    fprintf(stderr, "  --export-points N   Points in the export (default 1000000)\n");
+}
+
+int main(int argc, char* argv[]) {
+    ChaosOptions opt = {
+        200000000ull, SDL_GetCPUCount(), 1024, 1024, 0.6f, 0.35f, 5.5f,
+        0x5EED5EEDull, "chaos_game.ppm", NULL, 1000000ull
+    };
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--points") == 0 && i + 1 < argc) {
+            opt.points = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            opt.threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%dx%d", &opt.width, &opt.height) != 2) opt.width = 0;
+        } else if (strcmp(argv[i], "--yaw") == 0 && i + 1 < argc) {
+            opt.yaw = (float)atof(argv[++i]);
+        } else if (strcmp(argv[i], "--pitch") == 0 && i + 1 < argc) {
+            opt.pitch = (float)atof(argv[++i]);
+        } else if (strcmp(argv[i], "--distance") == 0 && i + 1 < argc) {
+            opt.distance = (float)atof(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            opt.seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            opt.imagePath = argv[++i];
+        } else if (strcmp(argv[i], "--export") == 0 && i + 1 < argc) {
+            opt.exportPath = argv[++i];
+        } else if (strcmp(argv[i], "--export-points") == 0 && i + 1 < argc) {
+            opt.exportPoints = strtoull(argv[++i], NULL, 10);
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (opt.threads < 1 || opt.threads > CHAOS_MAX_THREADS || opt.width < 1 || opt.height < 1 ||
+        opt.distance <= 1.8f || opt.points == 0) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    if (!opt.exportPath) opt.exportPoints = 0;
+    if (opt.exportPoints > opt.points) opt.exportPoints = opt.points;
+
+    ChaosCamera cam;
+    setupCamera(&cam, &opt);
+
+    size_t pixels = (size_t)opt.width * opt.height;
+    ChaosWorker workers[CHAOS_MAX_THREADS];
+    SDL_Thread* threads[CHAOS_MAX_THREADS];
+    const uint64_t batch = (uint64_t)CHAOS_LANES * CHAOS_STEPS_PER_DRAW;
+    uint64_t perThread = (opt.points / opt.threads + batch - 1) / batch * batch;
+    bool ok = true;
+
+    for (int t = 0; t < opt.threads; t++) {
+        ChaosWorker* w = &workers[t];
+        memset(w, 0, sizeof(*w));
+        w->index = t;
+        w->opt = &opt;
+        w->cam = &cam;
+        w->points = perThread;
+        w->depth = (float*)malloc(pixels * sizeof(float));
+        w->density = (uint32_t*)calloc(pixels, sizeof(uint32_t));
+        w->exportCount = opt.exportPoints / opt.threads + (t < (int)(opt.exportPoints % opt.threads) ? 1 : 0);
+        if (w->exportCount > w->points) w->exportCount = w->points;
+        w->exportXyz = w->exportCount ? (float*)malloc(w->exportCount * 3 * sizeof(float)) : NULL;
+        if (!w->depth || !w->density || (w->exportCount && !w->exportXyz)) {
+            ok = false;
+        } else {
+            for (size_t i = 0; i < pixels; i++) w->depth[i] = INFINITY;
+        }
+    }
+    float* depth = (float*)malloc(pixels * sizeof(float));
+    uint32_t* density = (uint32_t*)malloc(pixels * sizeof(uint32_t));
+    if (!ok || !depth || !density) {
+        fprintf(stderr, "Out of memory for %d x %dx%d splat buffers\n", opt.threads, opt.width, opt.height);
+        return 1;
+    }
+
+    uint64_t total = perThread * opt.threads;
+    printf("Chaos game: %.1f M points, %d threads x %d lanes, %dx%d\n",
+           total / 1e6, opt.threads, CHAOS_LANES, opt.width, opt.height);
+
+    // Generate and splat
+    double start = nowSeconds();
+    for (int t = 0; t < opt.threads; t++) {
+        threads[t] = SDL_CreateThread(chaosWorkerRun, "chaos", &workers[t]);
+        if (!threads[t]) chaosWorkerRun(&workers[t]);
+    }
+    for (int t = 0; t < opt.threads; t++) {
+        if (threads[t]) SDL_WaitThread(threads[t], NULL);
+    }
+    double generateSeconds = nowSeconds() - start;
+
+    // Merge private buffers, one band of rows per thread
+    MergeTask tasks[CHAOS_MAX_THREADS];
+    start = nowSeconds();
+    for (int t = 0; t < opt.threads; t++) {
+        MergeTask* task = &tasks[t];
+        task->workers = workers;
+        task->workerCount = opt.threads;
+        task->width = opt.width;
+        task->rowBegin = opt.height * t / opt.threads;
+        task->rowEnd = opt.height * (t + 1) / opt.threads;
+        task->depth = depth;
+        task->density = density;
+        threads[t] = SDL_CreateThread(mergeTaskRun, "merge", task);
+        if (!threads[t]) mergeTaskRun(task);
+    }
+    for (int t = 0; t < opt.threads; t++) {
+        if (threads[t]) SDL_WaitThread(threads[t], NULL);
+    }
+    double mergeSeconds = nowSeconds() - start;
+
+    double bufferMiB = (double)pixels * (sizeof(float) + sizeof(uint32_t)) * (opt.threads + 1) / (1024.0 * 1024.0);
+    printf("Generate + splat: %8.3f s  %8.1f Mpoints/s\n", generateSeconds, total / generateSeconds / 1e6);
+    for (int t = 0; t < opt.threads; t++) {
+        printf("  thread %-2d       %8.3f s  %8.1f Mpoints/s\n", t, workers[t].seconds,
+               workers[t].points / workers[t].seconds / 1e6);
+    }
+    printf("Merge:            %8.3f s  (%.1f MiB of splat buffers)\n", mergeSeconds, bufferMiB);
+
+    if (writeImage(opt.imagePath, depth, density, opt.width, opt.height, total)) {
+        printf("Image written to %s\n", opt.imagePath);
+    } else {
+        ok = false;
+    }
+    if (opt.exportPath) {
+        uint64_t exported = 0;
+        for (int t = 0; t < opt.threads; t++) exported += workers[t].exportCount;
+        if (writePointCloud(opt.exportPath, workers, opt.threads)) {
+            printf("Point cloud (%llu points) written to %s\n", (unsigned long long)exported, opt.exportPath);
+        } else {
+            fprintf(stderr, "Failed to write %s\n", opt.exportPath);
+            ok = false;
+        }
+    }
+
+    for (int t = 0; t < opt.threads; t++) {
+        free(workers[t].depth);
+        free(workers[t].density);
+        free(workers[t].exportXyz);
+    }
+    free(depth);
+    free(density);
+    return ok ? 0 : 1;
+}
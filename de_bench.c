@@ -0,0 +1,654 @@
+/*
+ * Distance-Estimator Microbenchmark
+ * Measures evaluations/second of every kernel in de_kernels.h
+ *
+ * - CPU: single-threaded C kernels over a fixed set of random points
+ * - GPU: GLSL kernels evaluated per fragment into an offscreen target,
+ *        timed with glFinish-fenced wall clock
+ *
+ * A second section compares the two primary-ray intersectors on the
+ * camera of sierpinski.c: sphere tracing with a DE kernel against the
+ * exact tetrahedron descent of ifs_tetra.h, reporting DE steps or
+ * visited nodes per ray, rays/second and how often the two agree.
+ *
+ * To benchmark Mesa's software rasterizer, run with
+ * LIBGL_ALWAYS_SOFTWARE=1 (and GALLIUM_DRIVER=llvmpipe if needed);
+ * the renderer string is printed so results can be told apart.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <SDL2/SDL.h>
+#include <GL/glew.h>
+#include <SDL2/SDL_opengl.h>
+#include "de_kernels.h"
+#include "ifs_tetra.h"
+
+#define CPU_POINT_COUNT (1 << 16)
+#define GPU_TARGET_SIZE 256
+#define TRACE_MAX_STEPS 256
+#define TRACE_MAX_DIST 20.0f
+
+const char* benchVertexShaderSource =
+"#version 330 core\n"
+"layout(location = 0) in vec2 position;\n"
+"void main() {\n"
+"    gl_Position = vec4(position, 0.0, 1.0);\n"
+"}\n";
+
+// Each fragment walks a dependent chain of points so the compiler can
+// neither hoist nor merge the kernel calls
+const char* benchFragmentShaderSource =
+"uniform int u_evals;\n"
+"uniform float u_seed;\n"
+"uniform vec2 u_resolution;\n"
+"out vec4 fragColor;\n"
+"void main() {\n"
+"    vec3 p = vec3(gl_FragCoord.xy / u_resolution * 3.0 - 1.5, u_seed);\n"
+"    vec3 orbitTrap;\n"
+"    float acc = 0.0;\n"
+"    for (int i = 0; i < u_evals; i++) {\n"
+"        float d = deKernel(p, orbitTrap);\n"
+"        acc += d;\n"
+"        p.z = fract(p.z * 0.5 + 0.37 + d * 1e-3) * 3.0 - 1.5;\n"
+"    }\n"
+"    fragColor = vec4(acc);\n"
+"}\n";
+
+// Primary-ray benchmark: same camera and march constants as sierpinski.c
+const char* traceFragmentShaderSource =
+"uniform vec2 u_resolution;\n"
+"out vec4 fragColor;\n"
+"float rayMarch(vec3 ro, vec3 rd, out int steps) {\n"
+"    float t = 0.0;\n"
+"    steps = 0;\n"
+"    for (int i = 0; i < 256; i++) {\n"
+"        vec3 orbitTrap;\n"
+"        float dist = deKernel(ro + rd * t, orbitTrap);\n"
+"        steps++;\n"
+"        if (dist < 0.001) return t;\n"
+"        t += dist * 0.5;\n"
+"        if (t > 20.0) break;\n"
+"    }\n"
+"    return -1.0;\n"
+"}\n"
+"void main() {\n"
+"    vec2 uv = (gl_FragCoord.xy - 0.5 * u_resolution) / u_resolution.y;\n"
+"    float c = cos(0.5), s = sin(0.5);\n"
+"    mat3 rot = mat3(c, 0.0, s, 0.0, 1.0, 0.0, -s, 0.0, c);\n"
+"    vec3 ro = rot * vec3(0.0, 0.0, 4.5);\n"
+"    vec3 rd = rot * normalize(vec3(-uv.x, uv.y, -1.5));\n"
+"    int steps;\n"
+"#ifdef EXACT_INTERSECTOR\n"
+"    vec3 normal;\n"
+"    float t = intersectSierpinski(ro, rd, 20.0, normal, steps);\n"
+"#else\n"
+"    float t = rayMarch(ro, rd, steps);\n"
+"#endif\n"
+"    fragColor = vec4(t, float(steps), 0.0, 1.0);\n"
+"}\n";
+
+typedef struct {
+    int kernel;
+    int iterations;
+    int levels;
+    int gpuEvalsPerPixel;
+    double minSeconds;
+    bool runCpu;
+    bool runGpu;
+    bool runKernels;
+    bool runTrace;
+} BenchOptions;
+
+typedef struct {
+    SDL_Window* window;
+    SDL_GLContext context;
+    GLuint fbo, tex, vao, vbo;
+} GpuState;
+
+static double nowSeconds(void) {
+    return (double)SDL_GetPerformanceCounter() / (double)SDL_GetPerformanceFrequency();
+}
+
+// ---------------------------------------------------------------------------
+// CPU benchmark
+// ---------------------------------------------------------------------------
+
+static void makeRandomPoints(DEVec3* points, int count) {
+    unsigned int state = 0x9E3779B9u;
+    for (int i = 0; i < count; i++) {
+        float v[3];
+        for (int k = 0; k < 3; k++) {
+            state = state * 1664525u + 1013904223u;
+            v[k] = ((state >> 8) / 16777216.0f) * 3.0f - 1.5f;
+        }
+        points[i].x = v[0];
+        points[i].y = v[1];
+        points[i].z = v[2];
+    }
+}
+
+// Sink for kernel results so the compiler cannot drop the evaluations
+volatile double benchSink;
+
+// Returns evaluations per second
+static double benchCpuKernel(const DEKernel* kernel, const DEVec3* points, int count,
+                             const BenchOptions* opt) {
+    double sum = 0.0;
+    long long evals = 0;
+    double start = nowSeconds();
+    double elapsed = 0.0;
+
+    do {
+        for (int i = 0; i < count; i++) {
+            sum += kernel->evaluate(points[i], opt->iterations);
+        }
+        evals += count;
+        elapsed = nowSeconds() - start;
+    } while (elapsed < opt->minSeconds);
+
+    benchSink = sum;
+    return (double)evals / elapsed;
+}
+
+// Largest absolute disagreement with the reference (first) kernel
+static float maxKernelError(const DEKernel* kernel, const DEVec3* points, int count, int iterations) {
+    float maxErr = 0.0f;
+    for (int i = 0; i < count; i++) {
+        float ref = deKernels[0].evaluate(points[i], iterations);
+        float err = fabsf(kernel->evaluate(points[i], iterations) - ref);
+        if (err > maxErr) maxErr = err;
+    }
+    return maxErr;
+}
+
+// ---------------------------------------------------------------------------
+// GPU benchmark
+// ---------------------------------------------------------------------------
+
+static GLuint compileShader(GLenum type, const char** sources, int count) {
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, count, sources, NULL);
+    glCompileShader(shader);
+
+    GLint success;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        char infoLog[1024];
+        glGetShaderInfoLog(shader, 1024, NULL, infoLog);
+        fprintf(stderr, "Shader compilation failed:\n%s\n", infoLog);
+        glDeleteShader(shader);
+        return 0;
+    }
+
+    return shader;
+}
+
+// Kernel + intersector + body; levels < 0 selects ray marching
+static GLuint createBenchProgram(const DEKernel* kernel, int iterations, int levels, const char* body) {
+    char prelude[128];
+    if (levels >= 0) {
+        snprintf(prelude, sizeof(prelude),
+                 "#version 330 core\n#define DE_ITERATIONS %d\n#define IFS_LEVELS %d\n#define EXACT_INTERSECTOR\n",
+                 iterations, levels);
+    } else {
+        snprintf(prelude, sizeof(prelude), "#version 330 core\n#define DE_ITERATIONS %d\n", iterations);
+    }
+
+    const char* fragSrcs[] = { prelude, kernel->glslSource, ifsGlslIntersector, body };
+    GLuint vertShader = compileShader(GL_VERTEX_SHADER, &benchVertexShaderSource, 1);
+    GLuint fragShader = compileShader(GL_FRAGMENT_SHADER, fragSrcs, 4);
+    if (!vertShader || !fragShader) {
+        return 0;
+    }
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertShader);
+    glAttachShader(program, fragShader);
+    glLinkProgram(program);
+    glDeleteShader(vertShader);
+    glDeleteShader(fragShader);
+
+    GLint success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        char infoLog[1024];
+        glGetProgramInfoLog(program, 1024, NULL, infoLog);
+        fprintf(stderr, "Program linking failed:\n%s\n", infoLog);
+        glDeleteProgram(program);
+        return 0;
+    }
+
+    return program;
+}
+
+// Returns evaluations per second, or 0 on failure
+static double benchGpuKernel(const DEKernel* kernel, const BenchOptions* opt, GLuint vao) {
+    GLuint program = createBenchProgram(kernel, opt->iterations, -1, benchFragmentShaderSource);
+    if (!program) {
+        return 0.0;
+    }
+
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "u_evals"), opt->gpuEvalsPerPixel);
+    glUniform2f(glGetUniformLocation(program, "u_resolution"), GPU_TARGET_SIZE, GPU_TARGET_SIZE);
+    GLint seedLocation = glGetUniformLocation(program, "u_seed");
+    glBindVertexArray(vao);
+
+    // Warm-up draw absorbs driver-side shader specialization
+    glUniform1f(seedLocation, 0.0f);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glFinish();
+
+    // Wall clock around glFinish rather than GL_TIME_ELAPSED: software
+    // drivers such as llvmpipe defer rasterization past the query end
+    long long draws = 0;
+    double gpuSeconds = 0.0;
+    double start = nowSeconds();
+    do {
+        glUniform1f(seedLocation, (float)(draws % 97) * 0.01f);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        glFinish();
+        draws++;
+        gpuSeconds = nowSeconds() - start;
+    } while (gpuSeconds < opt->minSeconds);
+
+    glBindVertexArray(0);
+    glUseProgram(0);
+    glDeleteProgram(program);
+
+    if (gpuSeconds <= 0.0) {
+        return 0.0;
+    }
+    double evals = (double)GPU_TARGET_SIZE * GPU_TARGET_SIZE * opt->gpuEvalsPerPixel * (double)draws;
+    return evals / gpuSeconds;
+}
+
+// Creates a hidden window + context with an offscreen RG32F target bound
+static bool initGpu(GpuState* gpu) {
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+
+    gpu->window = SDL_CreateWindow("DE benchmark", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
+                               64, 64, SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN);
+    if (!gpu->window) {
+        fprintf(stderr, "Window creation failed: %s\n", SDL_GetError());
+        return false;
+    }
+
+    gpu->context = SDL_GL_CreateContext(gpu->window);
+    if (!gpu->context) {
+        fprintf(stderr, "OpenGL context creation failed: %s\n", SDL_GetError());
+        return false;
+    }
+
+    glewExperimental = GL_TRUE;
+    GLenum glewError = glewInit();
+    if (glewError != GLEW_OK) {
+        fprintf(stderr, "GLEW initialization failed: %s\n", glewGetErrorString(glewError));
+        return false;
+    }
+
+    glGenTextures(1, &gpu->tex);
+    glBindTexture(GL_TEXTURE_2D, gpu->tex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, GPU_TARGET_SIZE, GPU_TARGET_SIZE, 0, GL_RG, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glGenFramebuffers(1, &gpu->fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, gpu->fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gpu->tex, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "Offscreen framebuffer incomplete\n");
+        return false;
+    }
+    glViewport(0, 0, GPU_TARGET_SIZE, GPU_TARGET_SIZE);
+
+    float quadVertices[] = {
+        -1.0f, -1.0f,
+         1.0f, -1.0f,
+        -1.0f,  1.0f,
+         1.0f,  1.0f
+    };
+    glGenVertexArrays(1, &gpu->vao);
+    glGenBuffers(1, &gpu->vbo);
+    glBindVertexArray(gpu->vao);
+    glBindBuffer(GL_ARRAY_BUFFER, gpu->vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glBindVertexArray(0);
+
+    return true;
+}
+
+static void shutdownGpu(GpuState* gpu) {
+    if (gpu->context) {
+        glDeleteVertexArrays(1, &gpu->vao);
+        glDeleteBuffers(1, &gpu->vbo);
+        glDeleteFramebuffers(1, &gpu->fbo);
+        glDeleteTextures(1, &gpu->tex);
+        SDL_GL_DeleteContext(gpu->context);
+    }
+    if (gpu->window) SDL_DestroyWindow(gpu->window);
+}
+
+// ---------------------------------------------------------------------------
+// Intersector benchmark
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    double raysPerSecond;
+    double stepsPerRay;     // DE evaluations (march) or visited nodes (exact)
+    float* t;               // hit distance per pixel, -1 on miss
+} TraceResult;
+
+// Camera of the trace shader, rotated half a radian for a generic view
+static void traceCameraRay(int x, int y, int size, DEVec3* ro, DEVec3* rd) {
+    float u = ((float)x + 0.5f - 0.5f * size) / size;
+    float v = ((float)y + 0.5f - 0.5f * size) / size;
+    float c = cosf(0.5f), s = sinf(0.5f);
+    float len = sqrtf(u * u + v * v + 1.5f * 1.5f);
+    float dx = -u / len, dy = v / len, dz = -1.5f / len;
+
+    ro->x = -s * 4.5f;
+    ro->y = 0.0f;
+    ro->z = c * 4.5f;
+    rd->x = c * dx - s * dz;
+    rd->y = dy;
+    rd->z = s * dx + c * dz;
+}
+
+static float cpuRayMarch(const DEKernel* kernel, int iterations, DEVec3 ro, DEVec3 rd, int* steps) {
+    float t = 0.0f;
+    *steps = 0;
+    for (int i = 0; i < TRACE_MAX_STEPS; i++) {
+        DEVec3 p = { ro.x + rd.x * t, ro.y + rd.y * t, ro.z + rd.z * t };
+        float dist = kernel->evaluate(p, iterations);
+        (*steps)++;
+        if (dist < 0.001f) return t;
+        t += dist * 0.5f;
+        if (t > TRACE_MAX_DIST) break;
+    }
+    return -1.0f;
+}
+
+static void benchCpuTrace(const DEKernel* kernel, const BenchOptions* opt, bool exact, TraceResult* result) {
+    const int size = GPU_TARGET_SIZE;
+    long long rays = 0, steps = 0;
+    double start = nowSeconds();
+    double elapsed;
+
+    do {
+        for (int y = 0; y < size; y++) {
+            for (int x = 0; x < size; x++) {
+                DEVec3 ro, rd;
+                int raySteps;
+                float t;
+                traceCameraRay(x, y, size, &ro, &rd);
+                if (exact) {
+                    IFSHit hit;
+                    t = ifsIntersect(ro, rd, opt->levels, TRACE_MAX_DIST, &hit) ? hit.t : -1.0f;
+                    raySteps = hit.nodesVisited;
+                } else {
+                    t = cpuRayMarch(kernel, opt->iterations, ro, rd, &raySteps);
+                }
+                result->t[y * size + x] = t;
+                steps += raySteps;
+            }
+        }
+        rays += (long long)size * size;
+        elapsed = nowSeconds() - start;
+    } while (elapsed < opt->minSeconds);
+
+    result->raysPerSecond = (double)rays / elapsed;
+    result->stepsPerRay = (double)steps / (double)rays;
+}
+
+static bool benchGpuTrace(const DEKernel* kernel, const BenchOptions* opt, bool exact,
+                          const GpuState* gpu, TraceResult* result) {
+    const int size = GPU_TARGET_SIZE;
+    GLuint program = createBenchProgram(kernel, opt->iterations, exact ? opt->levels : -1,
+                                        traceFragmentShaderSource);
+    if (!program) {
+        return false;
+    }
+
+    glUseProgram(program);
+    glUniform2f(glGetUniformLocation(program, "u_resolution"), (float)size, (float)size);
+    glBindVertexArray(gpu->vao);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glFinish();
+
+    long long frames = 0;
+    double elapsed;
+    double start = nowSeconds();
+    do {
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        glFinish();
+        frames++;
+        elapsed = nowSeconds() - start;
+    } while (elapsed < opt->minSeconds);
+
+    // Read back (t, steps) to report per-ray cost and agreement
+    float* pixels = (float*)malloc(sizeof(float) * 2 * size * size);
+    double steps = 0.0;
+    if (pixels) {
+        glReadPixels(0, 0, size, size, GL_RG, GL_FLOAT, pixels);
+        for (int i = 0; i < size * size; i++) {
+            result->t[i] = pixels[2 * i];
+            steps += pixels[2 * i + 1];
+        }
+        free(pixels);
+    }
+
+    glBindVertexArray(0);
+    glUseProgram(0);
+    glDeleteProgram(program);
+
+    result->raysPerSecond = (double)frames * size * size / elapsed;
+    result->stepsPerRay = steps / ((double)size * size);
+    return true;
+}
+
+// Fraction of pixels where both agree on hit/miss, and mean |dt| on common hits
+static void compareTraces(const TraceResult* a, const TraceResult* b, int count,
+                          double* agreement, double* meanDelta) {
+    int agree = 0, both = 0;
+    double delta = 0.0;
+    for (int i = 0; i < count; i++) {
+        bool hitA = a->t[i] >= 0.0f, hitB = b->t[i] >= 0.0f;
+        if (hitA == hitB) agree++;
+        if (hitA && hitB) {
+            delta += fabs((double)a->t[i] - (double)b->t[i]);
+            both++;
+        }
+    }
+    *agreement = (double)agree / count;
+    *meanDelta = both ? delta / both : 0.0;
+}
+
+static void printTraceRow(const char* device, const char* method, const TraceResult* r) {
+    printf("%-4s %-7s %12.3f Mrays/s %10.1f steps/ray\n", device, method, r->raysPerSecond * 1e-6, r->stepsPerRay);
+}
+
+static void runTraceBenchmark(const BenchOptions* opt, const GpuState* gpu) {
+    const int count = GPU_TARGET_SIZE * GPU_TARGET_SIZE;
+    int k = opt->kernel >= 0 ? opt->kernel : deKernelFind("plane-fold");
+    TraceResult march = {0}, exact = {0};
+    double agreement, meanDelta;
+
+    march.t = (float*)malloc(sizeof(float) * count);
+    exact.t = (float*)malloc(sizeof(float) * count);
+    if (!march.t || !exact.t) {
+        fprintf(stderr, "Out of memory\n");
+        free(march.t);
+        free(exact.t);
+        return;
+    }
+
+    printf("Primary rays: %dx%d, march with %s (%d iterations) vs exact descent (%d levels)\n",
+           GPU_TARGET_SIZE, GPU_TARGET_SIZE, deKernels[k].name, opt->iterations, opt->levels);
+
+    if (opt->runCpu) {
+        benchCpuTrace(&deKernels[k], opt, false, &march);
+        benchCpuTrace(&deKernels[k], opt, true, &exact);
+        compareTraces(&march, &exact, count, &agreement, &meanDelta);
+        printTraceRow("CPU", "march", &march);
+        printTraceRow("CPU", "exact", &exact);
+        printf("CPU  speedup %.2fx, hit agreement %.2f%%, mean |dt| %.2e\n\n",
+               exact.raysPerSecond / march.raysPerSecond, agreement * 100.0, meanDelta);
+    }
+
+    if (opt->runGpu && benchGpuTrace(&deKernels[k], opt, false, gpu, &march) &&
+        benchGpuTrace(&deKernels[k], opt, true, gpu, &exact)) {
+        compareTraces(&march, &exact, count, &agreement, &meanDelta);
+        printTraceRow("GPU", "march", &march);
+        printTraceRow("GPU", "exact", &exact);
+        printf("GPU  speedup %.2fx, hit agreement %.2f%%, mean |dt| %.2e\n\n",
+               exact.raysPerSecond / march.raysPerSecond, agreement * 100.0, meanDelta);
+    }
+
+    free(march.t);
+    free(exact.t);
+}
+
+// ---------------------------------------------------------------------------
+// DE kernel benchmark
+// ---------------------------------------------------------------------------
+
+static void runKernelBenchmark(const BenchOptions* opt, const GpuState* gpu) {
+    double cpuRate[DE_KERNEL_COUNT] = {0};
+    double gpuRate[DE_KERNEL_COUNT] = {0};
+    float cpuError[DE_KERNEL_COUNT] = {0};
+
+    printf("DE kernels (%d iterations per evaluation)\n", opt->iterations);
+
+    if (opt->runCpu) {
+        DEVec3* points = (DEVec3*)malloc(sizeof(DEVec3) * CPU_POINT_COUNT);
+        if (!points) {
+            fprintf(stderr, "Out of memory\n");
+            return;
+        }
+        makeRandomPoints(points, CPU_POINT_COUNT);
+
+        for (int k = 0; k < DE_KERNEL_COUNT; k++) {
+            if (opt->kernel >= 0 && k != opt->kernel) continue;
+            cpuRate[k] = benchCpuKernel(&deKernels[k], points, CPU_POINT_COUNT, opt);
+            cpuError[k] = maxKernelError(&deKernels[k], points, CPU_POINT_COUNT, opt->iterations);
+            printf("CPU  %-18s %9.2f Mevals/s\n", deKernels[k].name, cpuRate[k] * 1e-6);
+        }
+        free(points);
+    }
+
+    if (opt->runGpu) {
+        glBindVertexArray(gpu->vao);
+        for (int k = 0; k < DE_KERNEL_COUNT; k++) {
+            if (opt->kernel >= 0 && k != opt->kernel) continue;
+            gpuRate[k] = benchGpuKernel(&deKernels[k], opt, gpu->vao);
+            printf("GPU  %-18s %9.2f Mevals/s\n", deKernels[k].name, gpuRate[k] * 1e-6);
+        }
+    }
+    printf("\n");
+
+    // Summary relative to the reference kernel
+    if (opt->kernel >= 0) {
+        return;
+    }
+    printf("%-18s %14s %14s %12s\n", "Kernel", "CPU speedup", "GPU speedup", "max |err|");
+    for (int k = 0; k < DE_KERNEL_COUNT; k++) {
+        char cpuText[32] = "-", gpuText[32] = "-", errText[32] = "-";
+        if (opt->runCpu && cpuRate[0] > 0.0) {
+            snprintf(cpuText, sizeof(cpuText), "%.2fx", cpuRate[k] / cpuRate[0]);
+            snprintf(errText, sizeof(errText), "%.2e", cpuError[k]);
+        }
+        if (opt->runGpu && gpuRate[0] > 0.0) {
+            snprintf(gpuText, sizeof(gpuText), "%.2fx", gpuRate[k] / gpuRate[0]);
+        }
+        printf("%-18s %14s %14s %12s\n", deKernels[k].name, cpuText, gpuText, errText);
+    }
+    printf("\n");
+}
+
+static void printUsage(const char* prog) {
+    printf("Usage: %s [options]\n", prog);
+    printf("  --kernel NAME    Only benchmark this kernel (default: all)\n");
+    printf("  --iterations N   Fractal iterations per evaluation (default 12)\n");
+    printf("  --levels N       Exact intersector depth (default: iterations)\n");
+    printf("  --gpu-evals N    DE evaluations per pixel per draw (default 64)\n");
+    printf("  --seconds S      Minimum run time per measurement (default 1.0)\n");
+    printf("  --cpu-only       Skip the OpenGL benchmark\n");
+    printf("  --gpu-only       Skip the CPU benchmark\n");
+    printf("  --kernels-only   Skip the intersector benchmark\n");
+    printf("  --trace-only     Skip the DE kernel benchmark\n");
+}
+
+int main(int argc, char* argv[]) {
+    BenchOptions opt = { -1, 12, -1, 64, 1.0, true, true, true, true };
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--kernel") == 0 && i + 1 < argc) {
+            opt.kernel = deKernelFind(argv[++i]);
+            if (opt.kernel < 0) {
+                fprintf(stderr, "Unknown DE kernel '%s'. Available kernels:\n", argv[i]);
+                deKernelPrintList(stderr);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            opt.iterations = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--levels") == 0 && i + 1 < argc) {
+            opt.levels = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--gpu-evals") == 0 && i + 1 < argc) {
+            opt.gpuEvalsPerPixel = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            opt.minSeconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--cpu-only") == 0) {
+            opt.runGpu = false;
+        } else if (strcmp(argv[i], "--gpu-only") == 0) {
+            opt.runCpu = false;
+        } else if (strcmp(argv[i], "--kernels-only") == 0) {
+            opt.runTrace = false;
+        } else if (strcmp(argv[i], "--trace-only") == 0) {
+            opt.runKernels = false;
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (opt.levels < 0) {
+        opt.levels = opt.iterations;
+    }
+    if (opt.iterations < 1 || opt.levels > IFS_MAX_LEVELS || opt.gpuEvalsPerPixel < 1 || opt.minSeconds <= 0.0) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    if (SDL_Init(SDL_INIT_VIDEO) < 0) {
+        fprintf(stderr, "SDL initialization failed: %s\n", SDL_GetError());
+        return 1;
+    }
+
+    GpuState gpu = {0};
+    if (opt.runGpu) {
+        if (initGpu(&gpu)) {
+            printf("GPU renderer: %s (%s)\n\n", glGetString(GL_RENDERER), glGetString(GL_VERSION));
+        } else {
+            opt.runGpu = false;
+        }
+    }
+
+    if (opt.runKernels) {
+        runKernelBenchmark(&opt, &gpu);
+    }
+    if (opt.runTrace) {
+        runTraceBenchmark(&opt, &gpu);
+    }
+
+    shutdownGpu(&gpu);
+    SDL_Quit();
+    return 0;
+}
@@ -0,0 +1,203 @@
+/*
+ * Distance-estimator kernel library for the Sierpinski tetrahedron
+ *
+ * The same fractal can be estimated several ways with very different
+ * per-iteration costs. Every kernel is provided twice:
+ *
+ * - as GLSL source defining `float deKernel(vec3 p, out vec3 orbitTrap)`,
+ *   which expects the host to `#define DE_ITERATIONS n` before it, and
+ * - as a C function returning the same distance bound, for CPU tools
+ *   and the microbenchmark (de_bench.c).
+ *
+ * All kernels return the unscaled bound |z_n| * 2^-n, where z_n is the
+ * point after n scale-by-2 steps towards the nearest vertex. Callers
+ * apply their own safety factor. Orbit traps are identical across
+ * kernels because each fold is a signed coordinate permutation.
+ */
+
+#ifndef DE_KERNELS_H
+#define DE_KERNELS_H
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+typedef struct {
+    float x, y, z;
+} DEVec3;
+
+typedef float (*DEKernelFn)(DEVec3 p, int iterations);
+
+typedef struct {
+    const char* name;
+    const char* description;
+    const char* glslSource;
+    DEKernelFn evaluate;
+} DEKernel;
+
+// ---------------------------------------------------------------------------
+// GLSL kernels
+// ---------------------------------------------------------------------------
+
+// Shared orbit trap update, applied after every scale step
+#define DE_GLSL_ORBIT_TRAP(z) \
+"        orbitTrap.x = min(orbitTrap.x, length(" z "));\n" \
+"        orbitTrap.y = min(orbitTrap.y, abs(" z ".x) + abs(" z ".y) + abs(" z ".z));\n" \
+"        orbitTrap.z = min(orbitTrap.z, dot(" z ", " z "));\n"
+
+static const char deGlslNearestVertex[] =
+"// DE kernel: nearest vertex by Euclidean distance (4 sqrt + pow)\n"
+"float deKernel(vec3 p, out vec3 orbitTrap) {\n"
+"    const vec3 a1 = vec3(1.0, 1.0, 1.0);\n"
+"    const vec3 a2 = vec3(-1.0, -1.0, 1.0);\n"
+"    const vec3 a3 = vec3(1.0, -1.0, -1.0);\n"
+"    const vec3 a4 = vec3(-1.0, 1.0, -1.0);\n"
+"    vec3 c;\n"
+"    float dist, d;\n"
+"    int n = 0;\n"
+"    orbitTrap = vec3(1e10);\n"
+"    for (n = 0; n < DE_ITERATIONS; n++) {\n"
+"        c = a1; dist = length(p - a1);\n"
+"        d = length(p - a2); if (d < dist) { c = a2; dist = d; }\n"
+"        d = length(p - a3); if (d < dist) { c = a3; dist = d; }\n"
+"        d = length(p - a4); if (d < dist) { c = a4; dist = d; }\n"
+"        p = 2.0 * p - c;\n"
+DE_GLSL_ORBIT_TRAP("p")
+"    }\n"
+"    return length(p) * pow(2.0, float(-n));\n"
+"}\n";
+
+static const char deGlslSquaredDistance[] =
+"// DE kernel: nearest vertex by squared distance (no sqrt in the loop)\n"
+"float deKernel(vec3 p, out vec3 orbitTrap) {\n"
+"    const vec3 a1 = vec3(1.0, 1.0, 1.0);\n"
+"    const vec3 a2 = vec3(-1.0, -1.0, 1.0);\n"
+"    const vec3 a3 = vec3(1.0, -1.0, -1.0);\n"
+"    const vec3 a4 = vec3(-1.0, 1.0, -1.0);\n"
+"    vec3 c, v;\n"
+"    float dist, d;\n"
+"    orbitTrap = vec3(1e10);\n"
+"    for (int n = 0; n < DE_ITERATIONS; n++) {\n"
+"        v = p - a1; c = a1; dist = dot(v, v);\n"
+"        v = p - a2; d = dot(v, v); if (d < dist) { c = a2; dist = d; }\n"
+"        v = p - a3; d = dot(v, v); if (d < dist) { c = a3; dist = d; }\n"
+"        v = p - a4; d = dot(v, v); if (d < dist) { c = a4; dist = d; }\n"
+"        p = 2.0 * p - c;\n"
+DE_GLSL_ORBIT_TRAP("p")
+"    }\n"
+"    return length(p) * exp2(-float(DE_ITERATIONS));\n"
+"}\n";
+
+static const char deGlslPlaneFold[] =
+"// DE kernel: tetrahedral plane folds (branchy, no distance compares)\n"
+"float deKernel(vec3 z, out vec3 orbitTrap) {\n"
+"    orbitTrap = vec3(1e10);\n"
+"    for (int n = 0; n < DE_ITERATIONS; n++) {\n"
+"        // Tetrahedral folding symmetry\n"
+"        if (z.x + z.y < 0.0) z.xy = -z.yx;\n"
+"        if (z.x + z.z < 0.0) z.xz = -z.zx;\n"
+"        if (z.y + z.z < 0.0) z.zy = -z.yz;\n"
+"        \n"
+"        // Additional fold for more detail\n"
+"        if (z.x - z.y < 0.0) z.xy = z.yx;\n"
+"        \n"
+"        z = z * 2.0 - 1.0;\n"
+DE_GLSL_ORBIT_TRAP("z")
+"    }\n"
+"    return length(z) * exp2(-float(DE_ITERATIONS));\n"
+"}\n";
+
+// ---------------------------------------------------------------------------
+// C kernels (distance only)
+// ---------------------------------------------------------------------------
+
+static const DEVec3 deVertices[4] = {
+    { 1.0f,  1.0f,  1.0f},
+    {-1.0f, -1.0f,  1.0f},
+    { 1.0f, -1.0f, -1.0f},
+    {-1.0f,  1.0f, -1.0f}
+};
+
+static float deNearestVertex(DEVec3 p, int iterations) {
+    int n;
+    for (n = 0; n < iterations; n++) {
+        int best = 0;
+        float dist = 0.0f;
+        for (int i = 0; i < 4; i++) {
+            float dx = p.x - deVertices[i].x;
+            float dy = p.y - deVertices[i].y;
+            float dz = p.z - deVertices[i].z;
+            float d = sqrtf(dx * dx + dy * dy + dz * dz);
+            if (i == 0 || d < dist) { best = i; dist = d; }
+        }
+        p.x = 2.0f * p.x - deVertices[best].x;
+        p.y = 2.0f * p.y - deVertices[best].y;
+        p.z = 2.0f * p.z - deVertices[best].z;
+    }
+    return sqrtf(p.x * p.x + p.y * p.y + p.z * p.z) * powf(2.0f, (float)-n);
+}
+
+static float deSquaredDistance(DEVec3 p, int iterations) {
+    for (int n = 0; n < iterations; n++) {
+        int best = 0;
+        float dist = 0.0f;
+        for (int i = 0; i < 4; i++) {
+            float dx = p.x - deVertices[i].x;
+            float dy = p.y - deVertices[i].y;
+            float dz = p.z - deVertices[i].z;
+            float d = dx * dx + dy * dy + dz * dz;
+            if (i == 0 || d < dist) { best = i; dist = d; }
+        }
+        p.x = 2.0f * p.x - deVertices[best].x;
+        p.y = 2.0f * p.y - deVertices[best].y;
+        p.z = 2.0f * p.z - deVertices[best].z;
+    }
+    return sqrtf(p.x * p.x + p.y * p.y + p.z * p.z) * ldexpf(1.0f, -iterations);
+}
+
+static float dePlaneFold(DEVec3 z, int iterations) {
+    float t;
+    for (int n = 0; n < iterations; n++) {
+        if (z.x + z.y < 0.0f) { t = -z.y; z.y = -z.x; z.x = t; }
+        if (z.x + z.z < 0.0f) { t = -z.z; z.z = -z.x; z.x = t; }
+        if (z.y + z.z < 0.0f) { t = -z.y; z.y = -z.z; z.z = t; }
+        if (z.x - z.y < 0.0f) { t = z.y; z.y = z.x; z.x = t; }
+        z.x = z.x * 2.0f - 1.0f;
+        z.y = z.y * 2.0f - 1.0f;
+        z.z = z.z * 2.0f - 1.0f;
+    }
+    return sqrtf(z.x * z.x + z.y * z.y + z.z * z.z) * ldexpf(1.0f, -iterations);
+}
+
+// ---------------------------------------------------------------------------
+// Registry
+// ---------------------------------------------------------------------------
+
+static const DEKernel deKernels[] = {
+    {"nearest-vertex",   "4 length() per iteration + pow()",
+     deGlslNearestVertex, deNearestVertex},
+    {"squared-distance", "4 dot() per iteration, constant scale",
+     deGlslSquaredDistance, deSquaredDistance},
+    {"plane-fold",       "4 conditional reflections per iteration",
+     deGlslPlaneFold, dePlaneFold}
+};
+
+#define DE_KERNEL_COUNT ((int)(sizeof(deKernels) / sizeof(deKernels[0])))
+
+// Look up a kernel by name, returning -1 if unknown
+static inline int deKernelFind(const char* name) {
+    for (int i = 0; i < DE_KERNEL_COUNT; i++) {
+        if (strcmp(deKernels[i].name, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static inline void deKernelPrintList(FILE* out) {
+    for (int i = 0; i < DE_KERNEL_COUNT; i++) {
+        fprintf(out, "  %-18s %s\n", deKernels[i].name, deKernels[i].description);
+    }
+}
+
+#endif // DE_KERNELS_H
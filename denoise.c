@@ -0,0 +1,496 @@
+/*
+ * Edge-Aware Denoiser for Captured Frames
+ * CPU version of the a-trous filter in sierpinski_enhanced.c
+ *
+ * Reads a linear frame captured with --hdr-output FILE.pfm --hdr-guide
+ * together with its hit distances (_depth.pfm) and orbit traps
+ * (_trap.pfm), and filters it with the same edge-avoiding wavelet
+ * levels as the real-time denoiser, weights included:
+ *
+ * - Normals are rebuilt from the hit distances as on the GPU, taking
+ *   the neighbour nearer in depth so silhouettes stay sharp
+ * - Every plane is stored separately (structure-of-arrays) with a border
+ *   of empty pixels as wide as the largest tap offset, so the inner
+ *   loops run over x with no bounds checks or branches and the compiler
+ *   can vectorize them
+ * - Each level loops over its 25 taps and, inside, over a whole row, so
+ *   the loads of one tap are contiguous
+ * - Bands of rows are handed out to worker threads through an atomic
+ *   counter; levels are separated by joining the workers
+ *
+ * The report lists the time per level and the filtered pixels/second.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include <SDL2/SDL.h>
+
+#define DENOISE_MAX_PASSES 5
+#define DENOISE_PAD (2 << (DENOISE_MAX_PASSES - 1))   // largest tap offset
+#define DENOISE_COLOR_SIGMA 1.0f   // same constants as sierpinski_enhanced.c
+#define PLANE_SIGMA 4.0f
+#define TRAP_SIGMA 1.0f
+#define CAMERA_FOCAL 1.8f
+#define BAND_ROWS 8
+#define MAX_THREADS 64
+
+// Planes of a padded image; pixel (x, y) of a plane is at
+// (y + DENOISE_PAD) * stride + x + DENOISE_PAD, with y counting up from
+// the bottom row as in OpenGL and PFM
+enum {
+    PLANE_R, PLANE_G, PLANE_B,          // color, ping
+    PLANE_R2, PLANE_G2, PLANE_B2,       // color, pong
+    PLANE_POS_X, PLANE_POS_Y, PLANE_POS_Z,
+    PLANE_NORMAL_X, PLANE_NORMAL_Y, PLANE_NORMAL_Z,
+    PLANE_TRAP_X, PLANE_TRAP_Y, PLANE_TRAP_Z,
+    PLANE_CLASS,                        // 1 surface, -1 sky, 0 border
+    PLANE_INV_REACH,                    // 1 / (PLANE_SIGMA * pixel footprint)
+    PLANE_COUNT
+};
+
+typedef struct {
+    int width;
+    int height;
+    int stride;
+    size_t planeSize;
+    float* data;
+} DenoiseImage;
+
+typedef struct {
+    const char* inputPath;
+    const char* outputPath;
+    int passes;
+    float colorSigma;
+    bool useTrap;
+    int threads;
+} DenoiseOptions;
+
+typedef struct {
+    DenoiseImage* image;
+    int level;
+    int source;             // PLANE_R or PLANE_R2
+    float colorSigma;
+    bool useTrap;
+    int bandCount;
+    SDL_atomic_t nextBand;
+} DenoiseJob;
+
+typedef struct {
+    DenoiseJob* job;
+    float* scratch;         // 4 rows: r, g, b and weight sums
+} DenoiseWorker;
+
+static double nowSeconds(void) {
+    return (double)SDL_GetPerformanceCounter() / (double)SDL_GetPerformanceFrequency();
+}
+
+static inline float* imagePlane(const DenoiseImage* image, int plane) {
+    return image->data + (size_t)plane * image->planeSize;
+}
+
+static inline size_t pixelIndex(const DenoiseImage* image, int x, int y) {
+    return (size_t)(y + DENOISE_PAD) * image->stride + x + DENOISE_PAD;
+}
+
+// ---------------------------------------------------------------------------
+// PFM files
+// ---------------------------------------------------------------------------
+
+// Reads a little-endian PFM with `channels` channels; rows bottom to top
+static float* readPfm(const char* path, int channels, int* width, int* height) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "Could not open %s\n", path);
+        return NULL;
+    }
+    char magic[3] = {0};
+    float scale = 0.0f;
+    float* pixels = NULL;
+    if (fscanf(file, "%2s %d %d %f", magic, width, height, &scale) != 4 || fgetc(file) == EOF ||
+        strcmp(magic, channels == 3 ? "PF" : "Pf") != 0 || *width < 1 || *height < 1) {
+        fprintf(stderr, "%s is not a %d-channel PFM\n", path, channels);
+    } else if (scale >= 0.0f) {
+        fprintf(stderr, "%s is big-endian, which is not supported\n", path);
+    } else {
+        size_t count = (size_t)*width * *height * channels;
+        pixels = (float*)malloc(count * sizeof(float));
+        if (!pixels || fread(pixels, sizeof(float), count, file) != count) {
+            fprintf(stderr, "%s is truncated\n", path);
+            free(pixels);
+            pixels = NULL;
+        }
+    }
+    fclose(file);
+    return pixels;
+}
+
+static bool writePfm(const char* path, const DenoiseImage* image, int source) {
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "Could not open %s for writing\n", path);
+        return false;
+    }
+    bool ok = fprintf(file, "PF\n%d %d\n-1.0\n", image->width, image->height) > 0;
+    float* row = (float*)malloc((size_t)image->width * 3 * sizeof(float));
+    ok = ok && row;
+    for (int y = 0; ok && y < image->height; y++) {
+        for (int c = 0; c < 3; c++) {
+            const float* src = imagePlane(image, source + c) + pixelIndex(image, 0, y);
+            for (int x = 0; x < image->width; x++) {
+                row[x * 3 + c] = src[x];
+            }
+        }
+        ok = fwrite(row, sizeof(float), (size_t)image->width * 3, file) == (size_t)image->width * 3;
+    }
+    free(row);
+    ok = fclose(file) == 0 && ok;
+    if (!ok) {
+        fprintf(stderr, "Failed to write %s\n", path);
+    }
+    return ok;
+}
+
+// ---------------------------------------------------------------------------
+// Features
+// ---------------------------------------------------------------------------
+
+static void viewPos(const DenoiseImage* image, int x, int y, float t, float p[3]) {
+    float u = ((float)x + 0.5f - 0.5f * image->width) / image->height;
+    float v = ((float)y + 0.5f - 0.5f * image->height) / image->height;
+    float scale = t / sqrtf(u * u + v * v + CAMERA_FOCAL * CAMERA_FOCAL);
+    p[0] = u * scale;
+    p[1] = v * scale;
+    p[2] = -CAMERA_FOCAL * scale;
+}
+
+static float hitAt(const float* depth, int width, int height, int x, int y) {
+    x = x < 0 ? 0 : x >= width ? width - 1 : x;
+    y = y < 0 ? 0 : y >= height ? height - 1 : y;
+    return depth[(size_t)y * width + x];
+}
+
+// Position difference one pixel along (ax, ay), or zero with no hit
+// either side; see denoiseFeatureFragmentShaderSource
+static void derivative(const DenoiseImage* image, const float* depth, int x, int y, int ax, int ay, float t,
+                       const float p[3], float d[3]) {
+    float before = hitAt(depth, image->width, image->height, x - ax, y - ay);
+    float after = hitAt(depth, image->width, image->height, x + ax, y + ay);
+    bool useAfter = after >= 0.0f && (before < 0.0f || fabsf(after - t) < fabsf(before - t));
+    float q[3];
+    d[0] = d[1] = d[2] = 0.0f;
+    if (useAfter) {
+        viewPos(image, x + ax, y + ay, after, q);
+        for (int c = 0; c < 3; c++) d[c] = q[c] - p[c];
+    } else if (before >= 0.0f) {
+        viewPos(image, x - ax, y - ay, before, q);
+        for (int c = 0; c < 3; c++) d[c] = p[c] - q[c];
+    }
+}
+
+// Fills every plane but the colors from the hit distances and traps
+static void buildFeatures(DenoiseImage* image, const float* depth, const float* trap) {
+    for (int y = 0; y < image->height; y++) {
+        for (int x = 0; x < image->width; x++) {
+            size_t i = pixelIndex(image, x, y);
+            float t = depth[(size_t)y * image->width + x];
+            float p[3], n[3] = {0.0f, 0.0f, 0.0f};
+            viewPos(image, x, y, t, p);
+            if (t >= 0.0f) {
+                float dx[3], dy[3];
+                derivative(image, depth, x, y, 1, 0, t, p, dx);
+                derivative(image, depth, x, y, 0, 1, t, p, dy);
+                n[0] = dx[1] * dy[2] - dx[2] * dy[1];
+                n[1] = dx[2] * dy[0] - dx[0] * dy[2];
+                n[2] = dx[0] * dy[1] - dx[1] * dy[0];
+                float len = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                if (len == 0.0f) {
+                    // Facing the camera
+                    for (int c = 0; c < 3; c++) n[c] = -p[c];
+                    len = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                }
+                float sign = n[0] * p[0] + n[1] * p[1] + n[2] * p[2] > 0.0f ? -1.0f : 1.0f;
+                for (int c = 0; c < 3; c++) n[c] *= sign / len;
+            }
+            for (int c = 0; c < 3; c++) {
+                imagePlane(image, PLANE_POS_X + c)[i] = p[c];
+                imagePlane(image, PLANE_NORMAL_X + c)[i] = n[c];
+                imagePlane(image, PLANE_TRAP_X + c)[i] = trap[((size_t)y * image->width + x) * 3 + c];
+            }
+            imagePlane(image, PLANE_CLASS)[i] = t >= 0.0f ? 1.0f : -1.0f;
+            float reach = PLANE_SIGMA * fabsf(t) / (CAMERA_FOCAL * image->height);
+            imagePlane(image, PLANE_INV_REACH)[i] = 1.0f / fmaxf(reach, 1e-6f);
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Filter
+// ---------------------------------------------------------------------------
+
+// One row of every plane the filter reads
+typedef struct {
+    const float *r, *g, *b;
+    const float *posX, *posY, *posZ;
+    const float *normalX, *normalY, *normalZ;
+    const float *trapX, *trapY, *trapZ;
+    const float *cls, *invReach;
+} RowPlanes;
+
+static RowPlanes rowPlanes(const DenoiseImage* image, int source, ptrdiff_t offset) {
+    RowPlanes row;
+    row.r = imagePlane(image, source) + offset;
+    row.g = imagePlane(image, source + 1) + offset;
+    row.b = imagePlane(image, source + 2) + offset;
+    row.posX = imagePlane(image, PLANE_POS_X) + offset;
+    row.posY = imagePlane(image, PLANE_POS_Y) + offset;
+    row.posZ = imagePlane(image, PLANE_POS_Z) + offset;
+    row.normalX = imagePlane(image, PLANE_NORMAL_X) + offset;
+    row.normalY = imagePlane(image, PLANE_NORMAL_Y) + offset;
+    row.normalZ = imagePlane(image, PLANE_NORMAL_Z) + offset;
+    row.trapX = imagePlane(image, PLANE_TRAP_X) + offset;
+    row.trapY = imagePlane(image, PLANE_TRAP_Y) + offset;
+    row.trapZ = imagePlane(image, PLANE_TRAP_Z) + offset;
+    row.cls = imagePlane(image, PLANE_CLASS) + offset;
+    row.invReach = imagePlane(image, PLANE_INV_REACH) + offset;
+    return row;
+}
+
+// Adds one tap for a row of center pixels c, whose tap pixels are q.
+// The sums are the only stores, so the loop vectorizes.
+static void accumulateTap(const RowPlanes* c, const RowPlanes* q, int width, float tapWeight, float invTapReach,
+                          float invColorSigma2, float invTrapSigma2, float* restrict sumR, float* restrict sumG,
+                          float* restrict sumB, float* restrict sumW) {
+    for (int x = 0; x < width; x++) {
+        float dr = q->r[x] - c->r[x], dg = q->g[x] - c->g[x], db = q->b[x] - c->b[x];
+        float w = tapWeight * expf(-(dr * dr + dg * dg + db * db) * invColorSigma2);
+
+        float plane = fabsf(c->normalX[x] * (q->posX[x] - c->posX[x]) + c->normalY[x] * (q->posY[x] - c->posY[x]) +
+                            c->normalZ[x] * (q->posZ[x] - c->posZ[x]));
+        float cosine = fmaxf(c->normalX[x] * q->normalX[x] + c->normalY[x] * q->normalY[x] +
+                             c->normalZ[x] * q->normalZ[x], 0.0f);
+        float tx = q->trapX[x] - c->trapX[x], ty = q->trapY[x] - c->trapY[x], tz = q->trapZ[x] - c->trapZ[x];
+        float surface = expf(-plane * c->invReach[x] * invTapReach - (tx * tx + ty * ty + tz * tz) * invTrapSigma2) *
+                        cosine;
+        w *= c->cls[x] > 0.0f ? surface : 1.0f;
+        w = q->cls[x] == c->cls[x] ? w : 0.0f;
+
+        sumR[x] += q->r[x] * w;
+        sumG[x] += q->g[x] * w;
+        sumB[x] += q->b[x] * w;
+        sumW[x] += w;
+    }
+}
+
+// One level for the rows [y0, y1); see atrousFragmentShaderSource
+static void filterRows(const DenoiseJob* job, int y0, int y1, float* scratch) {
+    static const float kernel[3] = {3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f};
+    const DenoiseImage* image = job->image;
+    const int width = image->width;
+    const int step = 1 << job->level;
+    const int target = job->source == PLANE_R ? PLANE_R2 : PLANE_R;
+    const float invColorSigma2 = 1.0f / (job->colorSigma * job->colorSigma);
+    const float invTrapSigma2 = job->useTrap ? 1.0f / (TRAP_SIGMA * TRAP_SIGMA) : 0.0f;
+    float* sumR = scratch;
+    float* sumG = scratch + width;
+    float* sumB = scratch + 2 * width;
+    float* sumW = scratch + 3 * width;
+
+    for (int y = y0; y < y1; y++) {
+        const ptrdiff_t row = (ptrdiff_t)pixelIndex(image, 0, y);
+        const RowPlanes center = rowPlanes(image, job->source, row);
+        memset(scratch, 0, 4 * (size_t)width * sizeof(float));
+        for (int j = -2; j <= 2; j++) {
+            for (int i = -2; i <= 2; i++) {
+                // Taps past the edge land in the border, whose class
+                // matches no pixel
+                const RowPlanes tap = rowPlanes(image, job->source, row + ((ptrdiff_t)j * image->stride + i) * step);
+                const float invTapReach = i == 0 && j == 0 ? 0.0f : 1.0f / (sqrtf((float)(i * i + j * j)) * step);
+                accumulateTap(&center, &tap, width, kernel[abs(i)] * kernel[abs(j)], invTapReach, invColorSigma2,
+                              invTrapSigma2, sumR, sumG, sumB, sumW);
+            }
+        }
+        // The center tap always counts
+        float* dstR = imagePlane(image, target) + row;
+        float* dstG = imagePlane(image, target + 1) + row;
+        float* dstB = imagePlane(image, target + 2) + row;
+        for (int x = 0; x < width; x++) {
+            dstR[x] = sumR[x] / sumW[x];
+            dstG[x] = sumG[x] / sumW[x];
+            dstB[x] = sumB[x] / sumW[x];
+        }
+    }
+}
+
+static int denoiseWorkerRun(void* data) {
+    DenoiseWorker* w = (DenoiseWorker*)data;
+    DenoiseJob* job = w->job;
+    int band;
+    while ((band = SDL_AtomicAdd(&job->nextBand, 1)) < job->bandCount) {
+        int y0 = band * BAND_ROWS;
+        int y1 = y0 + BAND_ROWS < job->image->height ? y0 + BAND_ROWS : job->image->height;
+        filterRows(job, y0, y1, w->scratch);
+    }
+    return 0;
+}
+
+// Runs one level on `threads` threads
+static void filterLevel(DenoiseJob* job, DenoiseWorker* workers, int threads) {
+    SDL_Thread* handles[MAX_THREADS];
+
+    SDL_AtomicSet(&job->nextBand, 0);
+    for (int i = 0; i < threads; i++) {
+        workers[i].job = job;
+        handles[i] = threads > 1 ? SDL_CreateThread(denoiseWorkerRun, "denoise", &workers[i]) : NULL;
+        if (!handles[i]) denoiseWorkerRun(&workers[i]);
+    }
+    for (int i = 0; i < threads; i++) {
+        if (handles[i]) SDL_WaitThread(handles[i], NULL);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Driver
+// ---------------------------------------------------------------------------
+
+static void printUsage(const char* prog) {
+    fprintf(stderr, "Usage: %s --input FILE.pfm [options]\n", prog);
+    fprintf(stderr, "  --input FILE      Frame from --hdr-output FILE.pfm --hdr-guide; its _depth.pfm and\n");
+    fprintf(stderr, "                    _trap.pfm are read from beside it\n");
+    fprintf(stderr, "  --output FILE     Denoised frame (default denoised.pfm)\n");
+    fprintf(stderr, "  --passes N        Filter levels, 1 to %d (default 3)\n", DENOISE_MAX_PASSES);
+    fprintf(stderr, "  --color-sigma S   Color sigma of the first level (default %.1f)\n", DENOISE_COLOR_SIGMA);
+    fprintf(stderr, "  --no-trap         Ignore the orbit traps\n");
+    fprintf(stderr, "  --threads N       Filter threads (default: CPU count)\n");
+}
+
+// Path of a guide file: "shot_00000.pfm" -> "shot_00000_depth.pfm"
+static char* guidePath(const char* input, const char* suffix) {
+    size_t base = strlen(input) - strlen(".pfm");
+    char* path = (char*)malloc(base + strlen(suffix) + 1);
+    if (path) {
+        memcpy(path, input, base);
+        strcpy(path + base, suffix);
+    }
+    return path;
+}
+
+// Denoises color with its depth and trap guides, all width x height, and
+// writes the result to opt->outputPath; returns the exit status
+static int denoiseFrame(const DenoiseOptions* opt, const float* color, const float* depth, const float* trap,
+                        int width, int height) {
+    DenoiseImage image;
+    image.width = width;
+    image.height = height;
+    image.stride = width + 2 * DENOISE_PAD;
+    image.planeSize = (size_t)image.stride * (height + 2 * DENOISE_PAD);
+    image.data = (float*)calloc(image.planeSize * PLANE_COUNT, sizeof(float));
+    DenoiseWorker workers[MAX_THREADS];
+    bool scratchOk = true;
+    for (int i = 0; i < opt->threads; i++) {
+        workers[i].scratch = (float*)malloc(4 * (size_t)width * sizeof(float));
+        scratchOk = scratchOk && workers[i].scratch;
+    }
+    int status = 1;
+    if (!image.data || !scratchOk) {
+        fprintf(stderr, "Out of memory for a %dx%d frame\n", width, height);
+    } else {
+        double start = nowSeconds();
+        for (int y = 0; y < height; y++) {
+            for (int c = 0; c < 3; c++) {
+                float* dst = imagePlane(&image, PLANE_R + c) + pixelIndex(&image, 0, y);
+                for (int x = 0; x < width; x++) {
+                    dst[x] = color[((size_t)y * width + x) * 3 + c];
+                }
+            }
+        }
+        buildFeatures(&image, depth, trap);
+        double featureSeconds = nowSeconds() - start;
+
+        printf("Denoising %s: %dx%d, %d levels, %d threads\n\n", opt->inputPath, width, height, opt->passes,
+               opt->threads);
+        printf("features  %8.2f ms\n", featureSeconds * 1000.0);
+
+        DenoiseJob job;
+        job.image = &image;
+        job.source = PLANE_R;
+        job.useTrap = opt->useTrap;
+        job.bandCount = (height + BAND_ROWS - 1) / BAND_ROWS;
+        double filterSeconds = 0.0;
+        for (int level = 0; level < opt->passes; level++) {
+            // The color sigma halves every level
+            job.level = level;
+            job.colorSigma = opt->colorSigma / (float)(1 << level);
+            start = nowSeconds();
+            filterLevel(&job, workers, opt->threads);
+            double seconds = nowSeconds() - start;
+            filterSeconds += seconds;
+            printf("level %d   %8.2f ms  (step %d)\n", level, seconds * 1000.0, 1 << level);
+            job.source = job.source == PLANE_R ? PLANE_R2 : PLANE_R;
+        }
+        printf("\n%.1f Mpixels/s per level\n", (double)width * height * opt->passes / filterSeconds * 1e-6);
+
+        status = writePfm(opt->outputPath, &image, job.source) ? 0 : 1;
+        if (status == 0) printf("Denoised frame written to %s\n", opt->outputPath);
+    }
+
+    for (int i = 0; i < opt->threads; i++) {
+        free(workers[i].scratch);
+    }
+    free(image.data);
+    return status;
+}
+
+int main(int argc, char* argv[]) {
+    DenoiseOptions opt = {NULL, "denoised.pfm", 3, DENOISE_COLOR_SIGMA, true, SDL_GetCPUCount()};
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--input") == 0 && i + 1 < argc) {
+            opt.inputPath = argv[++i];
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            opt.outputPath = argv[++i];
+        } else if (strcmp(argv[i], "--passes") == 0 && i + 1 < argc) {
+            opt.passes = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--color-sigma") == 0 && i + 1 < argc) {
+            opt.colorSigma = (float)atof(argv[++i]);
+        } else if (strcmp(argv[i], "--no-trap") == 0) {
+            opt.useTrap = false;
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            opt.threads = atoi(argv[++i]);
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    size_t inputLength = opt.inputPath ? strlen(opt.inputPath) : 0;
+    if (inputLength < 5 || strcmp(opt.inputPath + inputLength - 4, ".pfm") != 0 ||
+        opt.passes < 1 || opt.passes > DENOISE_MAX_PASSES || opt.colorSigma <= 0.0f ||
+        opt.threads < 1 || opt.threads > MAX_THREADS) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    char* depthPath = guidePath(opt.inputPath, "_depth.pfm");
+    char* trapPath = guidePath(opt.inputPath, "_trap.pfm");
+    int width, height, depthWidth = 0, depthHeight = 0, trapWidth = 0, trapHeight = 0;
+    float* color = readPfm(opt.inputPath, 3, &width, &height);
+    float* depth = color && depthPath ? readPfm(depthPath, 1, &depthWidth, &depthHeight) : NULL;
+    float* trap = depth && trapPath ? readPfm(trapPath, 3, &trapWidth, &trapHeight) : NULL;
+    // readPfm has reported why a plane is missing
+    int status = 1;
+    if (trap && (depthWidth != width || depthHeight != height || trapWidth != width || trapHeight != height)) {
+        fprintf(stderr, "The guide files do not match the size of %s\n", opt.inputPath);
+    } else if (trap) {
+        status = denoiseFrame(&opt, color, depth, trap, width, height);
+    }
+
+    free(color);
+    free(depth);
+    free(trap);
+    free(depthPath);
+    free(trapPath);
+    return status;
+}
@@ -0,0 +1,145 @@
+/*
+ * Frame archive of a pre-rendered animation, written by frame_pack.c and
+ * played back by sierpinski_enhanced.c --play FILE
+ *
+ * Frames are coded independently, so playback can start, seek or loop at
+ * any frame. The player maps the whole file and reads it in place:
+ *
+ *   FRAHeader                          at offset 0
+ *   stored frames                      from dataOffset, one after another
+ *   FRAFrameEntry[frameCount]          at indexOffset, entry i locating
+ *                                      frame i
+ *
+ * dataOffset, indexOffset and the offset of every stored frame fall on
+ * FRA_ALIGNMENT boundaries, so one frame never shares a page with the
+ * next. The packer appends frames as it reads them and writes the index
+ * and header last. A decoded frame is width * height RGB8 pixels with the
+ * bottom row first, ready for glTexSubImage2D. FRA_RAW frames are stored
+ * like that; FRA_DELTA_RLE frames store each byte minus the byte three
+ * before it in the same row, leaving the first pixel of a row unchanged,
+ * as a sequence of runs: a control byte c < 128 precedes c + 1 literal
+ * bytes, and c >= 128 precedes one byte repeated c - 125 times.
+ * Fields are in host byte order.
+ */
+
+#ifndef FRAME_ARCHIVE_H
+#define FRAME_ARCHIVE_H
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#define FRA_MAGIC "SIERFRA1"
+#define FRA_VERSION 1
+#define FRA_ALIGNMENT 4096
+#define FRA_RAW 0
+#define FRA_DELTA_RLE 1
+#define FRA_MIN_RUN 3             // shorter runs are cheaper as literals
+#define FRA_MAX_RUN 130
+#define FRA_MAX_LITERALS 128
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t frameCount;
+    uint64_t indexOffset;
+    uint64_t dataOffset;
+    double fps;
+    char source[80];          // what the frames were rendered with, for information
+} FRAHeader;
+
+typedef struct {
+    uint64_t offset;          // from the start of the file
+    uint32_t size;            // stored bytes
+    uint32_t encoding;        // FRA_RAW or FRA_DELTA_RLE
+} FRAFrameEntry;
+
+static inline const FRAFrameEntry* fraFrameEntry(const void* file, uint32_t frame) {
+    const FRAHeader* header = (const FRAHeader*)file;
+    return (const FRAFrameEntry*)((const uint8_t*)file + header->indexOffset) + frame;
+}
+
+// Frame shown at time seconds, counting on from the last frame back to
+// the first, as for a loop
+static inline uint32_t fraFrameAt(const FRAHeader* header, double time) {
+    double frame = floor(time * header->fps);
+    return (uint32_t)(frame - floor(frame / header->frameCount) * header->frameCount);
+}
+
+// Decodes the stored frame of entry into pixels, which must hold width *
+// height * 3 bytes. Returns 0 if the data is corrupt.
+static inline int fraDecodeFrame(const void* file, const FRAFrameEntry* entry, uint8_t* pixels) {
+    const FRAHeader* header = (const FRAHeader*)file;
+    const uint8_t* in = (const uint8_t*)file + entry->offset;
+    const uint8_t* end = in + entry->size;
+    size_t rowBytes = (size_t)header->width * 3;
+    size_t total = rowBytes * header->height;
+
+    if (entry->encoding == FRA_RAW) {
+        if (entry->size != total) {
+            return 0;
+        }
+        memcpy(pixels, in, total);
+        return 1;
+    }
+    if (entry->encoding != FRA_DELTA_RLE) {
+        return 0;
+    }
+    size_t out = 0;
+    while (out < total) {
+        if (in == end) {
+            return 0;
+        }
+        unsigned control = *in++;
+        if (control < 128) {
+            size_t count = control + 1;
+            if (count > (size_t)(end - in) || count > total - out) {
+                return 0;
+            }
+            memcpy(pixels + out, in, count);
+            in += count;
+            out += count;
+        } else {
+            size_t count = control - 125;
+            if (in == end || count > total - out) {
+                return 0;
+            }
+            memset(pixels + out, *in++, count);
+            out += count;
+        }
+    }
+    // Undo the prediction from the left neighbour
+    for (uint32_t y = 0; y < header->height; y++) {
+        uint8_t* row = pixels + y * rowBytes;
+        for (size_t i = 3; i < rowBytes; i++) {
+            row[i] = (uint8_t)(row[i] + row[i - 3]);
+        }
+    }
+    return in == end;
+}
+
+static inline int fraValidHeader(const void* file, uint64_t fileSize) {
+    const FRAHeader* header = (const FRAHeader*)file;
+    if (fileSize < sizeof(FRAHeader) ||
+        memcmp(header->magic, FRA_MAGIC, 8) != 0 ||
+        header->version != FRA_VERSION ||
+        header->width == 0 || header->height == 0 || header->frameCount == 0 || !(header->fps > 0.0) ||
+        header->dataOffset < sizeof(FRAHeader) ||
+        header->dataOffset % FRA_ALIGNMENT != 0 || header->indexOffset % FRA_ALIGNMENT != 0 ||
+        header->indexOffset > fileSize ||
+        header->frameCount > (fileSize - header->indexOffset) / sizeof(FRAFrameEntry)) {
+        return 0;
+    }
+    for (uint32_t i = 0; i < header->frameCount; i++) {
+        const FRAFrameEntry* entry = fraFrameEntry(file, i);
+        if (entry->offset < header->dataOffset || entry->offset % FRA_ALIGNMENT != 0 || entry->offset > fileSize ||
+            entry->size > fileSize - entry->offset) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+#endif // FRAME_ARCHIVE_H
@@ -0,0 +1,237 @@
+/*
+ * Frame Archive Packer
+ * Packs the frames of an offline animation (--animation DIR) into one
+ * frame archive for --play, in the format of frame_archive.h.
+ *
+ * The frame count, rate and size come from the animation's queue file,
+ * and every frame must be on disk. Each frame is predicted from its left
+ * neighbour and run-length coded on its own, so the player can decode
+ * any frame without the others; a frame that would not get smaller is
+ * stored raw. Frames are streamed to disk one at a time, so memory stays
+ * at a few frames whatever the length of the animation.
+ *
+ *   frame_pack DIR [--output FILE] [--raw]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+#include "frame_archive.h"
+
+#define QUEUE_NAME "animation.queue"    // as in sierpinski_enhanced.c
+#define QUEUE_HEADER_SIZE 128
+
+static double nowSeconds(void) {
+    return (double)SDL_GetPerformanceCounter() / (double)SDL_GetPerformanceFrequency();
+}
+
+static void printUsage(const char* program) {
+    fprintf(stderr, "Usage: %s DIR [--output FILE] [--raw]\n", program);
+    fprintf(stderr, "  DIR            directory of a finished --animation\n");
+    fprintf(stderr, "  --output FILE  archive to write (default animation.sfa)\n");
+    fprintf(stderr, "  --raw          store every frame uncompressed\n");
+}
+
+// Reads a frame written by the animation worker into pixels, rows
+// bottom up
+static bool readFrame(const char* path, int width, int height, uint8_t* pixels) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "\n%s is missing; is the animation finished?\n", path);
+        return false;
+    }
+    int w = 0, h = 0, maxValue = 0;
+    bool ok = fscanf(file, "P6 %d %d %d", &w, &h, &maxValue) == 3 && fgetc(file) != EOF && w == width &&
+              h == height && maxValue == 255;
+    for (int y = height - 1; ok && y >= 0; y--) {
+        ok = fread(pixels + (size_t)y * width * 3, 1, (size_t)width * 3, file) == (size_t)width * 3;
+    }
+    fclose(file);
+    if (!ok) fprintf(stderr, "\n%s is not a %dx%d frame\n", path, width, height);
+    return ok;
+}
+
+// Appends count literal bytes in blocks of up to FRA_MAX_LITERALS
+static bool putLiterals(const uint8_t* bytes, size_t count, uint8_t* out, size_t* size, size_t capacity) {
+    while (count > 0) {
+        size_t block = count < FRA_MAX_LITERALS ? count : FRA_MAX_LITERALS;
+        if (*size + 1 + block > capacity) {
+            return false;
+        }
+        out[(*size)++] = (uint8_t)(block - 1);
+        memcpy(out + *size, bytes, block);
+        *size += block;
+        bytes += block;
+        count -= block;
+    }
+    return true;
+}
+
+// Codes a frame as FRA_DELTA_RLE into out, which holds as many bytes as
+// the raw frame. Returns the coded size, or 0 if it is not smaller.
+static size_t encodeFrame(const uint8_t* pixels, int width, int height, uint8_t* residual, uint8_t* out) {
+    size_t rowBytes = (size_t)width * 3;
+    size_t total = rowBytes * height;
+    for (int y = 0; y < height; y++) {
+        const uint8_t* row = pixels + y * rowBytes;
+        uint8_t* coded = residual + y * rowBytes;
+        memcpy(coded, row, 3);
+        for (size_t i = 3; i < rowBytes; i++) {
+            coded[i] = (uint8_t)(row[i] - row[i - 3]);
+        }
+    }
+
+    size_t size = 0, literals = 0, i = 0;
+    while (i < total) {
+        size_t run = 1;
+        while (i + run < total && run < FRA_MAX_RUN && residual[i + run] == residual[i]) run++;
+        if (run < FRA_MIN_RUN) {
+            i += run;
+            continue;
+        }
+        if (!putLiterals(residual + literals, i - literals, out, &size, total) || size + 2 > total) {
+            return 0;
+        }
+        out[size++] = (uint8_t)(run + 125);
+        out[size++] = residual[i];
+        i += run;
+        literals = i;
+    }
+    if (!putLiterals(residual + literals, total - literals, out, &size, total) || size == total) {
+        return 0;
+    }
+    return size;
+}
+
+// Writes zeros up to the next FRA_ALIGNMENT boundary
+static bool padTo(FILE* file, uint64_t* offset) {
+    static const uint8_t zeros[FRA_ALIGNMENT];
+    size_t pad = (size_t)((FRA_ALIGNMENT - *offset % FRA_ALIGNMENT) % FRA_ALIGNMENT);
+    *offset += pad;
+    return fwrite(zeros, 1, pad, file) == pad;
+}
+
+int main(int argc, char* argv[]) {
+    const char* directory = NULL;
+    const char* outputPath = "animation.sfa";
+    bool raw = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            outputPath = argv[++i];
+        } else if (strcmp(argv[i], "--raw") == 0) {
+            raw = true;
+        } else if (argv[i][0] != '-' && !directory) {
+            directory = argv[i];
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (!directory) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    // The queue header names the animation's settings
+    char path[1024];
+    char queueHeader[QUEUE_HEADER_SIZE + 1] = "";
+    int frames = 0, width = 0, height = 0;
+    double fps = 0.0;
+    snprintf(path, sizeof(path), "%s/" QUEUE_NAME, directory);
+    FILE* queue = fopen(path, "rb");
+    size_t got = queue ? fread(queueHeader, 1, QUEUE_HEADER_SIZE, queue) : 0;
+    if (queue) fclose(queue);
+    queueHeader[got] = '\0';
+    if (sscanf(queueHeader, "SIERANIM 1 frames=%d fps=%lf size=%dx%d", &frames, &fps, &width, &height) != 4 ||
+        frames < 1 || fps <= 0.0 || width < 1 || height < 1) {
+        fprintf(stderr, "%s is not the queue of an animation\n", path);
+        return 1;
+    }
+    size_t frameBytes = (size_t)width * height * 3;
+    if (frameBytes > UINT32_MAX) {
+        fprintf(stderr, "Frames of %dx%d are too large for an archive\n", width, height);
+        return 1;
+    }
+
+    uint8_t* pixels = (uint8_t*)malloc(frameBytes);
+    uint8_t* residual = (uint8_t*)malloc(frameBytes);
+    uint8_t* coded = (uint8_t*)malloc(frameBytes);
+    FRAFrameEntry* index = (FRAFrameEntry*)calloc((size_t)frames, sizeof(FRAFrameEntry));
+    if (!pixels || !residual || !coded || !index) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    FRAHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FRA_MAGIC, 8);
+    header.version = FRA_VERSION;
+    header.width = (uint32_t)width;
+    header.height = (uint32_t)height;
+    header.frameCount = (uint32_t)frames;
+    header.fps = fps;
+    header.dataOffset = FRA_ALIGNMENT;
+    size_t sourceLength = strcspn(queueHeader, "\n");
+    while (sourceLength > 0 && queueHeader[sourceLength - 1] == ' ') sourceLength--;
+    if (sourceLength >= sizeof(header.source)) sourceLength = sizeof(header.source) - 1;
+    memcpy(header.source, queueHeader, sourceLength);
+
+    printf("Frame archive: %d frames of %dx%d at %.3f fps from %s\n", frames, width, height, fps, directory);
+
+    // The header goes in last, once the index is known
+    char temporary[1024];
+    snprintf(temporary, sizeof(temporary), "%s.part", outputPath);
+    FILE* file = fopen(temporary, "wb");
+    if (!file) {
+        fprintf(stderr, "Could not open %s for writing\n", temporary);
+        return 1;
+    }
+    uint64_t offset = sizeof(header);
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 && padTo(file, &offset);
+    int compressed = 0;
+    double start = nowSeconds();
+    for (int frame = 0; ok && frame < frames; frame++) {
+        snprintf(path, sizeof(path), "%s/frame_%05d.ppm", directory, frame);
+        ok = readFrame(path, width, height, pixels);
+        if (!ok) break;
+        size_t size = raw ? 0 : encodeFrame(pixels, width, height, residual, coded);
+        index[frame].offset = offset;
+        index[frame].size = (uint32_t)(size ? size : frameBytes);
+        index[frame].encoding = size ? FRA_DELTA_RLE : FRA_RAW;
+        compressed += size ? 1 : 0;
+        ok = fwrite(size ? coded : pixels, 1, index[frame].size, file) == index[frame].size;
+        offset += index[frame].size;
+        ok = ok && padTo(file, &offset);
+        if (frame % 16 == 15 || frame == frames - 1) {
+            printf("\rPacked %d of %d frames", frame + 1, frames);
+            fflush(stdout);
+        }
+    }
+    printf("\n");
+    header.indexOffset = offset;
+    ok = ok && fwrite(index, sizeof(FRAFrameEntry), (size_t)frames, file) == (size_t)frames;
+    offset += (uint64_t)frames * sizeof(FRAFrameEntry);
+    ok = ok && fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = fclose(file) == 0 && ok;
+    ok = ok && rename(temporary, outputPath) == 0;
+    double seconds = nowSeconds() - start;
+
+    if (ok) {
+        double rawBytes = (double)frameBytes * frames;
+        printf("Wrote %s: %.1f MiB for %.1f MiB of frames (%.2f:1), %d of %d frames compressed, %.1f frames/s\n",
+               outputPath, offset / (1024.0 * 1024.0), rawBytes / (1024.0 * 1024.0), rawBytes / offset, compressed,
+               frames, frames / seconds);
+    } else {
+        fprintf(stderr, "Failed to write %s\n", outputPath);
+        remove(temporary);
+    }
+    free(pixels);
+    free(residual);
+    free(coded);
+    free(index);
+    return ok ? 0 : 1;
+}
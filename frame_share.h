@@ -0,0 +1,184 @@
+/*
+ * Shared-memory frame ring of sierpinski_enhanced.c (--share NAME)
+ *
+ * The renderer creates a named shared-memory object, "/NAME" with
+ * shm_open or "Local\NAME" as a Windows file mapping, laid out as:
+ *
+ *   FrameShareHeader               at offset 0
+ *   uint8_t[slotCount][slotSize]   at FRAME_SHARE_DATA_OFFSET
+ *
+ * Slot i holds a frame's RGBA8 pixels, rows bottom up, width * 4 bytes
+ * apart, and header.slots[i] describes it. The renderer writes frame n
+ * into slot n % slotCount under a sequence lock: the slot's sequence is
+ * 2n + 1 while it writes and 2n + 2 once the frame is complete, and then
+ * latest becomes n + 1. A consumer copies the slot of frame latest - 1,
+ * or reads it in place, and keeps the frame if the sequence was 2n + 2
+ * both before and after; otherwise the renderer came round to the slot
+ * again meanwhile, and the consumer takes the newest frame instead.
+ * Neither side ever waits for the other, so consumers can map and unmap
+ * the object at any time without the renderer noticing.
+ * Fields are in host byte order.
+ */
+
+#ifndef FRAME_SHARE_H
+#define FRAME_SHARE_H
+
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <SDL2/SDL.h>
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define FRAME_SHARE_MAGIC "SIERSHM1"
+#define FRAME_SHARE_VERSION 1
+#define FRAME_SHARE_MAX_SLOTS 8
+#define FRAME_SHARE_DATA_OFFSET 4096    // slots start page aligned
+
+typedef struct {
+    SDL_atomic_t sequence;    // 2n + 1 while frame n is written, 2n + 2 after
+    uint32_t width;
+    uint32_t height;
+    int32_t palette;          // color palette index
+    int64_t timestamp;        // SDL performance counter in microseconds, the same clock in every process
+    float time;               // animation time in seconds
+    float camPos[3];
+    float rotation[9];        // camera to world, column-major like u_rotation
+    uint32_t reserved;        // pads the slot to 80 bytes
+} FrameShareSlot;
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t slotCount;
+    uint32_t slotSize;        // bytes from one slot's pixels to the next
+    uint32_t maxWidth;        // largest frame a slot holds
+    uint32_t maxHeight;
+    SDL_atomic_t latest;      // frames published; the newest is latest - 1
+    SDL_atomic_t open;        // 1 while the renderer runs
+    uint32_t reserved[7];     // pads the header to 64 bytes before the slots
+    FrameShareSlot slots[FRAME_SHARE_MAX_SLOTS];
+} FrameShareHeader;
+
+typedef struct {
+    FrameShareHeader* header;
+    size_t size;
+#ifdef _WIN32
+    HANDLE mapping;
+#endif
+} FrameShareMapping;
+
+// Creates the object NAME for maxWidth x maxHeight frames in slotCount
+// slots (the renderer), or with slotCount 0 maps an existing one (a
+// consumer). Returns 0 on success.
+static inline int frameShareOpen(FrameShareMapping* m, const char* name, uint32_t slotCount, uint32_t maxWidth,
+                                 uint32_t maxHeight) {
+    char path[256];
+    memset(m, 0, sizeof(*m));
+    uint32_t slotSize = (maxWidth * maxHeight * 4 + 4095u) & ~4095u;
+    size_t size = FRAME_SHARE_DATA_OFFSET + (size_t)slotCount * slotSize;
+#ifdef _WIN32
+    snprintf(path, sizeof(path), "Local\\%s", name);
+    m->mapping = slotCount ? CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+                                                (DWORD)((uint64_t)size >> 32), (DWORD)size, path)
+                           : OpenFileMappingA(FILE_MAP_READ | FILE_MAP_WRITE, FALSE, path);
+    if (!m->mapping) return -1;
+    m->header = (FrameShareHeader*)MapViewOfFile(m->mapping, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, 0);
+    if (!m->header) return -1;
+    MEMORY_BASIC_INFORMATION info;
+    VirtualQuery(m->header, &info, sizeof(info));
+    m->size = info.RegionSize;
+#else
+    snprintf(path, sizeof(path), "/%s", name);
+    // A new renderer makes a new object, leaving any that consumers of a
+    // crashed one still map as it was
+    if (slotCount) shm_unlink(path);
+    int fd = slotCount ? shm_open(path, O_RDWR | O_CREAT | O_EXCL, 0644) : shm_open(path, O_RDWR, 0);
+    if (fd < 0) return -1;
+    struct stat info;
+    int failed = slotCount ? ftruncate(fd, (off_t)size) : fstat(fd, &info);
+    if (!slotCount) size = failed ? 0 : (size_t)info.st_size;
+    void* data = failed || size < FRAME_SHARE_DATA_OFFSET ? MAP_FAILED
+               : mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return -1;
+    m->header = (FrameShareHeader*)data;
+    m->size = size;
+#endif
+    if (slotCount) {
+        memset(m->header, 0, sizeof(FrameShareHeader));
+        m->header->version = FRAME_SHARE_VERSION;
+        m->header->slotCount = slotCount;
+        m->header->slotSize = slotSize;
+        m->header->maxWidth = maxWidth;
+        m->header->maxHeight = maxHeight;
+        SDL_AtomicSet(&m->header->open, 1);
+        // The magic goes in last: a consumer that sees it sees the rest
+        SDL_MemoryBarrierRelease();
+        memcpy(m->header->magic, FRAME_SHARE_MAGIC, 8);
+    } else {
+        if (memcmp(m->header->magic, FRAME_SHARE_MAGIC, 8) != 0) return -1;
+        // Pairs with the renderer's release: past the magic, the rest is written
+        SDL_MemoryBarrierAcquire();
+        if (m->header->version != FRAME_SHARE_VERSION || m->header->slotCount == 0 ||
+            m->header->slotCount > FRAME_SHARE_MAX_SLOTS ||
+            m->size < FRAME_SHARE_DATA_OFFSET + (size_t)m->header->slotCount * m->header->slotSize) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Unmaps the object; the renderer also removes its name, and consumers
+// that still map it keep their mapping
+static inline void frameShareClose(FrameShareMapping* m, const char* name, int remove) {
+#ifdef _WIN32
+    (void)name;
+    (void)remove;
+    if (m->header) UnmapViewOfFile(m->header);
+    if (m->mapping) CloseHandle(m->mapping);
+#else
+    if (m->header) munmap(m->header, m->size);
+    if (remove) {
+        char path[256];
+        snprintf(path, sizeof(path), "/%s", name);
+        shm_unlink(path);
+    }
+#endif
+    memset(m, 0, sizeof(*m));
+}
+
+static inline uint8_t* frameSharePixels(FrameShareHeader* header, uint32_t slot) {
+    return (uint8_t*)header + FRAME_SHARE_DATA_OFFSET + (size_t)slot * header->slotSize;
+}
+
+// Copies the newest complete frame to pixels, which must hold maxWidth *
+// maxHeight * 4 bytes, and its description to slot. Returns the frame's
+// number + 1, or 0 before the first frame.
+static inline int frameShareRead(FrameShareHeader* header, uint8_t* pixels, FrameShareSlot* slot) {
+    for (;;) {
+        int latest = SDL_AtomicGet(&header->latest);
+        if (latest == 0) return 0;
+        FrameShareSlot* shared = &header->slots[(uint32_t)(latest - 1) % header->slotCount];
+        int before = SDL_AtomicGet(&shared->sequence);
+        if (before != 2 * latest) continue;
+        memcpy(slot, shared, sizeof(*slot));
+        if (slot->width <= header->maxWidth && slot->height <= header->maxHeight) {
+            memcpy(pixels, frameSharePixels(header, (uint32_t)(latest - 1) % header->slotCount),
+                   (size_t)slot->width * slot->height * 4);
+        }
+        SDL_MemoryBarrierAcquire();
+        if (SDL_AtomicGet(&shared->sequence) == before) return latest;
+    }
+}
+
+#endif // FRAME_SHARE_H
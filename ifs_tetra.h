@@ -0,0 +1,307 @@
+/*
+ * Exact geometry of the level-n Sierpinski tetrahedron
+ *
+ * At level n the fractal is exactly 4^n tetrahedra, so primary rays can
+ * be intersected analytically instead of sphere traced: intersect the
+ * parent tetrahedron, descend into the children the ray hits in
+ * near-to-far order and stop at the first leaf. Children of a node are
+ * disjoint convex cells, so their ray intervals never overlap and the
+ * first leaf reached is the closest hit.
+ *
+ * A node with center c and scale s has vertices c + s * a_i, where a_i
+ * are the root vertices from de_kernels.h. Its face opposite a_i is the
+ * plane dot(x - c, a_i) = -s, so a node is fully described by the four
+ * dot products q_i = dot(c, a_i) and its level. Child j of a node has
+ * q' = q + s/2 * (4 e_j - 1), since dot(a_i, a_j) is 3 when i == j and
+ * -1 otherwise.
+ *
+ * The traversal stack is bounded: every pop pushes at most four
+ * children, so the depth never exceeds 3 * levels + 1.
+ */
+
+#ifndef IFS_TETRA_H
+#define IFS_TETRA_H
+
+#include "de_kernels.h"
+
+#define IFS_MAX_LEVELS 24
+#define IFS_STACK_SIZE (3 * IFS_MAX_LEVELS + 1)
+#define IFS_INFINITY 1e30f
+
+// ---------------------------------------------------------------------------
+// GLSL intersector
+// ---------------------------------------------------------------------------
+
+// Defines `float intersectSierpinski(vec3 ro, vec3 rd, float tMax,
+// out vec3 normal, out int visited)`, returning the hit distance or -1.
+// Uses IFS_LEVELS if the host defines it, DE_ITERATIONS otherwise.
+static const char ifsGlslIntersector[] =
+"#ifndef IFS_LEVELS\n"
+"#define IFS_LEVELS DE_ITERATIONS\n"
+"#endif\n"
+"#define IFS_STACK_SIZE (3 * IFS_LEVELS + 1)\n"
+"\n"
+"// Ray distances to the four face planes of the node (q, s); entering\n"
+"// lanes bound the interval from below, the others from above\n"
+"vec2 ifsInterval(vec4 q, float s, vec4 R, vec4 invD, bvec4 entering) {\n"
+"    vec4 t = (q - s - R) * invD;\n"
+"    vec4 tIn = mix(vec4(-1e30), t, entering);\n"
+"    vec4 tOut = mix(t, vec4(1e30), entering);\n"
+"    return vec2(max(max(tIn.x, tIn.y), max(tIn.z, tIn.w)),\n"
+"                min(min(tOut.x, tOut.y), min(tOut.z, tOut.w)));\n"
+"}\n"
+"\n"
+"// Exact ray / level-n Sierpinski tetrahedron intersection\n"
+"float intersectSierpinski(vec3 ro, vec3 rd, float tMax, out vec3 normal, out int visited) {\n"
+"    // Dot products with the root vertices a1..a4, one lane each\n"
+"    vec4 R = vec4(ro.x + ro.y + ro.z, -ro.x - ro.y + ro.z, ro.x - ro.y - ro.z, -ro.x + ro.y - ro.z);\n"
+"    vec4 D = vec4(rd.x + rd.y + rd.z, -rd.x - rd.y + rd.z, rd.x - rd.y - rd.z, -rd.x + rd.y - rd.z);\n"
+"    D = mix(vec4(1e-8), D, greaterThanEqual(abs(D), vec4(1e-8)));\n"
+"    vec4 invD = 1.0 / D;\n"
+"    bvec4 entering = greaterThan(D, vec4(0.0));\n"
+"    \n"
+"    normal = vec3(0.0);\n"
+"    visited = 0;\n"
+"    \n"
+"    vec2 root = ifsInterval(vec4(0.0), 1.0, R, invD, entering);\n"
+"    if (root.x > root.y || root.y < 0.0 || root.x > tMax) return -1.0;\n"
+"    \n"
+"    vec4 stackQ[IFS_STACK_SIZE];\n"
+"    float stackLevel[IFS_STACK_SIZE];\n"
+"    stackQ[0] = vec4(0.0);\n"
+"    stackLevel[0] = 0.0;\n"
+"    int sp = 1;\n"
+"    \n"
+"    while (sp > 0) {\n"
+"        sp--;\n"
+"        vec4 q = stackQ[sp];\n"
+"        float level = stackLevel[sp];\n"
+"        float s = exp2(-level);\n"
+"        visited++;\n"
+"        \n"
+"        if (level >= float(IFS_LEVELS)) {\n"
+"            // Leaf: the entry face is the one with the largest entry distance\n"
+"            vec4 t = mix(vec4(-1e30), (q - s - R) * invD, entering);\n"
+"            float tHit = max(max(t.x, t.y), max(t.z, t.w));\n"
+"            if (t.x == tHit) normal = vec3(-1.0, -1.0, -1.0);\n"
+"            else if (t.y == tHit) normal = vec3(1.0, 1.0, -1.0);\n"
+"            else if (t.z == tHit) normal = vec3(-1.0, 1.0, 1.0);\n"
+"            else normal = vec3(1.0, -1.0, 1.0);\n"
+"            normal *= 0.57735027;\n"
+"            return max(tHit, 0.0);\n"
+"        }\n"
+"        \n"
+"        // Entry distance of each child, 1e30 if missed\n"
+"        float hs = 0.5 * s;\n"
+"        vec4 childT;\n"
+"        for (int j = 0; j < 4; j++) {\n"
+"            vec4 cq = q - hs;\n"
+"            cq[j] += 2.0 * s;\n"
+"            vec2 iv = ifsInterval(cq, hs, R, invD, entering);\n"
+"            childT[j] = (iv.x <= iv.y && iv.y >= 0.0 && iv.x <= tMax) ? iv.x : 1e30;\n"
+"        }\n"
+"        \n"
+"        // Push hit children far-to-near so the nearest is popped first\n"
+"        for (int k = 0; k < 4; k++) {\n"
+"            int farIndex = -1;\n"
+"            for (int j = 0; j < 4; j++) {\n"
+"                if (childT[j] < 1e29 && (farIndex < 0 || childT[j] > childT[farIndex])) farIndex = j;\n"
+"            }\n"
+"            if (farIndex < 0) break;\n"
+"            childT[farIndex] = 1e30;\n"
+"            vec4 cq = q - hs;\n"
+"            cq[farIndex] += 2.0 * s;\n"
+"            stackQ[sp] = cq;\n"
+"            stackLevel[sp] = level + 1.0;\n"
+"            sp++;\n"
+"        }\n"
+"    }\n"
+"    \n"
+"    return -1.0;\n"
+"}\n";
+
+// ---------------------------------------------------------------------------
+// C intersector
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    float t;
+    DEVec3 normal;
+    int nodesVisited;
+} IFSHit;
+
+// Per-ray constants shared by every node test
+typedef struct {
+    float r[4];
+    float invD[4];
+    int entering[4];
+} IFSRay;
+
+typedef struct {
+    float q[4];
+    int level;
+} IFSNode;
+
+static inline void ifsSetupRay(IFSRay* ray, DEVec3 ro, DEVec3 rd) {
+    for (int i = 0; i < 4; i++) {
+        const DEVec3* a = &deVertices[i];
+        float d = rd.x * a->x + rd.y * a->y + rd.z * a->z;
+        if (fabsf(d) < 1e-8f) d = 1e-8f;
+        ray->r[i] = ro.x * a->x + ro.y * a->y + ro.z * a->z;
+        ray->invD[i] = 1.0f / d;
+        ray->entering[i] = d > 0.0f;
+    }
+}
+
+// Ray interval [t0, t1] inside node (q, s); returns the entry face index
+static inline int ifsNodeInterval(const IFSRay* ray, const float q[4], float s, float* t0, float* t1) {
+    float tIn = -IFS_INFINITY, tOut = IFS_INFINITY;
+    int face = 0;
+    for (int i = 0; i < 4; i++) {
+        float t = (q[i] - s - ray->r[i]) * ray->invD[i];
+        if (ray->entering[i]) {
+            if (t > tIn) { tIn = t; face = i; }
+        } else if (t < tOut) {
+            tOut = t;
+        }
+    }
+    *t0 = tIn;
+    *t1 = tOut;
+    return face;
+}
+
+// Exact first hit against the level-`levels` tetrahedra within [0, tMax]
+static inline int ifsIntersect(DEVec3 ro, DEVec3 rd, int levels, float tMax, IFSHit* hit) {
+    IFSRay ray;
+    IFSNode stack[IFS_STACK_SIZE];
+    float t0, t1;
+    int sp = 0;
+
+    if (levels > IFS_MAX_LEVELS) levels = IFS_MAX_LEVELS;
+    ifsSetupRay(&ray, ro, rd);
+    hit->nodesVisited = 0;
+
+    IFSNode root = {{0.0f, 0.0f, 0.0f, 0.0f}, 0};
+    ifsNodeInterval(&ray, root.q, 1.0f, &t0, &t1);
+    if (t0 > t1 || t1 < 0.0f || t0 > tMax) {
+        return 0;
+    }
+    stack[sp++] = root;
+
+    while (sp > 0) {
+        IFSNode node = stack[--sp];
+        float s = ldexpf(1.0f, -node.level);
+        hit->nodesVisited++;
+
+        if (node.level >= levels) {
+            int face = ifsNodeInterval(&ray, node.q, s, &t0, &t1);
+            const float k = -0.57735027f;
+            hit->t = t0 > 0.0f ? t0 : 0.0f;
+            hit->normal.x = deVertices[face].x * k;
+            hit->normal.y = deVertices[face].y * k;
+            hit->normal.z = deVertices[face].z * k;
+            return 1;
+        }
+
+        // Entry distance of each child, infinity if missed
+        float hs = 0.5f * s;
+        float childT[4];
+        IFSNode children[4];
+        for (int j = 0; j < 4; j++) {
+            for (int i = 0; i < 4; i++) {
+                children[j].q[i] = node.q[i] - hs + (i == j ? 2.0f * s : 0.0f);
+            }
+            children[j].level = node.level + 1;
+            ifsNodeInterval(&ray, children[j].q, hs, &t0, &t1);
+            childT[j] = (t0 <= t1 && t1 >= 0.0f && t0 <= tMax) ? t0 : IFS_INFINITY;
+        }
+
+        // Push hit children far-to-near so the nearest is popped first
+        for (int k = 0; k < 4; k++) {
+            int farIndex = -1;
+            for (int j = 0; j < 4; j++) {
+                if (childT[j] < IFS_INFINITY && (farIndex < 0 || childT[j] > childT[farIndex])) {
+                    farIndex = j;
+                }
+            }
+            if (farIndex < 0) break;
+            childT[farIndex] = IFS_INFINITY;
+            stack[sp++] = children[farIndex];
+        }
+    }
+
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Leaf enumeration
+// ---------------------------------------------------------------------------
+
+// Number of tetrahedra at the given level
+static inline long long ifsTetraCount(int level) {
+    return 1LL << (2 * level);
+}
+
+// Center of leaf `index` at `level`; base-4 digits pick the child at
+// each level, most significant first
+static inline DEVec3 ifsLeafCenter(int level, long long index) {
+    DEVec3 c = {0.0f, 0.0f, 0.0f};
+    float s = 1.0f;
+    for (int l = level - 1; l >= 0; l--) {
+        const DEVec3* a = &deVertices[(index >> (2 * l)) & 3];
+        s *= 0.5f;
+        c.x += a->x * s;
+        c.y += a->y * s;
+        c.z += a->z * s;
+    }
+    return c;
+}
+
+// Triangle soup of the level-n tetrahedra, 12 vertices (xyz) each, with
+// every face pushed outwards by `margin` so the mesh conservatively
+// bounds the fractal. Returns the number of vertices written.
+static inline int ifsBuildHullMesh(int level, float margin, float* vertices) {
+    static const int faces[4][3] = { {1, 2, 3}, {0, 3, 2}, {0, 1, 3}, {0, 2, 1} };
+    long long count = ifsTetraCount(level);
+    float s = ldexpf(1.0f, -level);
+    float r = s + margin * 1.7320508f;
+    int n = 0;
+
+    for (long long i = 0; i < count; i++) {
+        DEVec3 c = ifsLeafCenter(level, i);
+        for (int f = 0; f < 4; f++) {
+            for (int v = 0; v < 3; v++) {
+                const DEVec3* a = &deVertices[faces[f][v]];
+                vertices[n * 3 + 0] = c.x + a->x * r;
+                vertices[n * 3 + 1] = c.y + a->y * r;
+                vertices[n * 3 + 2] = c.z + a->z * r;
+                n++;
+            }
+        }
+    }
+    return n;
+}
+
+// Whether p lies inside the mesh of ifsBuildHullMesh(level, margin): a
+// point is inside a tetrahedron with center c and vertices c + r * a_i
+// when dot(p - c, a_i) >= -r for every face
+static inline int ifsInsideHull(int level, float margin, DEVec3 p) {
+    long long count = ifsTetraCount(level);
+    float r = ldexpf(1.0f, -level) + margin * 1.7320508f;
+
+    for (long long i = 0; i < count; i++) {
+        DEVec3 c = ifsLeafCenter(level, i);
+        DEVec3 d = {p.x - c.x, p.y - c.y, p.z - c.z};
+        int inside = 1;
+        for (int f = 0; f < 4 && inside; f++) {
+            const DEVec3* a = &deVertices[f];
+            inside = d.x * a->x + d.y * a->y + d.z * a->z >= -r;
+        }
+        if (inside) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+#endif // IFS_TETRA_H
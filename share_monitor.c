@@ -0,0 +1,116 @@
+/*
+ * Shared Frame Monitor for sierpinski_enhanced.c --share NAME
+ * Attaches to the shared-memory frame ring of frame_share.h, follows it
+ * for a while and reports what arrived: the frame rate, the frames it
+ * missed and the latency from readback to arrival. It can write the last
+ * frame as a PPM.
+ *
+ *   share_monitor NAME [seconds] [last.ppm]
+ *
+ * Like any consumer it only reads the ring, so it can be started and
+ * stopped while the renderer runs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+#include "frame_share.h"
+
+// Writes an RGBA frame, rows bottom up, as a PPM
+static bool writeFrame(const char* path, const uint8_t* pixels, int width, int height) {
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "Could not open %s for writing\n", path);
+        return false;
+    }
+    unsigned char* row = (unsigned char*)malloc((size_t)width * 3);
+    bool ok = row && fprintf(file, "P6\n%d %d\n255\n", width, height) > 0;
+    for (int y = height - 1; ok && y >= 0; y--) {
+        const uint8_t* src = pixels + (size_t)y * width * 4;
+        for (int x = 0; x < width; x++) {
+            row[x * 3 + 0] = src[x * 4 + 0];
+            row[x * 3 + 1] = src[x * 4 + 1];
+            row[x * 3 + 2] = src[x * 4 + 2];
+        }
+        ok = fwrite(row, 1, (size_t)width * 3, file) == (size_t)width * 3;
+    }
+    free(row);
+    ok = fclose(file) == 0 && ok;
+    if (!ok) fprintf(stderr, "Failed to write %s\n", path);
+    return ok;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s NAME [seconds] [last.ppm]\n", argv[0]);
+        return 1;
+    }
+    const char* name = argv[1];
+    double seconds = argc > 2 ? atof(argv[2]) : 5.0;
+    const char* output = argc > 3 ? argv[3] : NULL;
+
+    FrameShareMapping mapping;
+    if (frameShareOpen(&mapping, name, 0, 0, 0) != 0) {
+        fprintf(stderr, "No shared frames named %s; is sierpinski_enhanced running with --share %s?\n", name, name);
+        frameShareClose(&mapping, name, 0);
+        return 1;
+    }
+    FrameShareHeader* header = mapping.header;
+    uint8_t* pixels = (uint8_t*)malloc((size_t)header->maxWidth * header->maxHeight * 4);
+    if (!pixels) {
+        frameShareClose(&mapping, name, 0);
+        return 1;
+    }
+    printf("Attached to %s: %u slots of up to %ux%u\n", name, header->slotCount, header->maxWidth,
+           header->maxHeight);
+
+    // Polls for new frames; a consumer with work of its own would take
+    // the newest whenever it is ready for one
+    Uint64 frequency = SDL_GetPerformanceFrequency();
+    Uint64 start = SDL_GetPerformanceCounter();
+    Uint64 now = start;
+    FrameShareSlot slot;
+    memset(&slot, 0, sizeof(slot));
+    int first = 0, last = 0, seen = 0;
+    double latencySum = 0.0, latencyMax = 0.0;
+    Uint64 firstTick = 0, lastTick = 0;
+    while ((now - start) / (double)frequency < seconds && SDL_AtomicGet(&header->open)) {
+        int number = frameShareRead(header, pixels, &slot);
+        now = SDL_GetPerformanceCounter();
+        if (number == 0 || number == last) {
+            SDL_Delay(1);
+            continue;
+        }
+        double latency = (double)now / frequency * 1e6 - (double)slot.timestamp;
+        latencySum += latency;
+        latencyMax = latency > latencyMax ? latency : latencyMax;
+        if (!first) {
+            first = number;
+            firstTick = now;
+        }
+        last = number;
+        lastTick = now;
+        seen++;
+    }
+
+    if (seen == 0) {
+        printf("No frames arrived%s\n", SDL_AtomicGet(&header->open) ? "" : "; the renderer has exited");
+    } else {
+        double span = (lastTick - firstTick) / (double)frequency;
+        printf("%d frames seen, %d missed, %.1f frames/s, latency %.2f ms mean, %.2f ms max\n", seen,
+               last - first + 1 - seen, span > 0.0 ? (seen - 1) / span : 0.0, latencySum / seen / 1000.0,
+               latencyMax / 1000.0);
+        printf("Last frame %d: %ux%u, time %.2f s, palette %d, camera (%.2f, %.2f, %.2f)\n", last - 1, slot.width,
+               slot.height, slot.time, slot.palette, slot.camPos[0], slot.camPos[1], slot.camPos[2]);
+    }
+    int exitCode = 0;
+    if (output && seen > 0 && !writeFrame(output, pixels, (int)slot.width, (int)slot.height)) {
+        exitCode = 1;
+    }
+    free(pixels);
+    frameShareClose(&mapping, name, 0);
+    return exitCode;
+}
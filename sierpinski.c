@@ -1,10 +1,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
 #include <math.h>
 #include <SDL2/SDL.h>
 #include <GL/glew.h>
 #include <SDL2/SDL_opengl.h>
+#include "de_kernels.h"
+#include "ifs_tetra.h"
 
 // Embedded vertex shader
 const char* vertexShaderSource = 
@@ -14,9 +17,18 @@ const char* vertexShaderSource =
 "    gl_Position = vec4(aPos, 0.0, 1.0);\n"
 "}\n";
 
+// Fragment shader prelude; the selected DE kernel from de_kernels.h and
+// the exact intersector from ifs_tetra.h are inserted between this and
+// the main fragment shader body
+const char* fragmentShaderPrelude =
+"#version 330 core\n"
+"#define DE_ITERATIONS 12\n";
+
+// Switches primary rays from sphere tracing to exact tetrahedron descent
+const char* exactIntersectorDefine = "#define EXACT_INTERSECTOR\n";
+
 // Embedded fragment shader
 const char* fragmentShaderSource =
-"#version 330 core\n"
 "out vec4 FragColor;\n"
 "uniform vec2 u_resolution;\n"
 "uniform float u_time;\n"
@@ -28,29 +40,10 @@ const char* fragmentShaderSource =
 "    return mat3(c, 0.0, s, 0.0, 1.0, 0.0, -s, 0.0, c);\n"
 "}\n"
 "\n"
-"// Sierpinski tetrahedron SDF using iterative folding\n"
+"// Sierpinski tetrahedron SDF (kernel supplied by de_kernels.h)\n"
 "float sierpinskiSDF(vec3 p) {\n"
-"    const int iterations = 12;\n"
-"    const float scale = 2.0;\n"
-"    vec3 a1 = vec3(1.0, 1.0, 1.0);\n"
-"    vec3 a2 = vec3(-1.0, -1.0, 1.0);\n"
-"    vec3 a3 = vec3(1.0, -1.0, -1.0);\n"
-"    vec3 a4 = vec3(-1.0, 1.0, -1.0);\n"
-"    vec3 c;\n"
-"    float dist, d;\n"
-"    int n = 0;\n"
-"    \n"
-"    // Iterative folding to create Sierpinski structure\n"
-"    for (n = 0; n < iterations; n++) {\n"
-"        c = a1; dist = length(p - a1);\n"
-"        d = length(p - a2); if (d < dist) { c = a2; dist = d; }\n"
-"        d = length(p - a3); if (d < dist) { c = a3; dist = d; }\n"
-"        d = length(p - a4); if (d < dist) { c = a4; dist = d; }\n"
-"        p = scale * p - c * (scale - 1.0);\n"
-"    }\n"
-"    \n"
-"    // Return scaled distance estimate\n"
-"    return length(p) * pow(scale, float(-n));\n"
+"    vec3 orbitTrap;\n"
+"    return deKernel(p, orbitTrap);\n"
 "}\n"
 "\n"
 "// Ray marching function\n"
@@ -130,14 +123,25 @@ const char* fragmentShaderSource =
 "    // Ray march\n"
 "    int steps;\n"
 "    float totalDist;\n"
+"#ifdef EXACT_INTERSECTOR\n"
+"    // Exact tetrahedron descent; steps counts visited nodes\n"
+"    vec3 exactNormal;\n"
+"    totalDist = intersectSierpinski(ro, rd, 20.0, exactNormal, steps);\n"
+"    float hit = totalDist;\n"
+"#else\n"
 "    float hit = rayMarch(ro, rd, steps, totalDist);\n"
+"#endif\n"
 "    \n"
 "    vec3 color = vec3(0.0);\n"
 "    \n"
 "    if (hit > -0.5) {\n"
 "        // Hit surface\n"
 "        vec3 pos = ro + rd * totalDist;\n"
+"#ifdef EXACT_INTERSECTOR\n"
+"        vec3 normal = exactNormal;\n"
+"#else\n"
 "        vec3 normal = calcNormal(pos);\n"
+"#endif\n"
 "        \n"
 "        // Lighting\n"
 "        vec3 lightDir = normalize(vec3(0.5, 0.8, 0.3));\n"
@@ -177,10 +181,10 @@ const char* fragmentShaderSource =
 "    FragColor = vec4(color, 1.0);\n"
 "}\n";
 
-// Shader compilation helper
-GLuint compileShader(GLenum type, const char* source) {
+// Shader compilation helper (sources are concatenated in order)
+GLuint compileShader(GLenum type, const char** sources, int count) {
     GLuint shader = glCreateShader(type);
-    glShaderSource(shader, 1, &source, NULL);
+    glShaderSource(shader, count, sources, NULL);
     glCompileShader(shader);
     
     GLint success;
@@ -195,9 +199,9 @@ GLuint compileShader(GLenum type, const char* source) {
 }
 
 // Program linking helper
-GLuint createShaderProgram(const char* vertSrc, const char* fragSrc) {
-    GLuint vertShader = compileShader(GL_VERTEX_SHADER, vertSrc);
-    GLuint fragShader = compileShader(GL_FRAGMENT_SHADER, fragSrc);
+GLuint createShaderProgram(const char* vertSrc, const char** fragSrcs, int fragCount) {
+    GLuint vertShader = compileShader(GL_VERTEX_SHADER, &vertSrc, 1);
+    GLuint fragShader = compileShader(GL_FRAGMENT_SHADER, fragSrcs, fragCount);
     
     GLuint program = glCreateProgram();
     glAttachShader(program, vertShader);
@@ -218,7 +222,48 @@ GLuint createShaderProgram(const char* vertSrc, const char* fragSrc) {
     return program;
 }
 
+// Build the fractal program around the given DE kernel and intersector
+GLuint createFractalProgram(int kernel, bool exact) {
+    const char* fragSrcs[] = {
+        fragmentShaderPrelude,
+        exact ? exactIntersectorDefine : "",
+        deKernels[kernel].glslSource,
+        ifsGlslIntersector,
+        fragmentShaderSource
+    };
+    return createShaderProgram(vertexShaderSource, fragSrcs, 5);
+}
+
 int main(int argc, char* argv[]) {
+    // Command line: --kernel <name> selects the distance estimator,
+    // --intersector march|exact the primary ray method
+    int kernel = deKernelFind("nearest-vertex");
+    bool exact = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--intersector") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "exact") == 0) {
+                exact = true;
+            } else if (strcmp(argv[i], "march") == 0) {
+                exact = false;
+            } else {
+                fprintf(stderr, "--intersector must be 'exact' or 'march'\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--kernel") == 0 && i + 1 < argc) {
+            kernel = deKernelFind(argv[++i]);
+            if (kernel < 0) {
+                fprintf(stderr, "Unknown DE kernel '%s'. Available kernels:\n", argv[i]);
+                deKernelPrintList(stderr);
+                return 1;
+            }
+        } else {
+            fprintf(stderr, "Unknown option '%s'\n", argv[i]);
+            fprintf(stderr, "Usage: %s [--kernel <name>] [--intersector march|exact]\n", argv[0]);
+            return 1;
+        }
+    }
+    
     // Initialize SDL
     if (SDL_Init(SDL_INIT_VIDEO) < 0) {
         fprintf(stderr, "SDL initialization failed: %s\n", SDL_GetError());
@@ -266,7 +311,9 @@ int main(int argc, char* argv[]) {
     }
     
     // Create shader program
-    GLuint shaderProgram = createShaderProgram(vertexShaderSource, fragmentShaderSource);
+    GLuint shaderProgram = createFractalProgram(kernel, exact);
+    printf("DE kernel: %s (press K to cycle)\n", deKernels[kernel].name);
+    printf("Intersector: %s (press X to toggle)\n", exact ? "exact" : "march");
     
     // Full-screen quad vertices (two triangles)
     float quadVertices[] = {
@@ -312,6 +359,19 @@ int main(int argc, char* argv[]) {
                 running = false;
             } else if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_ESCAPE) {
                 running = false;
+            } else if (event.type == SDL_KEYDOWN &&
+                       (event.key.keysym.sym == SDLK_k || event.key.keysym.sym == SDLK_x)) {
+                // Cycle DE kernel or toggle intersector, then rebuild the program
+                if (event.key.keysym.sym == SDLK_k) {
+                    kernel = (kernel + 1) % DE_KERNEL_COUNT;
+                } else {
+                    exact = !exact;
+                }
+                glDeleteProgram(shaderProgram);
+                shaderProgram = createFractalProgram(kernel, exact);
+                timeLocation = glGetUniformLocation(shaderProgram, "u_time");
+                resolutionLocation = glGetUniformLocation(shaderProgram, "u_resolution");
+                printf("DE kernel: %s, intersector: %s\n", deKernels[kernel].name, exact ? "exact" : "march");
             }
         }
         
@@ -15,10 +15,36 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
+#include <stdint.h>
 #include <math.h>
+#include <errno.h>
+#include <signal.h>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 #include <SDL2/SDL.h>
 #include <GL/glew.h>
 #include <SDL2/SDL_opengl.h>
+#include "de_kernels.h"
+#include "ifs_tetra.h"
+#include "frame_share.h"
+#include "frame_archive.h"
 
 // Embedded shader source code
 const char* vertexShaderSource = 
@@ -30,15 +56,76 @@ const char* vertexShaderSource =
 "    gl_Position = vec4(position, 0.0, 1.0);\n"
 "}\n";
 
-const char* fragmentShaderSource = 
+// Fragment shader prelude; the selected DE kernel from de_kernels.h and
+// the exact intersector from ifs_tetra.h are inserted between this and
+// the main fragment shader body
+const char* fragmentShaderPrelude =
 "#version 330 core\n"
+"#define DE_ITERATIONS 14\n";
+
+// Switches primary rays from sphere tracing to exact tetrahedron descent
+const char* exactIntersectorDefine = "#define EXACT_INTERSECTOR\n";
+
+// Shades each MSAA sample once instead of looping over a 2x2 grid
+const char* sampleShadingDefine =
+"#extension GL_ARB_sample_shading : require\n"
+"#define SAMPLE_SHADING\n";
+
+// The fractal's color grade: bloom lift, contrast, saturation and gamma.
+// The fractal shader applies it to LDR frames; the tone-mapping pass
+// applies it, or a filmic curve, to HDR ones.
+const char* colorGradeSource =
+"vec3 colorGrade(vec3 color) {\n"
+"    // Subtle bloom\n"
+"    float brightness = dot(color, vec3(0.2126, 0.7152, 0.0722));\n"
+"    if (brightness > 0.8) {\n"
+"        color += (color - 0.8) * 0.3;\n"
+"    }\n"
+"    \n"
+"    // Color grading\n"
+"    color = pow(color, vec3(0.9)); // Slight contrast\n"
+"    color = mix(vec3(dot(color, vec3(0.299, 0.587, 0.114))), color, 1.1); // Saturation boost\n"
+"    \n"
+"    // Gamma correction\n"
+"    return pow(color, vec3(0.4545));\n"
+"}\n";
+
+const char* fragmentShaderSource = 
 "in vec2 v_uv;\n"
 "uniform vec2 u_resolution;\n"
 "uniform float u_time;\n"
 "uniform vec3 u_camPos;\n"
 "uniform mat3 u_rotation;\n"
 "uniform int u_colorPalette;\n"
-"out vec4 fragColor;\n"
+"uniform sampler2D u_hullDepth;\n"
+"uniform int u_depthPrepass;\n"
+"uniform sampler3D u_lightingVolume;\n"
+"uniform int u_bakedLighting;\n"
+"uniform int u_reflectionSlices;\n"
+"uniform int u_reflectionSlice;\n"
+"uniform sampler2D u_reflectionHistory;\n"
+"uniform int u_historyValid;\n"
+"uniform vec3 u_prevCamPos;\n"
+"uniform mat3 u_prevRotation;\n"
+"uniform sampler2D u_blueNoise;\n"
+"uniform int u_jitter;\n"
+"uniform vec4 u_noiseOffset;\n"
+"uniform int u_glowSteps;\n"
+"uniform int u_aaGrid;\n"
+"uniform int u_sampleShading;\n"
+"uniform int u_checkerboard;\n"
+"uniform int u_checkerParity;\n"
+"uniform int u_pixelScale;\n"
+"uniform vec2 u_rateRegion;\n"
+"uniform int u_panorama;\n"
+"uniform int u_hdr;\n"
+"uniform vec3 u_panoramaTile;\n"
+"uniform vec2 u_tileOrigin;\n"
+"layout(location = 0) out vec4 fragColor;\n"
+"// Time-sliced reflections: pixel-average reflection and first-hit distance.\n"
+"// Otherwise orbit trap and distance of the first hit, for the checkerboard\n"
+"// reconstruction and the denoiser.\n"
+"layout(location = 1) out vec4 reflectionOut;\n"
 "\n"
 "// Constants\n"
 "const float PI = 3.14159265359;\n"
@@ -46,40 +133,20 @@ const char* fragmentShaderSource =
 "const int MAX_MARCH_STEPS = 200;\n"
 "const float MAX_DIST = 50.0;\n"
 "const float HIT_THRESHOLD = 0.0001;\n"
-"const int FRACTAL_ITERATIONS = 14;\n"
-"const float FRACTAL_SCALE = 2.0;\n"
+"const float CAMERA_FOCAL = 1.8;\n"
+"const float HULL_NEAR = 0.05;\n"
+"\n"
+"// Shadow-casting lights, fixed in world space\n"
+"const vec3 LIGHT_DIR1 = vec3(0.57735027, 0.57735027, -0.57735027); // normalize(1, 1, -1)\n"
+"const vec3 LIGHT_DIR2 = vec3(-0.72739297, 0.58191437, 0.36369648); // normalize(-1, 0.8, 0.5)\n"
+"\n"
+"// The baked shadow/AO volume covers [-BAKE_EXTENT, BAKE_EXTENT]^3\n"
+"const float BAKE_EXTENT = 1.1;\n"
 "\n"
 "// Advanced Sierpinski Tetrahedron with enhanced orbit traps\n"
+"// (distance estimator kernel supplied by de_kernels.h)\n"
 "float sdSierpinski(vec3 p, out vec3 orbitTrap) {\n"
-"    vec3 z = p;\n"
-"    float r = 0.0;\n"
-"    float dr = 1.0;\n"
-"    orbitTrap = vec3(1e10);\n"
-"    float minDist = 1e10;\n"
-"    \n"
-"    for (int n = 0; n < FRACTAL_ITERATIONS; n++) {\n"
-"        // Tetrahedral folding symmetry\n"
-"        if (z.x + z.y < 0.0) z.xy = -z.yx;\n"
-"        if (z.x + z.z < 0.0) z.xz = -z.zx;\n"
-"        if (z.y + z.z < 0.0) z.zy = -z.yz;\n"
-"        \n"
-"        // Additional fold for more detail\n"
-"        if (z.x - z.y < 0.0) z.xy = z.yx;\n"
-"        \n"
-"        // Scale and translate\n"
-"        z = z * FRACTAL_SCALE - 1.0 * (FRACTAL_SCALE - 1.0);\n"
-"        dr = dr * FRACTAL_SCALE;\n"
-"        \n"
-"        // Enhanced orbit traps for coloring\n"
-"        float d = length(z);\n"
-"        minDist = min(minDist, d);\n"
-"        orbitTrap.x = min(orbitTrap.x, d);\n"
-"        orbitTrap.y = min(orbitTrap.y, abs(z.x) + abs(z.y) + abs(z.z));\n"
-"        orbitTrap.z = min(orbitTrap.z, dot(z, z));\n"
-"    }\n"
-"    \n"
-"    r = length(z);\n"
-"    return 0.5 * r / dr;\n"
+"    return 0.5 * deKernel(p, orbitTrap);\n"
 "}\n"
 "\n"
 "// Wrapper for simple distance queries\n"
@@ -127,9 +194,18 @@ const char* fragmentShaderSource =
 "    return clamp(res, 0.0, 1.0);\n"
 "}\n"
 "\n"
+"// Baked light 1 / light 2 visibility and AO at a surface point; the\n"
+"// lookup is pushed off the surface so it does not blend in voxels\n"
+"// inside the solid, which are fully shadowed\n"
+"vec3 sampleBakedLighting(vec3 p, vec3 n) {\n"
+"    float voxel = 2.0 * BAKE_EXTENT / float(textureSize(u_lightingVolume, 0).x);\n"
+"    vec3 q = p + n * (1.5 * voxel);\n"
+"    return texture(u_lightingVolume, q / (2.0 * BAKE_EXTENT) + 0.5).rgb;\n"
+"}\n"
+"\n"
 "// Ray marching with orbit trap output\n"
-"float rayMarch(vec3 ro, vec3 rd, out vec3 orbitTrap) {\n"
-"    float t = 0.0;\n"
+"float rayMarch(vec3 ro, vec3 rd, float tStart, out vec3 orbitTrap) {\n"
+"    float t = tStart;\n"
 "    orbitTrap = vec3(1e10);\n"
 "    \n"
 "    for (int i = 0; i < MAX_MARCH_STEPS; i++) {\n"
@@ -148,6 +224,28 @@ const char* fragmentShaderSource =
 "    return -1.0;\n"
 "}\n"
 "\n"
+"// Nearest bounding-hull depth over the footprint of all AA samples,\n"
+"// which lie between this pixel center and the next one up and right\n"
+"// (a coarse pixel further at reduced shading rates; MSAA samples spread\n"
+"// half a pixel either way, well inside HULL_MARGIN)\n"
+"float hullDepthAt(ivec2 px) {\n"
+"    ivec2 maxPx = textureSize(u_hullDepth, 0) - 1;\n"
+"    int step = max(u_pixelScale, 1);\n"
+"    float d = texelFetch(u_hullDepth, min(px, maxPx), 0).r;\n"
+"    d = min(d, texelFetch(u_hullDepth, min(px + ivec2(step, 0), maxPx), 0).r);\n"
+"    d = min(d, texelFetch(u_hullDepth, min(px + ivec2(0, step), maxPx), 0).r);\n"
+"    d = min(d, texelFetch(u_hullDepth, min(px + ivec2(step, step), maxPx), 0).r);\n"
+"    return d;\n"
+"}\n"
+"\n"
+"// Ray distance to the hull from its depth-buffer value, for the ray\n"
+"// with camera-space direction (uv, -CAMERA_FOCAL)\n"
+"float hullStartT(float depth, vec2 uv) {\n"
+"    float ndc = depth * 2.0 - 1.0;\n"
+"    float viewZ = 2.0 * HULL_NEAR * MAX_DIST / (MAX_DIST + HULL_NEAR - ndc * (MAX_DIST - HULL_NEAR));\n"
+"    return viewZ * length(vec3(uv, -CAMERA_FOCAL)) / CAMERA_FOCAL;\n"
+"}\n"
+"\n"
 "// Procedural starfield skybox\n"
 "vec3 getSkyColor(vec3 rd) {\n"
 "    // Gradient background\n"
@@ -212,25 +310,36 @@ const char* fragmentShaderSource =
 "    return col;\n"
 "}\n"
 "\n"
-"// Volumetric glow effect\n"
-"vec3 getVolumetricGlow(vec3 ro, vec3 rd, float maxT) {\n"
+"// Volumetric glow effect; jitter in [0, 1) shortens the first step so\n"
+"// neighbouring pixels sample at different depths. nearestT is where the\n"
+"// ray passes closest to the surface, which is where most glow comes from.\n"
+"vec3 getVolumetricGlow(vec3 ro, vec3 rd, float maxT, float jitter, out float nearestT) {\n"
 "    vec3 glow = vec3(0.0);\n"
 "    float t = 0.0;\n"
-"    for (int i = 0; i < 32; i++) {\n"
+"    float nearestD = 1e10;\n"
+"    nearestT = MAX_DIST;\n"
+"    // Steps are sized for 32, so any count covers the same distance and\n"
+"    // each sample stands for its share of it\n"
+"    float stepScale = 32.0 / float(u_glowSteps);\n"
+"    for (int i = 0; i < u_glowSteps; i++) {\n"
 "        vec3 p = ro + rd * t;\n"
 "        float d = map(p);\n"
 "        \n"
 "        // Accumulate glow near surface\n"
 "        float glowFactor = 0.015 / (0.01 + d * d);\n"
+"        if (d < nearestD) {\n"
+"            nearestD = d;\n"
+"            nearestT = t;\n"
+"        }\n"
 "        vec3 orbitTrap;\n"
 "        sdSierpinski(p, orbitTrap);\n"
 "        vec3 glowCol = getColorPalette(orbitTrap.x * 0.5 + u_time * 0.2, u_colorPalette);\n"
 "        glow += glowCol * glowFactor * 0.002;\n"
 "        \n"
-"        t += max(0.05, d * 0.5);\n"
+"        t += max(0.05, d * 0.5) * stepScale * (i == 0 ? 1.0 - jitter : 1.0);\n"
 "        if (t > maxT || t > MAX_DIST) break;\n"
 "    }\n"
-"    return glow;\n"
+"    return glow * stepScale;\n"
 "}\n"
 "\n"
 "// Reflection ray marching (single bounce)\n"
@@ -239,7 +348,7 @@ const char* fragmentShaderSource =
 "    vec3 reflectDir = reflect(rd, normal);\n"
 "    \n"
 "    vec3 orbitTrap;\n"
-"    float t = rayMarch(ro + normal * 0.01, reflectDir, orbitTrap);\n"
+"    float t = rayMarch(ro + normal * 0.01, reflectDir, 0.0, orbitTrap);\n"
 "    \n"
 "    if (t > 0.0) {\n"
 "        vec3 p = ro + normal * 0.01 + reflectDir * t;\n"
@@ -257,6 +366,72 @@ const char* fragmentShaderSource =
 "    return getSkyColor(reflectDir);\n"
 "}\n"
 "\n"
+"// Window position of the pixel this fragment shades. A checkerboard\n"
+"// field is packed into a half-width target: row y holds the pixels\n"
+"// x = 2i + ((y + parity) & 1). At a reduced shading rate a fragment\n"
+"// covers u_pixelScale^2 window pixels and shades their center. A\n"
+"// panorama tile starts at fragment u_panoramaTile.xy of its strip, and\n"
+"// a fragment covers u_panoramaTile.z panorama pixels across.\n"
+"vec2 pixelCenter() {\n"
+"    if (u_panorama == 1) {\n"
+"        return vec2((floor(gl_FragCoord.x) + u_panoramaTile.x + 0.5) * u_panoramaTile.z,\n"
+"                    gl_FragCoord.y + u_panoramaTile.y);\n"
+"    }\n"
+"    if (u_checkerboard == 1) {\n"
+"        float shift = float((int(gl_FragCoord.y) + u_checkerParity) & 1);\n"
+"        return vec2(floor(gl_FragCoord.x) * 2.0 + shift + 0.5, gl_FragCoord.y);\n"
+"    }\n"
+"    if (u_pixelScale > 1) return (floor(gl_FragCoord.xy) + 0.5) * float(u_pixelScale);\n"
+"    return gl_FragCoord.xy + u_tileOrigin;\n"
+"}\n"
+"\n"
+"// Four blue-noise values in [0, 1) for AA sample s of this pixel: AA\n"
+"// jitter (xy), glow start (z) and shadow start (w). Each sample reads a\n"
+"// shifted copy of the tile and every frame rotates the values by a\n"
+"// different irrational step. All zero with jitter off.\n"
+"vec4 sampleNoise(int s) {\n"
+"    if (u_jitter == 0) return vec4(0.0);\n"
+"    ivec2 size = textureSize(u_blueNoise, 0);\n"
+"    ivec2 px = (ivec2(pixelCenter()) + s * ivec2(23, 41)) % size;\n"
+"    return fract(texelFetch(u_blueNoise, px, 0) + u_noiseOffset);\n"
+"}\n"
+"\n"
+"// Time-sliced reflections are retraced for pixels whose slot matches the\n"
+"// frame. Slots go to 8x8-pixel blocks so neighbouring fragments, which\n"
+"// execute together, agree; 4x4 Bayer order spreads them evenly.\n"
+"int reflectionSlot(ivec2 px) {\n"
+"    const int bayer[16] = int[16](0, 8, 2, 10, 12, 4, 14, 6, 3, 11, 1, 9, 15, 7, 13, 5);\n"
+"    ivec2 block = px >> 3;\n"
+"    return bayer[(block.y & 3) * 4 + (block.x & 3)] % u_reflectionSlices;\n"
+"}\n"
+"\n"
+"// Reflection history for world point p, found by projecting p into the\n"
+"// previous frame. Fails when p is off screen there or another surface\n"
+"// was stored at that pixel (disocclusion).\n"
+"bool reprojectReflection(vec3 p, out vec3 reflection) {\n"
+"    reflection = vec3(0.0);\n"
+"    if (u_historyValid == 0) return false;\n"
+"    vec3 q = transpose(u_prevRotation) * (p - u_prevCamPos);\n"
+"    if (q.z > -HULL_NEAR) return false;\n"
+"    vec2 prevUV = q.xy * (CAMERA_FOCAL / -q.z);\n"
+"    ivec2 px = ivec2(floor(prevUV * u_resolution.y + 0.5 * u_resolution));\n"
+"    if (any(lessThan(px, ivec2(0))) || any(greaterThanEqual(px, ivec2(u_resolution)))) return false;\n"
+"    vec4 history = texelFetch(u_reflectionHistory, px, 0);\n"
+"    float dist = length(p - u_prevCamPos);\n"
+"    if (history.a <= 0.0 || abs(history.a - dist) > 0.02 * dist) return false;\n"
+"    reflection = history.rgb;\n"
+"    return true;\n"
+"}\n"
+"\n"
+"// Equirectangular panorama direction for uv: longitude across the full\n"
+"// width, zero straight ahead, latitude from the bottom to the top pole\n"
+"vec3 panoramaRay(vec2 uv) {\n"
+"    vec2 p = uv * u_resolution.y / u_resolution;\n"
+"    float longitude = p.x * 2.0 * PI;\n"
+"    float latitude = p.y * PI;\n"
+"    return vec3(sin(longitude) * cos(latitude), sin(latitude), -cos(longitude) * cos(latitude));\n"
+"}\n"
+"\n"
 "// Chromatic aberration post-process\n"
 "vec3 chromaticAberration(vec2 uv, float amount) {\n"
 "    // This is simplified - just returns direction for offset\n"
@@ -264,53 +439,127 @@ const char* fragmentShaderSource =
 "    return vec3(length(dir)) * amount;\n"
 "}\n"
 "\n"
+"#if !defined(LIGHTING_BAKE) && !defined(PREVIEW_QUALITY) && !defined(TILE_COST)\n"
 "void main() {\n"
 "    // Normalize pixel coordinates with slight chromatic aberration\n"
-"    vec2 uv = (gl_FragCoord.xy - 0.5 * u_resolution) / u_resolution.y;\n"
+"    vec2 fragCoord = pixelCenter();\n"
+"    vec2 uv = (fragCoord - 0.5 * u_resolution) / u_resolution.y;\n"
+"    \n"
+"    // Variable-rate passes shade only their ring around the center\n"
+"    float ringRadius = length(uv);\n"
+"    if (ringRadius < u_rateRegion.x || ringRadius > u_rateRegion.y) discard;\n"
+"    \n"
+"    // Bounding-hull pre-pass: pixels the hull does not cover are pure\n"
+"    // sky, covered ones start marching at the hull surface\n"
+"    bool hullCovered = true;\n"
+"    float hullDepth = 0.0;\n"
+"    if (u_depthPrepass == 1) {\n"
+"        hullDepth = hullDepthAt(ivec2(fragCoord));\n"
+"        hullCovered = hullDepth < 1.0;\n"
+"    }\n"
+"    \n"
+"    // Time-sliced reflections: only this frame's slot traces, the rest\n"
+"    // reuse history reprojected at the first hit\n"
+"    bool traceReflections = u_reflectionSlices <= 1 ||\n"
+"                            reflectionSlot(ivec2(fragCoord)) == u_reflectionSlice;\n"
+"    bool historyChecked = false;\n"
+"    vec3 historyReflection = vec3(0.0);\n"
+"    vec3 reflectionSum = vec3(0.0);\n"
+"    int reflectionCount = 0;\n"
+"    float firstHitDist = -1.0;\n"
+"    float glowDist = MAX_DIST;\n"
+"    vec3 firstHitTrap = vec3(0.0);\n"
 "    \n"
-"    // Anti-aliasing via supersampling (2x2)\n"
+"    // Anti-aliasing via supersampling (2x2, or a single sample with --spp\n"
+"    // 1), or one invocation per MSAA sample at its own position, averaged\n"
+"    // by the multisample resolve. The per-sample variant falls back to the\n"
+"    // grid when it draws into a single-sampled target.\n"
+"#ifdef SAMPLE_SHADING\n"
+"    bool perSample = u_sampleShading == 1;\n"
+"#else\n"
+"    bool perSample = false;\n"
+"#endif\n"
+"    int AA_GRID = perSample ? 1 : u_aaGrid;\n"
 "    vec3 finalColor = vec3(0.0);\n"
 "    \n"
-"    for (int aa_x = 0; aa_x < 2; aa_x++) {\n"
-"        for (int aa_y = 0; aa_y < 2; aa_y++) {\n"
-"            vec2 offset = vec2(float(aa_x), float(aa_y)) / u_resolution.y * 0.5;\n"
+"    for (int aa_x = 0; aa_x < AA_GRID; aa_x++) {\n"
+"        for (int aa_y = 0; aa_y < AA_GRID; aa_y++) {\n"
+"            // Jitter stays inside each sample's cell of the grid\n"
+"            vec4 noise = sampleNoise(aa_x * 2 + aa_y);\n"
+"            vec2 offset = (vec2(float(aa_x), float(aa_y)) + noise.xy) * float(u_pixelScale) / u_resolution.y /\n"
+"                          float(AA_GRID);\n"
+"#ifdef SAMPLE_SHADING\n"
+"            if (perSample) {\n"
+"                noise = sampleNoise(gl_SampleID);\n"
+"                offset = (floor(gl_FragCoord.xy) + gl_SamplePosition - gl_FragCoord.xy) / u_resolution.y;\n"
+"            }\n"
+"#endif\n"
+"            if (u_panorama == 1) offset.x *= u_panoramaTile.z;\n"
 "            vec2 uv_aa = uv + offset;\n"
 "            \n"
 "            // Camera setup\n"
 "            vec3 ro = u_camPos;\n"
-"            vec3 rd = normalize(vec3(uv_aa, -1.8));\n"
+"            vec3 rd = u_panorama == 1 ? panoramaRay(uv_aa) : normalize(vec3(uv_aa, -CAMERA_FOCAL));\n"
 "            rd = u_rotation * rd;\n"
 "            \n"
 "            // Background\n"
 "            vec3 col = getSkyColor(rd);\n"
+"            if (!hullCovered) {\n"
+"                finalColor += col;\n"
+"                continue;\n"
+"            }\n"
+"            float tStart = u_depthPrepass == 1 ? max(hullStartT(hullDepth, uv_aa) - 0.001, 0.0) : 0.0;\n"
 "            \n"
+"#ifdef EXACT_INTERSECTOR\n"
+"            // Exact tetrahedron descent; orbit trap sampled at the hit only\n"
+"            vec3 orbitTrap = vec3(1e10);\n"
+"            vec3 exactNormal;\n"
+"            int visited;\n"
+"            float t = intersectSierpinski(ro, rd, MAX_DIST, exactNormal, visited);\n"
+"            if (t >= 0.0) sdSierpinski(ro + rd * t, orbitTrap);\n"
+"#else\n"
 "            // Ray march\n"
 "            vec3 orbitTrap;\n"
-"            float t = rayMarch(ro, rd, orbitTrap);\n"
+"            float t = rayMarch(ro, rd, tStart, orbitTrap);\n"
+"#endif\n"
 "            \n"
-"            // Add volumetric glow\n"
-"            vec3 glow = getVolumetricGlow(ro, rd, t > 0.0 ? t : MAX_DIST);\n"
+"            // Add volumetric glow; both intersectors return -1 for a miss\n"
+"            // and 0 for a camera on the surface\n"
+"            float nearestT;\n"
+"            vec3 glow = getVolumetricGlow(ro, rd, t >= 0.0 ? t : MAX_DIST, noise.z, nearestT);\n"
+"            if (aa_x == 0 && aa_y == 0) glowDist = nearestT;\n"
 "            \n"
-"            if (t > 0.0) {\n"
+"            if (t >= 0.0) {\n"
 "                // Hit! Calculate advanced lighting\n"
 "                vec3 p = ro + rd * t;\n"
+"#ifdef EXACT_INTERSECTOR\n"
+"                vec3 normal = exactNormal;\n"
+"#else\n"
 "                vec3 normal = calcNormal(p);\n"
+"#endif\n"
 "                \n"
 "                // Multi-light setup\n"
-"                vec3 lightDir1 = normalize(vec3(1.0, 1.0, -1.0));\n"
-"                vec3 lightDir2 = normalize(vec3(-1.0, 0.8, 0.5));\n"
+"                vec3 lightDir1 = LIGHT_DIR1;\n"
+"                vec3 lightDir2 = LIGHT_DIR2;\n"
 "                vec3 lightDir3 = normalize(vec3(0.0, -1.0, 0.0));\n"
 "                \n"
 "                vec3 lightCol1 = vec3(1.0, 0.95, 0.9);\n"
 "                vec3 lightCol2 = vec3(0.5, 0.6, 1.0);\n"
 "                vec3 lightCol3 = vec3(0.8, 0.3, 0.9);\n"
 "                \n"
-"                // Shadows\n"
-"                float shadow1 = calcShadow(p, lightDir1, 0.02, 5.0, 8.0);\n"
-"                float shadow2 = calcShadow(p, lightDir2, 0.02, 5.0, 8.0);\n"
-"                \n"
-"                // Ambient occlusion\n"
-"                float ao = calcAO(p, normal);\n"
+"                // Shadows and ambient occlusion, baked or marched per pixel\n"
+"                float shadow1, shadow2, ao;\n"
+"                if (u_bakedLighting == 1) {\n"
+"                    vec3 baked = sampleBakedLighting(p, normal);\n"
+"                    shadow1 = baked.r;\n"
+"                    shadow2 = baked.g;\n"
+"                    ao = baked.b;\n"
+"                } else {\n"
+"                    float shadowStart = 0.02 * (1.0 + noise.w);\n"
+"                    shadow1 = calcShadow(p, lightDir1, shadowStart, 5.0, 8.0);\n"
+"                    shadow2 = calcShadow(p, lightDir2, shadowStart, 5.0, 8.0);\n"
+"                    ao = calcAO(p, normal);\n"
+"                }\n"
 "                \n"
 "                // Diffuse lighting\n"
 "                float diff1 = max(dot(normal, lightDir1), 0.0) * shadow1;\n"
@@ -349,7 +598,16 @@ const char* fragmentShaderSource =
 "                );\n"
 "                \n"
 "                // Reflections\n"
-"                vec3 reflection = traceReflection(p, rd, normal, baseCol, roughness);\n"
+"                if (!historyChecked) {\n"
+"                    historyChecked = true;\n"
+"                    firstHitDist = t;\n"
+"                    firstHitTrap = orbitTrap;\n"
+"                    if (!traceReflections) traceReflections = !reprojectReflection(p, historyReflection);\n"
+"                }\n"
+"                vec3 reflection = traceReflections ? traceReflection(p, rd, normal, baseCol, roughness)\n"
+"                                                   : historyReflection;\n"
+"                reflectionSum += reflection;\n"
+"                reflectionCount++;\n"
 "                \n"
 "                // Combine with metallic/fresnel\n"
 "                col = mix(diffuse, reflection, fresnel * metallic * 0.7);\n"
@@ -372,43 +630,721 @@ const char* fragmentShaderSource =
 "    }\n"
 "    \n"
 "    // Average anti-aliasing samples\n"
-"    finalColor /= 4.0;\n"
+"    finalColor /= float(AA_GRID * AA_GRID);\n"
 "    \n"
 "    // Post-processing effects\n"
 "    \n"
 "    // Vignette\n"
-"    vec2 vignetteUV = gl_FragCoord.xy / u_resolution - 0.5;\n"
+"    vec2 vignetteUV = fragCoord / u_resolution - 0.5;\n"
 "    float vignette = 1.0 - dot(vignetteUV, vignetteUV) * 0.3;\n"
-"    finalColor *= vignette;\n"
+"    if (u_panorama == 0) finalColor *= vignette;\n"
 "    \n"
-"    // Subtle bloom\n"
-"    float brightness = dot(finalColor, vec3(0.2126, 0.7152, 0.0722));\n"
-"    if (brightness > 0.8) {\n"
-"        finalColor += (finalColor - 0.8) * 0.3;\n"
+"    // HDR frames stay linear for the tone-mapping pass\n"
+"    if (u_hdr == 0) finalColor = colorGrade(finalColor);\n"
+"    \n"
+"    fragColor = vec4(finalColor, 1.0);\n"
+"    // Sky stores the negated distance of its glow\n"
+"    if (firstHitDist < 0.0) firstHitDist = -glowDist;\n"
+"    if (u_reflectionSlices == 1) {\n"
+"        reflectionOut = vec4(firstHitTrap, firstHitDist);\n"
+"    } else {\n"
+"        reflectionOut = vec4(reflectionSum / float(max(reflectionCount, 1)), firstHitDist);\n"
+"    }\n"
+"}\n"
+"#endif\n";
+
+// Switches the fractal shader's main() for the quick preview below
+const char* previewQualityDefine = "#define PREVIEW_QUALITY\n";
+
+// Shown while the full shader compiles at startup: one ray-marched sample
+// per pixel with diffuse lighting only, which compiles many times faster
+const char* previewShaderSource =
+"void main() {\n"
+"    vec2 uv = (gl_FragCoord.xy - 0.5 * u_resolution) / u_resolution.y;\n"
+"    vec3 ro = u_camPos;\n"
+"    vec3 rd = u_rotation * normalize(vec3(uv, -CAMERA_FOCAL));\n"
+"    vec3 col = getSkyColor(rd);\n"
+"    vec3 orbitTrap;\n"
+"    float t = rayMarch(ro, rd, 0.0, orbitTrap);\n"
+"    if (t > 0.0) {\n"
+"        vec3 normal = calcNormal(ro + rd * t);\n"
+"        vec3 baseCol = getEnhancedColor(orbitTrap, normal, t);\n"
+"        float diff = max(dot(normal, LIGHT_DIR1), 0.0) * 0.7 + max(dot(normal, LIGHT_DIR2), 0.0) * 0.3;\n"
+"        col = mix(col, baseCol * (0.1 + diff), exp(-t * 0.04));\n"
+"    }\n"
+"    fragColor = vec4(pow(col, vec3(0.4545)), 1.0);\n"
+"}\n";
+
+// Switches the fractal shader's main() for the tile cost estimate below
+const char* tileCostDefine = "#define TILE_COST\n";
+
+// Tile cost estimate for the tile coordinator, at a fraction of the
+// frame's resolution: each pixel marches one primary ray and counts DE
+// evaluations. Hits add a fixed cost for the normal, shadow, AO and
+// reflection rays that follow them.
+const char* tileCostShaderSource =
+"uniform float u_costStep;\n"
+"const float TILE_HIT_COST = 50.0;\n"
+"void main() {\n"
+"    vec2 uv = (gl_FragCoord.xy * u_costStep - 0.5 * u_resolution) / u_resolution.y;\n"
+"    vec3 rd = u_rotation * normalize(vec3(uv, -CAMERA_FOCAL));\n"
+"    float t = 0.0;\n"
+"    float steps = 0.0;\n"
+"    for (int i = 0; i < MAX_MARCH_STEPS; i++) {\n"
+"        vec3 trap;\n"
+"        float d = sdSierpinski(u_camPos + rd * t, trap);\n"
+"        steps += 1.0;\n"
+"        if (d < HIT_THRESHOLD) {\n"
+"            steps += TILE_HIT_COST;\n"
+"            break;\n"
+"        }\n"
+"        t += d * 0.6;\n"
+"        if (t > MAX_DIST) break;\n"
+"    }\n"
+"    fragColor = vec4(steps, 0.0, 0.0, 1.0);\n"
+"}\n";
+
+// Switches the fractal shader's main() for the lighting bake below
+const char* lightingBakeDefine = "#define LIGHTING_BAKE\n";
+
+// Lighting bake: one fragment per voxel of slice u_bakeSlice, storing the
+// same soft shadows and AO the shading loop computes (the geometry and
+// lights are static, only the camera moves). AO uses the DE gradient at
+// the voxel center as its normal.
+const char* lightingBakeShaderSource =
+"uniform float u_bakeSlice;\n"
+"uniform float u_bakeResolution;\n"
+"void main() {\n"
+"    vec3 cell = vec3(gl_FragCoord.xy, u_bakeSlice + 0.5) / u_bakeResolution;\n"
+"    vec3 p = (cell * 2.0 - 1.0) * BAKE_EXTENT;\n"
+"    float shadow1 = calcShadow(p, LIGHT_DIR1, 0.02, 5.0, 8.0);\n"
+"    float shadow2 = calcShadow(p, LIGHT_DIR2, 0.02, 5.0, 8.0);\n"
+"    float ao = calcAO(p, calcNormal(p));\n"
+"    fragColor = vec4(shadow1, shadow2, ao, 1.0);\n"
+"}\n";
+
+// Bounding-hull pre-pass: rasterizes inflated level-n tetrahedra with the
+// fractal camera (ray = u_rotation * (uv, -1.8)) so the depth buffer
+// holds a conservative per-pixel start distance for the march
+const char* hullVertexShaderSource =
+"#version 330 core\n"
+"layout(location = 0) in vec3 position;\n"
+"uniform vec2 u_resolution;\n"
+"uniform vec3 u_camPos;\n"
+"uniform mat3 u_rotation;\n"
+"const float CAMERA_FOCAL = 1.8;\n"
+"const float HULL_NEAR = 0.05;\n"
+"const float MAX_DIST = 50.0;\n"
+"void main() {\n"
+"    // World to camera space; the rotation is orthonormal\n"
+"    vec3 q = transpose(u_rotation) * (position - u_camPos);\n"
+"    float aspect = u_resolution.y / u_resolution.x;\n"
+"    float a = -(MAX_DIST + HULL_NEAR) / (MAX_DIST - HULL_NEAR);\n"
+"    float b = -2.0 * MAX_DIST * HULL_NEAR / (MAX_DIST - HULL_NEAR);\n"
+"    gl_Position = vec4(2.0 * CAMERA_FOCAL * aspect * q.x, 2.0 * CAMERA_FOCAL * q.y, a * q.z + b, -q.z);\n"
+"}\n";
+
+const char* hullFragmentShaderSource =
+"#version 330 core\n"
+"void main() {\n"
+"}\n";
+
+// Copies the color of an offscreen frame to the window, or to the
+// viewport at u_offset
+const char* copyFragmentShaderSource =
+"#version 330 core\n"
+"uniform sampler2D u_source;\n"
+"uniform ivec2 u_offset;\n"
+"out vec4 fragColor;\n"
+"void main() {\n"
+"    fragColor = texelFetch(u_source, ivec2(gl_FragCoord.xy) - u_offset, 0);\n"
+"}\n";
+
+// Completes a checkerboard frame. Shaded pixels come from the field;
+// each of the others is reprojected into the previous complete frame at
+// a guessed hit distance (its own from that frame, then those of its four
+// shaded neighbours) and takes the stored color if the distance stored
+// there agrees. Disoccluded pixels interpolate the neighbour pair,
+// horizontal or vertical, whose distance and orbit trap match best, so
+// fractal edges are not smeared across.
+const char* checkerboardFragmentShaderSource =
+"#version 330 core\n"
+"uniform sampler2D u_field;\n"
+"uniform sampler2D u_fieldGuide;\n"
+"uniform sampler2D u_history;\n"
+"uniform sampler2D u_historyGuide;\n"
+"uniform int u_parity;\n"
+"uniform int u_historyValid;\n"
+"uniform vec2 u_resolution;\n"
+"uniform vec3 u_camPos;\n"
+"uniform mat3 u_rotation;\n"
+"uniform vec3 u_prevCamPos;\n"
+"uniform mat3 u_prevRotation;\n"
+"layout(location = 0) out vec4 fragColor;\n"
+"// Orbit trap and hit distance (negative for sky), as in the field\n"
+"layout(location = 1) out vec4 guideOut;\n"
+"const float CAMERA_FOCAL = 1.8;\n"
+"const float HULL_NEAR = 0.05;\n"
+"\n"
+"// Previous-frame pixel that saw the point at distance dist along rd\n"
+"// (dist <= 0: the sky in direction rd). False when it is off screen or\n"
+"// something else was stored there.\n"
+"bool reproject(vec3 rd, float dist, out ivec2 h) {\n"
+"    vec3 q = transpose(u_prevRotation) * (dist > 0.0 ? u_camPos + rd * dist - u_prevCamPos : rd);\n"
+"    h = ivec2(0);\n"
+"    if (q.z > -HULL_NEAR * length(q)) return false;\n"
+"    vec2 prevUV = q.xy * (CAMERA_FOCAL / -q.z);\n"
+"    h = ivec2(floor(prevUV * u_resolution.y + 0.5 * u_resolution));\n"
+"    if (any(lessThan(h, ivec2(0))) || any(greaterThanEqual(h, ivec2(u_resolution)))) return false;\n"
+"    float stored = texelFetch(u_historyGuide, h, 0).a;\n"
+"    if (dist <= 0.0) return stored <= 0.0;\n"
+"    return stored > 0.0 && abs(stored - length(q)) < 0.02 * stored;\n"
+"}\n"
+"\n"
+"float guideDifference(vec4 a, vec4 b) {\n"
+"    if ((a.a > 0.0) != (b.a > 0.0)) return 1e3;\n"
+"    if (a.a <= 0.0) return 0.0;\n"
+"    return abs(a.a - b.a) / min(a.a, b.a) * 20.0 + length(a.rgb - b.rgb);\n"
+"}\n"
+"\n"
+"void main() {\n"
+"    ivec2 p = ivec2(gl_FragCoord.xy);\n"
+"    ivec2 fieldSize = textureSize(u_field, 0);\n"
+"    if (((p.x + p.y + u_parity) & 1) == 0) {\n"
+"        ivec2 f = min(ivec2(p.x >> 1, p.y), fieldSize - 1);\n"
+"        fragColor = texelFetch(u_field, f, 0);\n"
+"        guideOut = texelFetch(u_fieldGuide, f, 0);\n"
+"        return;\n"
 "    }\n"
 "    \n"
-"    // Color grading\n"
-"    finalColor = pow(finalColor, vec3(0.9)); // Slight contrast\n"
-"    finalColor = mix(vec3(dot(finalColor, vec3(0.299, 0.587, 0.114))), finalColor, 1.1); // Saturation boost\n"
+"    // All four direct neighbours were shaded this frame\n"
+"    const ivec2 offsets[4] = ivec2[4](ivec2(-1, 0), ivec2(1, 0), ivec2(0, -1), ivec2(0, 1));\n"
+"    vec4 color[4];\n"
+"    vec4 guide[4];\n"
+"    for (int i = 0; i < 4; i++) {\n"
+"        ivec2 q = p + offsets[i];\n"
+"        ivec2 f = clamp(ivec2(q.x >> 1, q.y), ivec2(0), fieldSize - 1);\n"
+"        color[i] = texelFetch(u_field, f, 0);\n"
+"        guide[i] = texelFetch(u_fieldGuide, f, 0);\n"
+"    }\n"
 "    \n"
-"    // Gamma correction\n"
-"    finalColor = pow(finalColor, vec3(0.4545));\n"
+"    if (u_historyValid == 1) {\n"
+"        vec2 uv = (gl_FragCoord.xy - 0.5 * u_resolution) / u_resolution.y;\n"
+"        vec3 rd = u_rotation * normalize(vec3(uv, -CAMERA_FOCAL));\n"
+"        ivec2 h;\n"
+"        vec4 own = texelFetch(u_historyGuide, p, 0);\n"
+"        if (reproject(rd, own.a, h)) {\n"
+"            fragColor = texelFetch(u_history, h, 0);\n"
+"            guideOut = texelFetch(u_historyGuide, h, 0);\n"
+"            return;\n"
+"        }\n"
+"        for (int i = 0; i < 4; i++) {\n"
+"            if (reproject(rd, guide[i].a, h)) {\n"
+"                fragColor = texelFetch(u_history, h, 0);\n"
+"                guideOut = texelFetch(u_historyGuide, h, 0);\n"
+"                return;\n"
+"            }\n"
+"        }\n"
+"    }\n"
 "    \n"
-"    fragColor = vec4(finalColor, 1.0);\n"
+"    float horizontal = guideDifference(guide[0], guide[1]);\n"
+"    float vertical = guideDifference(guide[2], guide[3]);\n"
+"    if (horizontal < 0.5 * vertical) {\n"
+"        fragColor = 0.5 * (color[0] + color[1]);\n"
+"        guideOut = guide[0];\n"
+"    } else if (vertical < 0.5 * horizontal) {\n"
+"        fragColor = 0.5 * (color[2] + color[3]);\n"
+"        guideOut = guide[2];\n"
+"    } else {\n"
+"        fragColor = 0.25 * (color[0] + color[1] + color[2] + color[3]);\n"
+"        guideOut = guide[0];\n"
+"    }\n"
 "}\n";
 
-// Shader compilation helper
-GLuint compileShader(GLenum type, const char* source) {
-    GLuint shader = glCreateShader(type);
-    glShaderSource(shader, 1, &source, NULL);
-    glCompileShader(shader);
-    
+// Blends the variable-rate levels: full rate inside radius u_rates.x,
+// half rate out to u_rates.y and quarter rate beyond, cross-faded over
+// +-u_band so the change of resolution does not show as a seam
+const char* rateCompositeFragmentShaderSource =
+"#version 330 core\n"
+"uniform sampler2D u_full;\n"
+"uniform sampler2D u_half;\n"
+"uniform sampler2D u_quarter;\n"
+"uniform vec2 u_resolution;\n"
+"uniform vec2 u_rates;\n"
+"uniform float u_band;\n"
+"out vec4 fragColor;\n"
+"void main() {\n"
+"    float r = length((gl_FragCoord.xy - 0.5 * u_resolution) / u_resolution.y);\n"
+"    // Texel i of a 1/s level covers window pixels [i s, (i + 1) s)\n"
+"    vec3 color = texture(u_quarter, gl_FragCoord.xy / (4.0 * vec2(textureSize(u_quarter, 0)))).rgb;\n"
+"    if (r < u_rates.y + u_band) {\n"
+"        vec3 halfRate = texture(u_half, gl_FragCoord.xy / (2.0 * vec2(textureSize(u_half, 0)))).rgb;\n"
+"        color = mix(halfRate, color, smoothstep(u_rates.y - u_band, u_rates.y + u_band, r));\n"
+"    }\n"
+"    if (r < u_rates.x + u_band) {\n"
+"        vec3 fullRate = texelFetch(u_full, ivec2(gl_FragCoord.xy), 0).rgb;\n"
+"        color = mix(fullRate, color, smoothstep(u_rates.x - u_band, u_rates.x + u_band, r));\n"
+"    }\n"
+"    fragColor = vec4(color, 1.0);\n"
+"}\n";
+
+// Right eye of a stereo pair from the left one. The eyes are parallel
+// cameras, so a point at camera depth z shows u_disparityScale / z
+// pixels further right to the left eye, on the same row; sky pixels are
+// placed at the depth of their glow. Scanning the left row from the
+// largest disparity down finds the nearest surface that lands on this
+// pixel, either one left pixel or, where the surface is stretched for
+// the right eye, the gap between two neighbours. Where none does, the
+// surface was hidden from the left eye and the fragment is discarded
+// for the fractal shader to march.
+const char* stereoFragmentShaderSource =
+"#version 330 core\n"
+"uniform sampler2D u_leftColor;\n"
+"uniform sampler2D u_leftGuide;\n"
+"uniform vec2 u_resolution;\n"
+"uniform float u_disparityScale;\n"
+"uniform int u_maxDisparity;\n"
+"out vec4 fragColor;\n"
+"const float CAMERA_FOCAL = 1.8;\n"
+"float disparityAt(ivec2 q) {\n"
+"    float t = abs(texelFetch(u_leftGuide, q, 0).a);\n"
+"    vec2 uv = (vec2(q) + 0.5 - 0.5 * u_resolution) / u_resolution.y;\n"
+"    // Ray distance to camera depth\n"
+"    return u_disparityScale * length(vec3(uv, -CAMERA_FOCAL)) / (t * CAMERA_FOCAL);\n"
+"}\n"
+"void main() {\n"
+"    ivec2 px = ivec2(gl_FragCoord.xy);\n"
+"    int maxD = min(u_maxDisparity, textureSize(u_leftGuide, 0).x - 1 - px.x);\n"
+"    // Left pixel px + d lands error pixels right of this one\n"
+"    float nextError = 0.0;\n"
+"    for (int d = maxD; d >= 0; d--) {\n"
+"        ivec2 q = ivec2(px.x + d, px.y);\n"
+"        float error = float(d) - disparityAt(q);\n"
+"        if (abs(error) <= 0.5) {\n"
+"            fragColor = texelFetch(u_leftColor, q, 0);\n"
+"            return;\n"
+"        }\n"
+"        // Neighbours landing less than two pixels apart are one surface\n"
+"        if (d < maxD && error < 0.0 && nextError > 0.0 && nextError - error < 2.0) {\n"
+"            fragColor = mix(texelFetch(u_leftColor, q, 0), texelFetch(u_leftColor, q + ivec2(1, 0), 0),\n"
+"                            -error / (nextError - error));\n"
+"            return;\n"
+"        }\n"
+"        nextError = error;\n"
+"    }\n"
+"    discard;\n"
+"}\n";
+
+// Screen-space velocity of each pixel from the camera motion since the
+// previous frame: the first hit, or for the sky the view direction, is
+// projected into the previous camera. In pixels over the shutter time.
+const char* velocityFragmentShaderSource =
+"#version 330 core\n"
+"uniform sampler2D u_guide;\n"
+"uniform vec2 u_resolution;\n"
+"uniform vec3 u_camPos;\n"
+"uniform mat3 u_rotation;\n"
+"uniform vec3 u_prevCamPos;\n"
+"uniform mat3 u_prevRotation;\n"
+"uniform float u_shutter;\n"
+"out vec4 velocityOut;\n"
+"const float CAMERA_FOCAL = 1.8;\n"
+"void main() {\n"
+"    vec2 uv = (gl_FragCoord.xy - 0.5 * u_resolution) / u_resolution.y;\n"
+"    vec3 rd = u_rotation * normalize(vec3(uv, -CAMERA_FOCAL));\n"
+"    float t = texelFetch(u_guide, ivec2(gl_FragCoord.xy), 0).a;\n"
+"    // The sky is infinitely far, so only the rotation moves it\n"
+"    vec3 q = transpose(u_prevRotation) * (t > 0.0 ? u_camPos + rd * t - u_prevCamPos : rd);\n"
+"    vec2 velocity = vec2(0.0);\n"
+"    if (q.z < 0.0) {\n"
+"        vec2 prevUV = q.xy * (CAMERA_FOCAL / -q.z);\n"
+"        velocity = (uv - prevUV) * u_resolution.y * u_shutter;\n"
+"    }\n"
+"    velocityOut = vec4(velocity, 0.0, 0.0);\n"
+"}\n";
+
+// Denoiser features: camera-space normal and hit distance per pixel,
+// from the hit distances of the guide. Each derivative takes the
+// neighbour nearer in depth, so normals do not bend over silhouettes.
+// The sky keeps its negative distance and gets no normal.
+const char* denoiseFeatureFragmentShaderSource =
+"#version 330 core\n"
+"uniform sampler2D u_guide;\n"
+"uniform vec2 u_resolution;\n"
+"out vec4 featureOut;\n"
+"const float CAMERA_FOCAL = 1.8;\n"
+"float hitAt(ivec2 px) {\n"
+"    return texelFetch(u_guide, clamp(px, ivec2(0), ivec2(u_resolution) - 1), 0).a;\n"
+"}\n"
+"vec3 viewPos(ivec2 px, float t) {\n"
+"    vec2 uv = (vec2(px) + 0.5 - 0.5 * u_resolution) / u_resolution.y;\n"
+"    return normalize(vec3(uv, -CAMERA_FOCAL)) * t;\n"
+"}\n"
+"// Position difference one pixel along axis, or zero with no hit either side\n"
+"vec3 derivative(ivec2 px, ivec2 axis, float t, vec3 p) {\n"
+"    float before = hitAt(px - axis);\n"
+"    float after = hitAt(px + axis);\n"
+"    bool useAfter = after >= 0.0 && (before < 0.0 || abs(after - t) < abs(before - t));\n"
+"    if (useAfter) return viewPos(px + axis, after) - p;\n"
+"    if (before >= 0.0) return p - viewPos(px - axis, before);\n"
+"    return vec3(0.0);\n"
+"}\n"
+"void main() {\n"
+"    ivec2 px = ivec2(gl_FragCoord.xy);\n"
+"    float t = hitAt(px);\n"
+"    if (t < 0.0) {\n"
+"        featureOut = vec4(0.0, 0.0, 0.0, t);\n"
+"        return;\n"
+"    }\n"
+"    vec3 p = viewPos(px, t);\n"
+"    vec3 n = cross(derivative(px, ivec2(1, 0), t, p), derivative(px, ivec2(0, 1), t, p));\n"
+"    n = dot(n, n) > 0.0 ? normalize(n) : -normalize(p);\n"
+"    if (dot(n, p) > 0.0) n = -n;\n"
+"    featureOut = vec4(n, t);\n"
+"}\n";
+
+// One level of the edge-avoiding a-trous wavelet filter (Dammertz et
+// al. 2010): a 5x5 B3-spline kernel with u_step pixels between taps,
+// where each tap is weighted down by its color difference (with a sigma
+// that halves every level), by its distance from the center's tangent
+// plane in pixel footprints, by the cosine between normals and by the
+// orbit trap difference. Surface and sky pixels never mix. The weights
+// are loose on purpose: at one sample per pixel most of the fractal's
+// detail is smaller than a pixel.
+const char* atrousFragmentShaderSource =
+"#version 330 core\n"
+"uniform sampler2D u_color;\n"
+"uniform sampler2D u_feature;\n"
+"uniform sampler2D u_guide;\n"
+"uniform vec2 u_resolution;\n"
+"uniform int u_step;\n"
+"uniform float u_colorSigma;\n"
+"uniform int u_useTrap;\n"
+"out vec4 fragColor;\n"
+"const float CAMERA_FOCAL = 1.8;\n"
+"const float PLANE_SIGMA = 4.0;\n"
+"const float TRAP_SIGMA = 1.0;\n"
+"vec3 viewPos(ivec2 px, float t) {\n"
+"    vec2 uv = (vec2(px) + 0.5 - 0.5 * u_resolution) / u_resolution.y;\n"
+"    return normalize(vec3(uv, -CAMERA_FOCAL)) * t;\n"
+"}\n"
+"void main() {\n"
+"    const float kernel[3] = float[3](3.0 / 8.0, 1.0 / 4.0, 1.0 / 16.0);\n"
+"    ivec2 px = ivec2(gl_FragCoord.xy);\n"
+"    ivec2 last = ivec2(u_resolution) - 1;\n"
+"    vec3 color0 = texelFetch(u_color, px, 0).rgb;\n"
+"    vec4 feature0 = texelFetch(u_feature, px, 0);\n"
+"    vec3 trap0 = texelFetch(u_guide, px, 0).rgb;\n"
+"    bool hit0 = feature0.w >= 0.0;\n"
+"    vec3 p0 = viewPos(px, feature0.w);\n"
+"    float footprint = abs(feature0.w) / (CAMERA_FOCAL * u_resolution.y);\n"
+"    vec3 sum = vec3(0.0);\n"
+"    float weightSum = 0.0;\n"
+"    for (int j = -2; j <= 2; j++) {\n"
+"        for (int i = -2; i <= 2; i++) {\n"
+"            ivec2 q = px + ivec2(i, j) * u_step;\n"
+"            if (any(lessThan(q, ivec2(0))) || any(greaterThan(q, last))) continue;\n"
+"            vec4 feature = texelFetch(u_feature, q, 0);\n"
+"            if ((feature.w >= 0.0) != hit0) continue;\n"
+"            vec3 color = texelFetch(u_color, q, 0).rgb;\n"
+"            vec3 dc = color - color0;\n"
+"            float w = kernel[abs(i)] * kernel[abs(j)] * exp(-dot(dc, dc) / (u_colorSigma * u_colorSigma));\n"
+"            if (hit0) {\n"
+"                float plane = abs(dot(feature0.xyz, viewPos(q, feature.w) - p0));\n"
+"                float reach = PLANE_SIGMA * footprint * length(vec2(i, j)) * float(u_step);\n"
+"                w *= exp(-plane / max(reach, 1e-6));\n"
+"                w *= max(dot(feature0.xyz, feature.xyz), 0.0);\n"
+"                if (u_useTrap == 1) {\n"
+"                    vec3 dt = texelFetch(u_guide, q, 0).rgb - trap0;\n"
+"                    w *= exp(-dot(dt, dt) / (TRAP_SIGMA * TRAP_SIGMA));\n"
+"                }\n"
+"            }\n"
+"            sum += color * w;\n"
+"            weightSum += w;\n"
+"        }\n"
+"    }\n"
+"    // The center tap always counts, with weight 9/64\n"
+"    fragColor = vec4(sum / weightSum, 1.0);\n"
+"}\n";
+
+// Depth of field by gathering. A thin lens focused at depth u_focus blurs
+// a point at depth z into a circle of confusion of u_cocScale *
+// |1/z - 1/u_focus| pixels. Each pixel gathers u_samples points of its
+// own circle on a Vogel spiral. A point counts if its circle reaches
+// back to this pixel, so sharp surfaces do not bleed into the blur in
+// front of or behind them.
+const char* dofFragmentShaderSource =
+"#version 330 core\n"
+"uniform sampler2D u_color;\n"
+"uniform sampler2D u_guide;\n"
+"uniform vec2 u_resolution;\n"
+"uniform float u_focus;\n"
+"uniform float u_cocScale;\n"
+"uniform float u_maxCoc;\n"
+"uniform int u_samples;\n"
+"out vec4 fragColor;\n"
+"const float CAMERA_FOCAL = 1.8;\n"
+"float cocAt(ivec2 px) {\n"
+"    float t = texelFetch(u_guide, px, 0).a;\n"
+"    vec2 uv = (vec2(px) + 0.5 - 0.5 * u_resolution) / u_resolution.y;\n"
+"    // Inverse camera depth; zero for the sky\n"
+"    float invZ = t > 0.0 ? length(vec3(uv, -CAMERA_FOCAL)) / (t * CAMERA_FOCAL) : 0.0;\n"
+"    return min(u_cocScale * abs(invZ - 1.0 / u_focus), u_maxCoc);\n"
+"}\n"
+"void main() {\n"
+"    ivec2 px = ivec2(gl_FragCoord.xy);\n"
+"    ivec2 maxPx = textureSize(u_color, 0) - 1;\n"
+"    float coc = cocAt(px);\n"
+"    vec3 sum = texelFetch(u_color, px, 0).rgb;\n"
+"    float weight = 1.0;\n"
+"    if (coc >= 0.5) {\n"
+"        for (int i = 0; i < u_samples; i++) {\n"
+"            float r = sqrt((float(i) + 0.5) / float(u_samples)) * coc;\n"
+"            float angle = float(i) * 2.39996323;\n"
+"            vec2 offset = r * vec2(cos(angle), sin(angle));\n"
+"            ivec2 q = clamp(px + ivec2(floor(offset + 0.5)), ivec2(0), maxPx);\n"
+"            float w = clamp(cocAt(q) - r + 1.0, 0.0, 1.0);\n"
+"            sum += texelFetch(u_color, q, 0).rgb * w;\n"
+"            weight += w;\n"
+"        }\n"
+"    }\n"
+"    fragColor = vec4(sum / weight, 1.0);\n"
+"}\n";
+
+// Motion blur: u_samples taps along this pixel's velocity, centered on
+// it, each weighted by how far the tap's own streak reaches back, so a
+// still surface is not smeared by a moving one next to it
+const char* motionBlurFragmentShaderSource =
+"#version 330 core\n"
+"uniform sampler2D u_color;\n"
+"uniform sampler2D u_velocity;\n"
+"uniform float u_maxBlur;\n"
+"uniform int u_samples;\n"
+"out vec4 fragColor;\n"
+"vec2 velocityAt(ivec2 px) {\n"
+"    vec2 v = texelFetch(u_velocity, px, 0).rg;\n"
+"    float len = length(v);\n"
+"    return len > u_maxBlur ? v * (u_maxBlur / len) : v;\n"
+"}\n"
+"void main() {\n"
+"    ivec2 px = ivec2(gl_FragCoord.xy);\n"
+"    ivec2 maxPx = textureSize(u_color, 0) - 1;\n"
+"    vec2 velocity = velocityAt(px);\n"
+"    vec3 sum = texelFetch(u_color, px, 0).rgb;\n"
+"    float weight = 1.0;\n"
+"    if (dot(velocity, velocity) >= 0.25) {\n"
+"        for (int i = 0; i < u_samples; i++) {\n"
+"            vec2 offset = velocity * ((float(i) + 0.5) / float(u_samples) - 0.5);\n"
+"            ivec2 q = clamp(px + ivec2(floor(offset + 0.5)), ivec2(0), maxPx);\n"
+"            float w = clamp(length(velocityAt(q)) * 0.5 - length(offset) + 1.0, 0.0, 1.0);\n"
+"            sum += texelFetch(u_color, q, 0).rgb * w;\n"
+"            weight += w;\n"
+"        }\n"
+"    }\n"
+"    fragColor = vec4(sum / weight, 1.0);\n"
+"}\n";
+
+// Tone maps a linear HDR frame: exposure in stops, then the fractal's own
+// grade, the ACES fit of Narkowicz or Hable's filmic curve (white point
+// 11.2) followed by gamma. Preceded by the version line and colorGrade.
+const char* toneMapFragmentShaderSource =
+"uniform sampler2D u_source;\n"
+"uniform float u_exposure;\n"
+"uniform int u_curve;\n"
+"out vec4 fragColor;\n"
+"vec3 hable(vec3 x) {\n"
+"    return (x * (0.15 * x + 0.05) + 0.004) / (x * (0.15 * x + 0.5) + 0.06) - 0.02 / 0.3;\n"
+"}\n"
+"void main() {\n"
+"    vec3 color = texelFetch(u_source, ivec2(gl_FragCoord.xy), 0).rgb * exp2(u_exposure);\n"
+"    if (u_curve == 1) {\n"
+"        color = clamp(color * (2.51 * color + 0.03) / (color * (2.43 * color + 0.59) + 0.14), 0.0, 1.0);\n"
+"        color = pow(color, vec3(0.4545));\n"
+"    } else if (u_curve == 2) {\n"
+"        color = hable(2.0 * color) / hable(vec3(11.2));\n"
+"        color = pow(max(color, 0.0), vec3(0.4545));\n"
+"    } else {\n"
+"        color = colorGrade(color);\n"
+"    }\n"
+"    fragColor = vec4(color, 1.0);\n"
+"}\n";
+
+// Stretches a reduced-resolution frame over the window with the
+// hardware bilinear filter
+const char* bilinearFragmentShaderSource =
+"#version 330 core\n"
+"uniform sampler2D u_source;\n"
+"uniform vec2 u_inputSize;\n"
+"uniform vec2 u_outputSize;\n"
+"out vec4 fragColor;\n"
+"void main() {\n"
+"    fragColor = vec4(texture(u_source, gl_FragCoord.xy / u_outputSize).rgb, 1.0);\n"
+"}\n";
+
+// Edge-adaptive upscaling after AMD's FidelityFX EASU: the 12 input
+// pixels around the output position are filtered with a Lanczos-like
+// kernel that is narrowed across the local edge and widened along it,
+// then clamped to the nearest four pixels so edges do not ring.
+// Tap layout, f being the input pixel left of and below the position:
+//       b c
+//     e f g h
+//     i j k l
+//       n o
+const char* easuFragmentShaderSource =
+"#version 330 core\n"
+"uniform sampler2D u_source;\n"
+"uniform vec2 u_inputSize;\n"
+"uniform vec2 u_outputSize;\n"
+"out vec4 fragColor;\n"
+"\n"
+"vec3 fetch(ivec2 p) {\n"
+"    return texelFetch(u_source, clamp(p, ivec2(0), ivec2(u_inputSize) - 1), 0).rgb;\n"
+"}\n"
+"\n"
+"float luma(vec3 c) {\n"
+"    return c.r * 0.5 + c.g + c.b * 0.5;\n"
+"}\n"
+"\n"
+"// Gradient at one of the four center pixels from its cross neighbors\n"
+"// (a below, b left, c center, d right, e above). The length is 1 for a\n"
+"// monotonic ramp and falls toward 0 for single-pixel detail, which\n"
+"// must not be stretched into a line.\n"
+"void edge(inout vec2 dir, inout float len, float w, float a, float b, float c, float d, float e) {\n"
+"    float dirX = d - b;\n"
+"    float lenX = clamp(abs(dirX) / max(max(abs(d - c), abs(c - b)), 1e-5), 0.0, 1.0);\n"
+"    float dirY = e - a;\n"
+"    float lenY = clamp(abs(dirY) / max(max(abs(e - c), abs(c - a)), 1e-5), 0.0, 1.0);\n"
+"    dir += vec2(dirX, dirY) * w;\n"
+"    len += (lenX * lenX + lenY * lenY) * w;\n"
+"}\n"
+"\n"
+"void tap(inout vec3 sum, inout float weight, vec2 off, vec2 dir, vec2 len2, float lob, float clp, vec3 c) {\n"
+"    // Rotate into the edge frame, x across the edge\n"
+"    vec2 v = vec2(dot(off, dir), dot(off, vec2(-dir.y, dir.x))) * len2;\n"
+"    float d2 = min(dot(v, v), clp);\n"
+"    // (25/16 (2/5 x^2 - 1)^2 - 9/16) (lob x^2 - 1)^2 approximates lanczos2\n"
+"    // without trigonometry; lob sets the size of the negative lobe\n"
+"    float wB = 0.4 * d2 - 1.0;\n"
+"    float wA = lob * d2 - 1.0;\n"
+"    float w = (1.5625 * wB * wB - 0.5625) * wA * wA;\n"
+"    sum += c * w;\n"
+"    weight += w;\n"
+"}\n"
+"\n"
+"void main() {\n"
+"    vec2 pp = gl_FragCoord.xy * (u_inputSize / u_outputSize) - 0.5;\n"
+"    ivec2 fp = ivec2(floor(pp));\n"
+"    pp -= floor(pp);\n"
+"    \n"
+"    vec3 b = fetch(fp + ivec2(0, -1)), c = fetch(fp + ivec2(1, -1));\n"
+"    vec3 e = fetch(fp + ivec2(-1, 0)), f = fetch(fp), g = fetch(fp + ivec2(1, 0)), h = fetch(fp + ivec2(2, 0));\n"
+"    vec3 i = fetch(fp + ivec2(-1, 1)), j = fetch(fp + ivec2(0, 1)), k = fetch(fp + ivec2(1, 1)), l = fetch(fp + ivec2(2, 1));\n"
+"    vec3 n = fetch(fp + ivec2(0, 2)), o = fetch(fp + ivec2(1, 2));\n"
+"    float lb = luma(b), lc = luma(c), le = luma(e), lf = luma(f), lg = luma(g), lh = luma(h);\n"
+"    float li = luma(i), lj = luma(j), lk = luma(k), ll = luma(l), ln = luma(n), lo = luma(o);\n"
+"    \n"
+"    // Edge direction and strength, bilinearly blended from f, g, j and k\n"
+"    vec2 dir = vec2(0.0);\n"
+"    float len = 0.0;\n"
+"    edge(dir, len, (1.0 - pp.x) * (1.0 - pp.y), lb, le, lf, lg, lj);\n"
+"    edge(dir, len, pp.x * (1.0 - pp.y), lc, lf, lg, lh, lk);\n"
+"    edge(dir, len, (1.0 - pp.x) * pp.y, lf, li, lj, lk, ln);\n"
+"    edge(dir, len, pp.x * pp.y, lg, lj, lk, ll, lo);\n"
+"    float dirLength2 = dot(dir, dir);\n"
+"    dir = dirLength2 < 1.0 / 32768.0 ? vec2(1.0, 0.0) : dir * inversesqrt(dirLength2);\n"
+"    len *= 0.5;\n"
+"    len *= len;\n"
+"    // Diagonal edges need more stretch to reach the same sharpness\n"
+"    float stretch = 1.0 / max(abs(dir.x), abs(dir.y));\n"
+"    vec2 len2 = vec2(1.0 + (stretch - 1.0) * len, 1.0 - 0.5 * len);\n"
+"    float lob = 0.5 - 0.29 * len;\n"
+"    float clp = 1.0 / lob;\n"
+"    \n"
+"    vec3 sum = vec3(0.0);\n"
+"    float weight = 0.0;\n"
+"    tap(sum, weight, vec2(0.0, -1.0) - pp, dir, len2, lob, clp, b);\n"
+"    tap(sum, weight, vec2(1.0, -1.0) - pp, dir, len2, lob, clp, c);\n"
+"    tap(sum, weight, vec2(-1.0, 0.0) - pp, dir, len2, lob, clp, e);\n"
+"    tap(sum, weight, vec2(0.0, 0.0) - pp, dir, len2, lob, clp, f);\n"
+"    tap(sum, weight, vec2(1.0, 0.0) - pp, dir, len2, lob, clp, g);\n"
+"    tap(sum, weight, vec2(2.0, 0.0) - pp, dir, len2, lob, clp, h);\n"
+"    tap(sum, weight, vec2(-1.0, 1.0) - pp, dir, len2, lob, clp, i);\n"
+"    tap(sum, weight, vec2(0.0, 1.0) - pp, dir, len2, lob, clp, j);\n"
+"    tap(sum, weight, vec2(1.0, 1.0) - pp, dir, len2, lob, clp, k);\n"
+"    tap(sum, weight, vec2(2.0, 1.0) - pp, dir, len2, lob, clp, l);\n"
+"    tap(sum, weight, vec2(0.0, 2.0) - pp, dir, len2, lob, clp, n);\n"
+"    tap(sum, weight, vec2(1.0, 2.0) - pp, dir, len2, lob, clp, o);\n"
+"    \n"
+"    vec3 lo4 = min(min(f, g), min(j, k));\n"
+"    vec3 hi4 = max(max(f, g), max(j, k));\n"
+"    fragColor = vec4(clamp(sum / weight, lo4, hi4), 1.0);\n"
+"}\n";
+
+// Contrast-adaptive sharpening after FidelityFX RCAS: a negative lobe on
+// the four cross neighbors, limited per pixel so no channel leaves the
+// range of its neighborhood's headroom (no clipping, no halos on the
+// already hard fractal edges). u_sharpness runs from 0 (off) to 1.
+const char* rcasFragmentShaderSource =
+"#version 330 core\n"
+"uniform sampler2D u_source;\n"
+"uniform float u_sharpness;\n"
+"out vec4 fragColor;\n"
+"void main() {\n"
+"    ivec2 p = ivec2(gl_FragCoord.xy);\n"
+"    ivec2 last = textureSize(u_source, 0) - 1;\n"
+"    vec3 b = texelFetch(u_source, clamp(p + ivec2(0, 1), ivec2(0), last), 0).rgb;\n"
+"    vec3 d = texelFetch(u_source, clamp(p + ivec2(-1, 0), ivec2(0), last), 0).rgb;\n"
+"    vec3 e = texelFetch(u_source, p, 0).rgb;\n"
+"    vec3 f = texelFetch(u_source, clamp(p + ivec2(1, 0), ivec2(0), last), 0).rgb;\n"
+"    vec3 h = texelFetch(u_source, clamp(p + ivec2(0, -1), ivec2(0), last), 0).rgb;\n"
+"    vec3 mn = min(min(b, d), min(f, h));\n"
+"    vec3 mx = max(max(b, d), max(f, h));\n"
+"    // Most negative lobe that keeps each channel within [0, 1]\n"
+"    vec3 hitMin = min(mn, e) / (4.0 * mx + 1e-5);\n"
+"    vec3 hitMax = (1.0 - max(mx, e)) / (4.0 * mn - 4.0 - 1e-5);\n"
+"    vec3 lobeRGB = max(-hitMin, hitMax);\n"
+"    float lobe = max(-0.1875, min(max(lobeRGB.r, max(lobeRGB.g, lobeRGB.b)), 0.0)) * u_sharpness;\n"
+"    fragColor = vec4((lobe * (b + d + f + h) + e) / (4.0 * lobe + 1.0), 1.0);\n"
+"}\n";
+
+// Faces of the hull tetrahedra are pushed out by this much so the
+// distance-estimated surface and the visible part of the volumetric glow
+// (which fades to ~10% at distance 0.3) stay inside
+#define HULL_MARGIN 0.3f
+#define HULL_NEAR 0.05f         // near plane of the hull pre-pass, as in the shaders
+
+// Reports compile errors; querying the status waits for the compile
+bool checkShader(GLuint shader) {
     GLint success;
     glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
     if (!success) {
         char infoLog[1024];
         glGetShaderInfoLog(shader, 1024, NULL, infoLog);
         fprintf(stderr, "Shader compilation failed:\n%s\n", infoLog);
+        return false;
+    }
+    return true;
+}
+
+bool checkProgram(GLuint program) {
+    GLint success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        char infoLog[1024];
+        glGetProgramInfoLog(program, 1024, NULL, infoLog);
+        fprintf(stderr, "Program linking failed:\n%s\n", infoLog);
+        return false;
+    }
+    return true;
+}
+
+// Shader compilation helper (sources are concatenated in order)
+GLuint compileShader(GLenum type, const char** sources, int count) {
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, count, sources, NULL);
+    glCompileShader(shader);
+    
+    if (!checkShader(shader)) {
         return 0;
     }
     
@@ -416,9 +1352,9 @@ GLuint compileShader(GLenum type, const char* source) {
 }
 
 // Program linking helper
-GLuint createShaderProgram(const char* vertSrc, const char* fragSrc) {
-    GLuint vertShader = compileShader(GL_VERTEX_SHADER, vertSrc);
-    GLuint fragShader = compileShader(GL_FRAGMENT_SHADER, fragSrc);
+GLuint createShaderProgram(const char* vertSrc, const char** fragSrcs, int fragCount) {
+    GLuint vertShader = compileShader(GL_VERTEX_SHADER, &vertSrc, 1);
+    GLuint fragShader = compileShader(GL_FRAGMENT_SHADER, fragSrcs, fragCount);
     
     if (!vertShader || !fragShader) {
         return 0;
@@ -429,12 +1365,7 @@ GLuint createShaderProgram(const char* vertSrc, const char* fragSrc) {
     glAttachShader(program, fragShader);
     glLinkProgram(program);
     
-    GLint success;
-    glGetProgramiv(program, GL_LINK_STATUS, &success);
-    if (!success) {
-        char infoLog[1024];
-        glGetProgramInfoLog(program, 1024, NULL, infoLog);
-        fprintf(stderr, "Program linking failed:\n%s\n", infoLog);
+    if (!checkProgram(program)) {
         return 0;
     }
     
@@ -444,18 +1375,3111 @@ GLuint createShaderProgram(const char* vertSrc, const char* fragSrc) {
     return program;
 }
 
-// 3x3 rotation matrices
-void rotationMatrixY(float angle, float* mat) {
-    float c = cosf(angle);
-    float s = sinf(angle);
-    
-    mat[0] = c;  mat[1] = 0;  mat[2] = s;
-    mat[3] = 0;  mat[4] = 1;  mat[5] = 0;
-    mat[6] = -s; mat[7] = 0;  mat[8] = c;
+// Fragment sources of the fractal program for the given DE kernel,
+// intersector and anti-aliasing mode
+#define FRACTAL_SOURCE_COUNT 7
+
+void getFractalSources(const char** fragSrcs, int kernel, bool exact, bool sampleShading) {
+    fragSrcs[0] = fragmentShaderPrelude;
+    fragSrcs[1] = sampleShading ? sampleShadingDefine : "";
+    fragSrcs[2] = exact ? exactIntersectorDefine : "";
+    fragSrcs[3] = deKernels[kernel].glslSource;
+    fragSrcs[4] = ifsGlslIntersector;
+    fragSrcs[5] = colorGradeSource;
+    fragSrcs[6] = fragmentShaderSource;
 }
 
-void rotationMatrixX(float angle, float* mat) {
-    float c = cosf(angle);
+// Build the fractal program around the given DE kernel and intersector
+GLuint createFractalProgram(int kernel, bool exact, bool sampleShading) {
+    const char* fragSrcs[FRACTAL_SOURCE_COUNT];
+    getFractalSources(fragSrcs, kernel, exact, sampleShading);
+    return createShaderProgram(vertexShaderSource, fragSrcs, FRACTAL_SOURCE_COUNT);
+}
+
+GLuint createPreviewProgram(int kernel) {
+    const char* fragSrcs[] = {
+        fragmentShaderPrelude,
+        previewQualityDefine,
+        deKernels[kernel].glslSource,
+        ifsGlslIntersector,
+        fragmentShaderSource,
+        previewShaderSource
+    };
+    return createShaderProgram(vertexShaderSource, fragSrcs, 6);
+}
+
+// Background compilation of the fractal program. With
+// KHR_parallel_shader_compile the driver compiles on its own threads and
+// the main loop polls for completion; otherwise a worker thread compiles
+// on a context sharing objects with the main one, bound to a hidden window
+// of its own since a surface cannot be current on two threads at once
+// with every platform API. COMPILE_SYNC compiles
+// in startFractalCompile itself.
+typedef enum {
+    COMPILE_SYNC,
+    COMPILE_PARALLEL,
+    COMPILE_WORKER
+} CompileMode;
+
+typedef struct {
+    CompileMode mode;
+    SDL_Window* workerWindow;
+    SDL_GLContext workerContext;
+    bool active;             // a compile has been started and not collected
+    int kernel;
+    bool exact;
+    bool sampleShading;      // build the per-sample variant (fixed per window)
+    Uint64 startTick;
+    GLuint program;          // COMPILE_SYNC / COMPILE_WORKER: the result
+    GLuint vertShader;       // COMPILE_PARALLEL: objects still compiling
+    GLuint fragShader;
+    SDL_Thread* thread;
+    SDL_atomic_t done;
+} ShaderCompiler;
+
+void initShaderCompiler(ShaderCompiler* c, SDL_Window* window, SDL_GLContext mainContext, bool async,
+                        bool sampleShading) {
+    memset(c, 0, sizeof(*c));
+    c->mode = COMPILE_SYNC;
+    c->sampleShading = sampleShading;
+    if (!async) {
+        return;
+    }
+    
+    if (GLEW_KHR_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+        c->mode = COMPILE_PARALLEL;
+    } else if (GLEW_ARB_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+        c->mode = COMPILE_PARALLEL;
+    } else {
+        c->workerWindow = SDL_CreateWindow("shader compile", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
+                                           1, 1, SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN);
+        if (c->workerWindow) {
+            SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 1);
+            c->workerContext = SDL_GL_CreateContext(c->workerWindow);
+            SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 0);
+            SDL_GL_MakeCurrent(window, mainContext);
+        }
+        if (c->workerContext) {
+            c->mode = COMPILE_WORKER;
+        } else {
+            fprintf(stderr, "No shared context for background compiles (%s)\n", SDL_GetError());
+            if (c->workerWindow) SDL_DestroyWindow(c->workerWindow);
+            c->workerWindow = NULL;
+        }
+    }
+}
+
+int shaderWorkerThread(void* data) {
+    ShaderCompiler* c = (ShaderCompiler*)data;
+    SDL_GL_MakeCurrent(c->workerWindow, c->workerContext);
+    c->program = createFractalProgram(c->kernel, c->exact, c->sampleShading);
+    
+    // Some drivers only generate code at the first draw; draw one pixel
+    // here so that happens on this thread too
+    if (c->program) {
+        GLuint fbo, texture, vao;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+        glViewport(0, 0, 1, 1);
+        glGenVertexArrays(1, &vao);
+        glBindVertexArray(vao);
+        glUseProgram(c->program);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        glDeleteVertexArrays(1, &vao);
+        glDeleteFramebuffers(1, &fbo);
+        glDeleteTextures(1, &texture);
+    }
+    // The program must be complete before the main context uses it
+    glFinish();
+    SDL_GL_MakeCurrent(c->workerWindow, NULL);
+    SDL_AtomicSet(&c->done, 1);
+    return 0;
+}
+
+void startFractalCompile(ShaderCompiler* c, int kernel, bool exact) {
+    c->active = true;
+    c->kernel = kernel;
+    c->exact = exact;
+    c->startTick = SDL_GetPerformanceCounter();
+    c->program = 0;
+    SDL_AtomicSet(&c->done, 0);
+    
+    if (c->mode == COMPILE_PARALLEL) {
+        // Same sources as createFractalProgram, but nothing is queried
+        // until GL_COMPLETION_STATUS says the driver is done
+        const char* fragSrcs[FRACTAL_SOURCE_COUNT];
+        getFractalSources(fragSrcs, kernel, exact, c->sampleShading);
+        c->vertShader = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(c->vertShader, 1, &vertexShaderSource, NULL);
+        glCompileShader(c->vertShader);
+        c->fragShader = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(c->fragShader, FRACTAL_SOURCE_COUNT, fragSrcs, NULL);
+        glCompileShader(c->fragShader);
+        c->program = glCreateProgram();
+        glAttachShader(c->program, c->vertShader);
+        glAttachShader(c->program, c->fragShader);
+        glLinkProgram(c->program);
+    } else if (c->mode == COMPILE_WORKER) {
+        c->thread = SDL_CreateThread(shaderWorkerThread, "shader compile", c);
+        if (!c->thread) {
+            fprintf(stderr, "Shader compile thread failed (%s), compiling here\n", SDL_GetError());
+            c->program = createFractalProgram(kernel, exact, c->sampleShading);
+            SDL_AtomicSet(&c->done, 1);
+        }
+    } else {
+        c->program = createFractalProgram(kernel, exact, c->sampleShading);
+        SDL_AtomicSet(&c->done, 1);
+    }
+}
+
+// Returns true once the started compile has finished and stores the
+// program in *program (0 if it failed to build)
+bool pollFractalCompile(ShaderCompiler* c, GLuint* program) {
+    if (!c->active) {
+        return false;
+    }
+    
+    if (c->mode == COMPILE_PARALLEL) {
+        GLint complete = GL_FALSE;
+        glGetProgramiv(c->program, GL_COMPLETION_STATUS_KHR, &complete);
+        if (!complete) {
+            return false;
+        }
+        bool ok = checkShader(c->vertShader) && checkShader(c->fragShader) && checkProgram(c->program);
+        glDeleteShader(c->vertShader);
+        glDeleteShader(c->fragShader);
+        if (!ok) {
+            glDeleteProgram(c->program);
+            c->program = 0;
+        }
+    } else {
+        if (!SDL_AtomicGet(&c->done)) {
+            return false;
+        }
+        if (c->thread) {
+            SDL_WaitThread(c->thread, NULL);
+            c->thread = NULL;
+        }
+    }
+    
+    c->active = false;
+    *program = c->program;
+    return true;
+}
+
+void destroyShaderCompiler(ShaderCompiler* c) {
+    GLuint program;
+    if (c->active) {
+        // Let a running compile finish before its context goes away
+        while (!pollFractalCompile(c, &program)) {
+            SDL_Delay(1);
+        }
+        if (program) glDeleteProgram(program);
+    }
+    if (c->workerContext) {
+        SDL_GL_DeleteContext(c->workerContext);
+        SDL_DestroyWindow(c->workerWindow);
+    }
+}
+
+GLuint createLightingBakeProgram(int kernel) {
+    const char* fragSrcs[] = {
+        fragmentShaderPrelude,
+        lightingBakeDefine,
+        deKernels[kernel].glslSource,
+        ifsGlslIntersector,
+        fragmentShaderSource,
+        lightingBakeShaderSource
+    };
+    return createShaderProgram(vertexShaderSource, fragSrcs, 6);
+}
+
+GLuint createTileCostProgram(int kernel) {
+    const char* fragSrcs[] = {
+        fragmentShaderPrelude,
+        tileCostDefine,
+        deKernels[kernel].glslSource,
+        ifsGlslIntersector,
+        fragmentShaderSource,
+        tileCostShaderSource
+    };
+    return createShaderProgram(vertexShaderSource, fragSrcs, 6);
+}
+
+// Uniform locations of the fractal program
+typedef struct {
+    GLint resolution;
+    GLint time;
+    GLint camPos;
+    GLint rotation;
+    GLint colorPalette;
+    GLint hullDepth;
+    GLint depthPrepass;
+    GLint lightingVolume;
+    GLint bakedLighting;
+    GLint reflectionSlices;
+    GLint reflectionSlice;
+    GLint reflectionHistory;
+    GLint historyValid;
+    GLint prevCamPos;
+    GLint prevRotation;
+    GLint blueNoise;
+    GLint jitter;
+    GLint noiseOffset;
+    GLint glowSteps;
+    GLint aaGrid;
+    GLint sampleShading;
+    GLint checkerboard;
+    GLint checkerParity;
+    GLint pixelScale;
+    GLint rateRegion;
+    GLint panorama;
+    GLint panoramaTile;
+    GLint tileOrigin;
+    GLint hdr;
+} FractalUniforms;
+
+void getFractalUniforms(GLuint program, FractalUniforms* u) {
+    u->resolution = glGetUniformLocation(program, "u_resolution");
+    u->time = glGetUniformLocation(program, "u_time");
+    u->camPos = glGetUniformLocation(program, "u_camPos");
+    u->rotation = glGetUniformLocation(program, "u_rotation");
+    u->colorPalette = glGetUniformLocation(program, "u_colorPalette");
+    u->hullDepth = glGetUniformLocation(program, "u_hullDepth");
+    u->depthPrepass = glGetUniformLocation(program, "u_depthPrepass");
+    u->lightingVolume = glGetUniformLocation(program, "u_lightingVolume");
+    u->bakedLighting = glGetUniformLocation(program, "u_bakedLighting");
+    u->reflectionSlices = glGetUniformLocation(program, "u_reflectionSlices");
+    u->reflectionSlice = glGetUniformLocation(program, "u_reflectionSlice");
+    u->reflectionHistory = glGetUniformLocation(program, "u_reflectionHistory");
+    u->historyValid = glGetUniformLocation(program, "u_historyValid");
+    u->prevCamPos = glGetUniformLocation(program, "u_prevCamPos");
+    u->prevRotation = glGetUniformLocation(program, "u_prevRotation");
+    u->blueNoise = glGetUniformLocation(program, "u_blueNoise");
+    u->jitter = glGetUniformLocation(program, "u_jitter");
+    u->noiseOffset = glGetUniformLocation(program, "u_noiseOffset");
+    u->glowSteps = glGetUniformLocation(program, "u_glowSteps");
+    u->aaGrid = glGetUniformLocation(program, "u_aaGrid");
+    u->sampleShading = glGetUniformLocation(program, "u_sampleShading");
+    u->checkerboard = glGetUniformLocation(program, "u_checkerboard");
+    u->checkerParity = glGetUniformLocation(program, "u_checkerParity");
+    u->pixelScale = glGetUniformLocation(program, "u_pixelScale");
+    u->rateRegion = glGetUniformLocation(program, "u_rateRegion");
+    u->panorama = glGetUniformLocation(program, "u_panorama");
+    u->panoramaTile = glGetUniformLocation(program, "u_panoramaTile");
+    u->tileOrigin = glGetUniformLocation(program, "u_tileOrigin");
+    u->hdr = glGetUniformLocation(program, "u_hdr");
+}
+
+// Depth-only render target for the bounding-hull pre-pass
+typedef struct {
+    GLuint fbo;
+    GLuint depthTex;
+    int width;
+    int height;
+} DepthTarget;
+
+bool createDepthTarget(DepthTarget* target, int width, int height) {
+    target->width = width;
+    target->height = height;
+    
+    glGenTextures(1, &target->depthTex);
+    glBindTexture(GL_TEXTURE_2D, target->depthTex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    
+    glGenFramebuffers(1, &target->fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, target->fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, target->depthTex, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "Hull depth framebuffer incomplete (0x%x)\n", status);
+        return false;
+    }
+    return true;
+}
+
+void destroyDepthTarget(DepthTarget* target) {
+    glDeleteFramebuffers(1, &target->fbo);
+    glDeleteTextures(1, &target->depthTex);
+    target->fbo = 0;
+    target->depthTex = 0;
+}
+
+// Color format of the frames passed between render passes. Half floats
+// carry HDR frames to the tone map unclamped.
+#define SCENE_COLOR_FORMAT GL_RGBA16F
+
+// Offscreen frame for time-sliced reflections: the color shown on screen
+// plus the reflection history, ping-ponged so each frame reads the
+// previous one's (fbo[i] writes historyTex[i])
+typedef struct {
+    GLuint fbo[2];
+    GLuint colorTex;
+    GLuint historyTex[2];
+    int width;
+    int height;
+} ReflectionTarget;
+
+static GLuint createTargetTexture(GLenum internalFormat, int width, int height) {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture;
+}
+
+bool createReflectionTarget(ReflectionTarget* target, int width, int height) {
+    static const GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    target->width = width;
+    target->height = height;
+    target->colorTex = createTargetTexture(SCENE_COLOR_FORMAT, width, height);
+    // Filtered by the bilinear upscaler when rendering at reduced size
+    glBindTexture(GL_TEXTURE_2D, target->colorTex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    
+    glGenFramebuffers(2, target->fbo);
+    for (int i = 0; i < 2; i++) {
+        target->historyTex[i] = createTargetTexture(GL_RGBA16F, width, height);
+        glBindFramebuffer(GL_FRAMEBUFFER, target->fbo[i]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target->colorTex, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, target->historyTex[i], 0);
+        glDrawBuffers(2, drawBuffers);
+        GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+        if (status != GL_FRAMEBUFFER_COMPLETE) {
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            fprintf(stderr, "Reflection history framebuffer incomplete (0x%x)\n", status);
+            return false;
+        }
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return true;
+}
+
+void destroyReflectionTarget(ReflectionTarget* target) {
+    glDeleteFramebuffers(2, target->fbo);
+    glDeleteTextures(2, target->historyTex);
+    glDeleteTextures(1, &target->colorTex);
+    memset(target, 0, sizeof(*target));
+}
+
+// Checkerboard rendering: the fractal shades one field, half the pixels
+// packed into a half-width target, per frame; the reconstruction pass
+// completes it from the previous frame into history[parity] and reads
+// history[parity ^ 1]
+typedef struct {
+    GLuint fieldFbo;
+    GLuint fieldColorTex;
+    GLuint fieldGuideTex;
+    GLuint historyFbo[2];
+    GLuint historyColorTex[2];
+    GLuint historyGuideTex[2];
+    int width;
+    int height;
+} CheckerboardTarget;
+
+static bool attachColorTargets(GLuint fbo, GLuint color, GLuint guide, const char* name) {
+    static const GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, guide, 0);
+    glDrawBuffers(2, drawBuffers);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "%s framebuffer incomplete (0x%x)\n", name, status);
+        return false;
+    }
+    return true;
+}
+
+bool createCheckerboardTarget(CheckerboardTarget* target, int width, int height) {
+    target->width = width;
+    target->height = height;
+    target->fieldColorTex = createTargetTexture(SCENE_COLOR_FORMAT, (width + 1) / 2, height);
+    target->fieldGuideTex = createTargetTexture(GL_RGBA16F, (width + 1) / 2, height);
+    glGenFramebuffers(1, &target->fieldFbo);
+    if (!attachColorTargets(target->fieldFbo, target->fieldColorTex, target->fieldGuideTex, "Checkerboard field")) {
+        return false;
+    }
+    glGenFramebuffers(2, target->historyFbo);
+    for (int i = 0; i < 2; i++) {
+        target->historyColorTex[i] = createTargetTexture(SCENE_COLOR_FORMAT, width, height);
+        target->historyGuideTex[i] = createTargetTexture(GL_RGBA16F, width, height);
+        // Filtered by the bilinear upscaler when rendering at reduced size
+        glBindTexture(GL_TEXTURE_2D, target->historyColorTex[i]);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        if (!attachColorTargets(target->historyFbo[i], target->historyColorTex[i], target->historyGuideTex[i],
+                                "Checkerboard history")) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void destroyCheckerboardTarget(CheckerboardTarget* target) {
+    glDeleteFramebuffers(1, &target->fieldFbo);
+    glDeleteFramebuffers(2, target->historyFbo);
+    glDeleteTextures(1, &target->fieldColorTex);
+    glDeleteTextures(1, &target->fieldGuideTex);
+    glDeleteTextures(2, target->historyColorTex);
+    glDeleteTextures(2, target->historyGuideTex);
+    memset(target, 0, sizeof(*target));
+}
+
+typedef struct {
+    GLint field;
+    GLint fieldGuide;
+    GLint history;
+    GLint historyGuide;
+    GLint parity;
+    GLint historyValid;
+    GLint resolution;
+    GLint camPos;
+    GLint rotation;
+    GLint prevCamPos;
+    GLint prevRotation;
+} CheckerboardUniforms;
+
+void getCheckerboardUniforms(GLuint program, CheckerboardUniforms* u) {
+    u->field = glGetUniformLocation(program, "u_field");
+    u->fieldGuide = glGetUniformLocation(program, "u_fieldGuide");
+    u->history = glGetUniformLocation(program, "u_history");
+    u->historyGuide = glGetUniformLocation(program, "u_historyGuide");
+    u->parity = glGetUniformLocation(program, "u_parity");
+    u->historyValid = glGetUniformLocation(program, "u_historyValid");
+    u->resolution = glGetUniformLocation(program, "u_resolution");
+    u->camPos = glGetUniformLocation(program, "u_camPos");
+    u->rotation = glGetUniformLocation(program, "u_rotation");
+    u->prevCamPos = glGetUniformLocation(program, "u_prevCamPos");
+    u->prevRotation = glGetUniformLocation(program, "u_prevRotation");
+}
+
+// Reduced-resolution frame and the window-sized upscaler output that
+// the sharpening pass reads
+typedef struct {
+    GLuint sceneFbo;
+    GLuint sceneTex;
+    GLuint upscaleFbo;
+    GLuint upscaleTex;
+    int width;
+    int height;
+    int outputWidth;
+    int outputHeight;
+} UpscaleTarget;
+
+static bool attachColorTarget(GLuint fbo, GLuint texture, const char* name) {
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "%s framebuffer incomplete (0x%x)\n", name, status);
+        return false;
+    }
+    return true;
+}
+
+bool createUpscaleTarget(UpscaleTarget* target, int width, int height, int outputWidth, int outputHeight) {
+    target->width = width;
+    target->height = height;
+    target->outputWidth = outputWidth;
+    target->outputHeight = outputHeight;
+    target->sceneTex = createTargetTexture(GL_RGBA8, width, height);
+    target->upscaleTex = createTargetTexture(GL_RGBA8, outputWidth, outputHeight);
+    // The bilinear upscaler samples the scene with the texture filter
+    glBindTexture(GL_TEXTURE_2D, target->sceneTex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glGenFramebuffers(1, &target->sceneFbo);
+    glGenFramebuffers(1, &target->upscaleFbo);
+    return attachColorTarget(target->sceneFbo, target->sceneTex, "Scaled scene") &&
+           attachColorTarget(target->upscaleFbo, target->upscaleTex, "Upscaler");
+}
+
+void destroyUpscaleTarget(UpscaleTarget* target) {
+    glDeleteFramebuffers(1, &target->sceneFbo);
+    glDeleteFramebuffers(1, &target->upscaleFbo);
+    glDeleteTextures(1, &target->sceneTex);
+    glDeleteTextures(1, &target->upscaleTex);
+    memset(target, 0, sizeof(*target));
+}
+
+// Variable-rate shading: rings around the screen center are shaded at
+// full, half and quarter resolution into level 0, 1 and 2, then blended.
+// Radii are in the shader's uv units (half the screen height is 0.5).
+#define RATE_LEVELS 3
+#define RATE_BAND 0.02f     // half-width of the cross-fade between levels
+#define RATE_PROBE_INTERVAL 60  // frames between full-rate timings of the outer rings
+
+typedef struct {
+    GLuint fbo[RATE_LEVELS];
+    GLuint colorTex[RATE_LEVELS];
+    int width;
+    int height;
+} RateTarget;
+
+bool createRateTarget(RateTarget* target, int width, int height) {
+    target->width = width;
+    target->height = height;
+    glGenFramebuffers(RATE_LEVELS, target->fbo);
+    for (int level = 0; level < RATE_LEVELS; level++) {
+        int scale = 1 << level;
+        target->colorTex[level] = createTargetTexture(SCENE_COLOR_FORMAT, (width + scale - 1) / scale,
+                                                      (height + scale - 1) / scale);
+        // Coarse levels are filtered when blended
+        glBindTexture(GL_TEXTURE_2D, target->colorTex[level]);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        if (!attachColorTarget(target->fbo[level], target->colorTex[level], "Variable-rate level")) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void destroyRateTarget(RateTarget* target) {
+    glDeleteFramebuffers(RATE_LEVELS, target->fbo);
+    glDeleteTextures(RATE_LEVELS, target->colorTex);
+    memset(target, 0, sizeof(*target));
+}
+
+// Region of level `level` in uv radii: its ring widened by the blend band
+// and two of its pixels, which bilinear filtering reaches into
+static void rateRegion(const float radii[2], int level, int height, float* inner, float* outer) {
+    float margin = 2.0f * (1 << level) / height;
+    *inner = level == 0 ? 0.0f : radii[level - 1] - RATE_BAND - margin;
+    *outer = level == RATE_LEVELS - 1 ? 1e9f : radii[level] + RATE_BAND + margin;
+}
+
+// Fraction of a full-rate frame's fragments the three passes shade
+double rateShadedFraction(const float radii[2], int width, int height) {
+    double shaded = 0.0;
+    for (int level = 0; level < RATE_LEVELS; level++) {
+        int scale = 1 << level;
+        float inner, outer;
+        rateRegion(radii, level, height, &inner, &outer);
+        for (int y = 0; y < (height + scale - 1) / scale; y++) {
+            for (int x = 0; x < (width + scale - 1) / scale; x++) {
+                float u = ((x + 0.5f) * scale - 0.5f * width) / height;
+                float v = ((y + 0.5f) * scale - 0.5f * height) / height;
+                float r = sqrtf(u * u + v * v);
+                shaded += r >= inner && r <= outer;
+            }
+        }
+    }
+    return shaded / ((double)width * height);
+}
+
+// Stereo pair, one eye per half of the frame. The left eye is rendered
+// with its hit distances; the right eye's stencil marks the pixels
+// reprojected from them, and only the rest is marched.
+#define STEREO_FRACTAL_RADIUS 1.9f  // bounding sphere of the fractal, for the largest disparity
+
+typedef struct {
+    GLuint fbo[2];
+    GLuint colorTex[2];
+    GLuint guideTex[2];
+    GLuint stencil;
+    int width;      // per eye
+    int height;
+} StereoTarget;
+
+bool createStereoTarget(StereoTarget* target, int width, int height) {
+    target->width = width;
+    target->height = height;
+    glGenFramebuffers(2, target->fbo);
+    glGenRenderbuffers(1, &target->stencil);
+    glBindRenderbuffer(GL_RENDERBUFFER, target->stencil);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, target->fbo[1]);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, target->stencil);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    for (int eye = 0; eye < 2; eye++) {
+        target->colorTex[eye] = createTargetTexture(SCENE_COLOR_FORMAT, width, height);
+        target->guideTex[eye] = createTargetTexture(GL_RGBA16F, width, height);
+        if (!attachColorTargets(target->fbo[eye], target->colorTex[eye], target->guideTex[eye],
+                                eye ? "Right eye" : "Left eye")) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void destroyStereoTarget(StereoTarget* target) {
+    glDeleteFramebuffers(2, target->fbo);
+    glDeleteTextures(2, target->colorTex);
+    glDeleteTextures(2, target->guideTex);
+    glDeleteRenderbuffers(1, &target->stencil);
+    memset(target, 0, sizeof(*target));
+}
+
+// Depth of field and motion blur at render size. A frame drawn straight
+// goes into the scene attachments; the time-sliced and checkerboard
+// targets keep their own colors and hit distances.
+typedef struct {
+    GLuint sceneFbo;
+    GLuint colorTex;
+    GLuint guideTex;
+    GLuint velocityFbo;
+    GLuint velocityTex;
+    GLuint dofFbo;          // depth of field output when motion blur follows
+    GLuint dofTex;
+    GLuint featureFbo;      // denoiser normals and distances
+    GLuint featureTex;
+    GLuint denoiseFbo[2];   // denoiser levels, ping-ponged
+    GLuint denoiseTex[2];
+    int width;
+    int height;
+} PostTarget;
+
+// Samples and largest radius in pixels per quality level, for the depth
+// of field circle and the motion blur streak
+typedef struct {
+    const char* name;
+    int dofSamples;
+    float maxCoc;
+    int blurSamples;
+    float maxBlur;
+} PostQuality;
+
+// Color sigma of the first denoiser level; it halves every level after
+#define DENOISE_COLOR_SIGMA 1.0f
+#define DENOISE_MAX_PASSES 5
+
+static const PostQuality postQualityLevels[] = {
+    { "low", 12, 6.0f, 5, 16.0f },
+    { "medium", 24, 10.0f, 9, 32.0f },
+    { "high", 48, 16.0f, 17, 48.0f },
+};
+#define POST_QUALITY_COUNT (int)(sizeof(postQualityLevels) / sizeof(postQualityLevels[0]))
+
+bool createPostTarget(PostTarget* target, int width, int height) {
+    target->width = width;
+    target->height = height;
+    target->colorTex = createTargetTexture(SCENE_COLOR_FORMAT, width, height);
+    target->guideTex = createTargetTexture(GL_RGBA16F, width, height);
+    target->velocityTex = createTargetTexture(GL_RG16F, width, height);
+    target->dofTex = createTargetTexture(SCENE_COLOR_FORMAT, width, height);
+    target->featureTex = createTargetTexture(GL_RGBA16F, width, height);
+    glGenFramebuffers(1, &target->sceneFbo);
+    glGenFramebuffers(1, &target->velocityFbo);
+    glGenFramebuffers(1, &target->dofFbo);
+    glGenFramebuffers(1, &target->featureFbo);
+    glGenFramebuffers(2, target->denoiseFbo);
+    for (int i = 0; i < 2; i++) {
+        target->denoiseTex[i] = createTargetTexture(SCENE_COLOR_FORMAT, width, height);
+        if (!attachColorTarget(target->denoiseFbo[i], target->denoiseTex[i], "Denoiser")) {
+            return false;
+        }
+    }
+    return attachColorTargets(target->sceneFbo, target->colorTex, target->guideTex, "Post-process scene") &&
+           attachColorTarget(target->velocityFbo, target->velocityTex, "Velocity") &&
+           attachColorTarget(target->dofFbo, target->dofTex, "Depth of field") &&
+           attachColorTarget(target->featureFbo, target->featureTex, "Denoiser features");
+}
+
+void destroyPostTarget(PostTarget* target) {
+    glDeleteFramebuffers(1, &target->sceneFbo);
+    glDeleteFramebuffers(1, &target->velocityFbo);
+    glDeleteFramebuffers(1, &target->dofFbo);
+    glDeleteFramebuffers(1, &target->featureFbo);
+    glDeleteFramebuffers(2, target->denoiseFbo);
+    glDeleteTextures(1, &target->colorTex);
+    glDeleteTextures(1, &target->guideTex);
+    glDeleteTextures(1, &target->velocityTex);
+    glDeleteTextures(1, &target->dofTex);
+    glDeleteTextures(1, &target->featureTex);
+    glDeleteTextures(2, target->denoiseTex);
+    memset(target, 0, sizeof(*target));
+}
+
+// Equirectangular panorama capture: the frame is rendered in strips of
+// rows, each in tiles of at most PANORAMA_TILE^2 fragments, and every
+// strip is written out before the next one is drawn. Rows nearer the
+// poles than 60, 75.5 and 82.8 degrees of latitude span half, a quarter
+// and an eighth of the equator's length, so they are shaded at that
+// fraction of the width and interpolated back, wrapping around.
+#define PANORAMA_TILE 512
+#define PANORAMA_MAX_STRETCH 8
+
+// Panorama pixels across per fragment for row y
+static int panoramaStretch(int y, int height) {
+    double latitude = ((y + 0.5) / height - 0.5) * 3.14159265358979;
+    double span = cos(latitude);
+    int stretch = 1;
+    while (stretch < PANORAMA_MAX_STRETCH && span * stretch * 2 <= 1.0) {
+        stretch *= 2;
+    }
+    return stretch;
+}
+
+// Renames from over to, replacing it in one step
+static bool replaceFile(const char* from, const char* to) {
+#ifdef _WIN32
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return rename(from, to) == 0;
+#endif
+}
+
+// Renders the panorama with the fractal program, which must be bound with
+// its uniforms set, and streams it to path as a PPM under a temporary
+// name, renamed into place once complete
+static bool renderPanorama(const char* path, int width, int height, const FractalUniforms* uniforms) {
+    char temporary[1024];
+    snprintf(temporary, sizeof(temporary), "%s.part", path);
+    FILE* file = fopen(temporary, "wb");
+    if (!file) {
+        fprintf(stderr, "Could not open %s for writing\n", temporary);
+        return false;
+    }
+    unsigned char* strip = (unsigned char*)malloc((size_t)width * PANORAMA_TILE * 3);
+    unsigned char* row = (unsigned char*)malloc((size_t)width * 3);
+    GLuint fbo = 0;
+    GLuint texture = createTargetTexture(GL_RGBA8, PANORAMA_TILE, PANORAMA_TILE);
+    glGenFramebuffers(1, &fbo);
+    bool ok = strip && row && attachColorTarget(fbo, texture, "Panorama tile") &&
+              fprintf(file, "P6\n%d %d\n255\n", width, height) > 0;
+    
+    Uint64 start = SDL_GetPerformanceCounter();
+    double shaded = 0.0;
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glUniform1i(uniforms->panorama, 1);
+    glUniform2f(uniforms->resolution, (float)width, (float)height);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    
+    // Strips from the top row down, as the file is laid out; a strip
+    // keeps to one stretch
+    for (int top = height; ok && top > 0;) {
+        int stretch = panoramaStretch(top - 1, height);
+        int bottom = top - 1;
+        while (bottom > 0 && top - bottom < PANORAMA_TILE && panoramaStretch(bottom - 1, height) == stretch) {
+            bottom--;
+        }
+        int rows = top - bottom;
+        int columns = width / stretch;
+        shaded += (double)columns * rows;
+        
+        glPixelStorei(GL_PACK_ROW_LENGTH, columns);
+        for (int x = 0; x < columns; x += PANORAMA_TILE) {
+            int tileWidth = columns - x < PANORAMA_TILE ? columns - x : PANORAMA_TILE;
+            glViewport(0, 0, tileWidth, rows);
+            glUniform3f(uniforms->panoramaTile, (float)x, (float)bottom, (float)stretch);
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            glReadPixels(0, 0, tileWidth, rows, GL_RGB, GL_UNSIGNED_BYTE, strip + (size_t)x * 3);
+        }
+        
+        for (int y = rows - 1; ok && y >= 0; y--) {
+            const unsigned char* src = strip + (size_t)y * columns * 3;
+            for (int x = 0; x < width; x++) {
+                // Fragment i covers pixels [i * stretch, (i + 1) * stretch)
+                float f = (x + 0.5f) / stretch - 0.5f;
+                int i0 = (int)floorf(f);
+                float w = f - i0;
+                int a = (i0 + columns) % columns;
+                int b = (i0 + 1) % columns;
+                for (int c = 0; c < 3; c++) {
+                    row[x * 3 + c] = (unsigned char)(src[a * 3 + c] * (1.0f - w) + src[b * 3 + c] * w + 0.5f);
+                }
+            }
+            ok = fwrite(row, 1, (size_t)width * 3, file) == (size_t)width * 3;
+        }
+        top = bottom;
+        printf("\rPanorama: %d of %d rows", height - top, height);
+        fflush(stdout);
+    }
+    
+    glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+    glUniform1i(uniforms->panorama, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteTextures(1, &texture);
+    free(strip);
+    free(row);
+    ok = fclose(file) == 0 && ok;
+    ok = ok && replaceFile(temporary, path);
+    double seconds = (SDL_GetPerformanceCounter() - start) / (double)SDL_GetPerformanceFrequency();
+    if (ok) {
+        printf("\nPanorama %dx%d written to %s in %.1f s, %.0f%% of the pixels shaded\n", width, height, path,
+               seconds, 100.0 * shaded / ((double)width * height));
+    } else {
+        fprintf(stderr, "\nFailed to write the panorama to %s\n", path);
+        remove(temporary);
+    }
+    return ok;
+}
+
+// Offline animation: worker processes share the frames of an animation
+// through a queue file in the output directory. The file holds a header
+// with the animation's settings and one status byte per chunk of frames,
+// '.' while pending and '#' once every frame of the chunk is on disk. A
+// worker holds an OS lock on its chunk while rendering it. The OS drops
+// the lock if the worker dies, so the chunk goes back to the queue, and
+// the frames it finished are skipped because each one is renamed into
+// place only once it is complete.
+#define ANIMATION_QUEUE_NAME "animation.queue"
+#define ANIMATION_HEADER_SIZE 128
+#define ANIMATION_TILE 512
+// The locks sit past the data: Windows locks are mandatory, and would
+// otherwise stop other workers from reading the status bytes
+#define ANIMATION_LOCK_BASE 0x40000000L
+
+typedef struct {
+#ifdef _WIN32
+    HANDLE file;
+#else
+    int file;
+#endif
+    const char* directory;
+    int frames;
+    int chunkFrames;
+    int chunkCount;
+    int claimed;            // chunk this worker holds, -1 for none
+    int rendered;           // frames this worker wrote
+} AnimationQueue;
+
+static bool animationLock(AnimationQueue* queue, long offset, bool wait) {
+#ifdef _WIN32
+    OVERLAPPED at = {0};
+    at.Offset = (DWORD)offset;
+    DWORD flags = LOCKFILE_EXCLUSIVE_LOCK | (wait ? 0 : LOCKFILE_FAIL_IMMEDIATELY);
+    return LockFileEx(queue->file, flags, 0, 1, 0, &at) != 0;
+#else
+    struct flock lock;
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = F_WRLCK;
+    lock.l_whence = SEEK_SET;
+    lock.l_start = offset;
+    lock.l_len = 1;
+    int result;
+    do {
+        result = fcntl(queue->file, wait ? F_SETLKW : F_SETLK, &lock);
+    } while (result == -1 && errno == EINTR);
+    return result == 0;
+#endif
+}
+
+static void animationUnlock(AnimationQueue* queue, long offset) {
+#ifdef _WIN32
+    OVERLAPPED at = {0};
+    at.Offset = (DWORD)offset;
+    UnlockFileEx(queue->file, 0, 1, 0, &at);
+#else
+    struct flock lock;
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = F_UNLCK;
+    lock.l_whence = SEEK_SET;
+    lock.l_start = offset;
+    lock.l_len = 1;
+    fcntl(queue->file, F_SETLK, &lock);
+#endif
+}
+
+// Reads or writes size bytes at offset; returns the bytes transferred
+static long animationQueueIo(AnimationQueue* queue, long offset, void* data, long size, bool write) {
+#ifdef _WIN32
+    OVERLAPPED at = {0};
+    at.Offset = (DWORD)offset;
+    DWORD done = 0;
+    BOOL ok = write ? WriteFile(queue->file, data, (DWORD)size, &done, &at)
+                    : ReadFile(queue->file, data, (DWORD)size, &done, &at);
+    if (ok && write) ok = FlushFileBuffers(queue->file);
+    return ok ? (long)done : -1;
+#else
+    ssize_t done = write ? pwrite(queue->file, data, (size_t)size, offset)
+                         : pread(queue->file, data, (size_t)size, offset);
+    if (done >= 0 && write && fsync(queue->file) != 0) done = -1;
+    return (long)done;
+#endif
+}
+
+// Pushes a stdio file through to the disk, so a file renamed into place
+// afterwards is complete even after a power loss
+static bool syncFile(FILE* file) {
+    if (fflush(file) != 0) return false;
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+static void animationFramePath(const AnimationQueue* queue, int frame, const char* suffix, char* path,
+                               size_t size) {
+    snprintf(path, size, "%s/frame_%05d.ppm%s", queue->directory, frame, suffix);
+}
+
+// Opens the queue in directory, creating it on first use. A queue left
+// by earlier workers must have been made with the same settings.
+static bool openAnimationQueue(AnimationQueue* queue, const char* directory, int frames, double fps, int width,
+                               int height, int chunkFrames) {
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/" ANIMATION_QUEUE_NAME, directory);
+    memset(queue, 0, sizeof(*queue));
+    queue->directory = directory;
+    queue->frames = frames;
+    queue->chunkFrames = chunkFrames;
+    queue->chunkCount = (frames + chunkFrames - 1) / chunkFrames;
+    queue->claimed = -1;
+#ifdef _WIN32
+    queue->file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                              OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    bool opened = queue->file != INVALID_HANDLE_VALUE;
+#else
+    queue->file = open(path, O_RDWR | O_CREAT, 0644);
+    bool opened = queue->file >= 0;
+#endif
+    if (!opened) {
+        fprintf(stderr, "Could not open %s; does the directory exist?\n", path);
+        return false;
+    }
+    
+    char header[ANIMATION_HEADER_SIZE];
+    memset(header, ' ', sizeof(header));
+    int length = snprintf(header, sizeof(header), "SIERANIM 1 frames=%d fps=%.3f size=%dx%d chunk=%d", frames, fps,
+                          width, height, chunkFrames);
+    header[length < ANIMATION_HEADER_SIZE ? length : ANIMATION_HEADER_SIZE - 1] = ' ';
+    header[ANIMATION_HEADER_SIZE - 1] = '\n';
+    
+    char existing[ANIMATION_HEADER_SIZE];
+    animationLock(queue, ANIMATION_LOCK_BASE, true);
+    long got = animationQueueIo(queue, 0, existing, ANIMATION_HEADER_SIZE, false);
+    bool ok = true;
+    if (got == 0) {
+        // First worker: every chunk starts pending
+        char* status = (char*)malloc((size_t)queue->chunkCount + 1);
+        ok = status != NULL;
+        if (ok) {
+            memset(status, '.', (size_t)queue->chunkCount);
+            status[queue->chunkCount] = '\n';
+            ok = animationQueueIo(queue, 0, header, ANIMATION_HEADER_SIZE, true) == ANIMATION_HEADER_SIZE &&
+                 animationQueueIo(queue, ANIMATION_HEADER_SIZE, status, queue->chunkCount + 1, true) ==
+                     queue->chunkCount + 1;
+        }
+        free(status);
+        if (!ok) fprintf(stderr, "Could not write %s\n", path);
+    } else if (got != ANIMATION_HEADER_SIZE || memcmp(existing, header, ANIMATION_HEADER_SIZE) != 0) {
+        fprintf(stderr, "%s was made for other animation settings:\n%.*s\n", path, ANIMATION_HEADER_SIZE - 1,
+                got > 0 ? existing : "");
+        ok = false;
+    }
+    animationUnlock(queue, ANIMATION_LOCK_BASE);
+    return ok;
+}
+
+static void closeAnimationQueue(AnimationQueue* queue) {
+#ifdef _WIN32
+    if (queue->file && queue->file != INVALID_HANDLE_VALUE) CloseHandle(queue->file);
+#else
+    if (queue->file > 0) close(queue->file);
+#endif
+    memset(queue, 0, sizeof(*queue));
+    queue->claimed = -1;
+}
+
+// Takes the first chunk that is neither done nor held by another worker;
+// returns it, or -1 with none left. Also counts the chunks done.
+static int claimAnimationChunk(AnimationQueue* queue, int* doneCount) {
+    char* status = (char*)malloc((size_t)queue->chunkCount);
+    *doneCount = 0;
+    if (!status) return -1;
+    animationLock(queue, ANIMATION_LOCK_BASE, true);
+    if (animationQueueIo(queue, ANIMATION_HEADER_SIZE, status, queue->chunkCount, false) == queue->chunkCount) {
+        for (int chunk = 0; chunk < queue->chunkCount; chunk++) {
+            if (status[chunk] == '#') {
+                (*doneCount)++;
+            } else if (queue->claimed < 0 && animationLock(queue, ANIMATION_LOCK_BASE + 1 + chunk, false)) {
+                queue->claimed = chunk;
+            }
+        }
+    }
+    animationUnlock(queue, ANIMATION_LOCK_BASE);
+    free(status);
+    return queue->claimed;
+}
+
+static void finishAnimationChunk(AnimationQueue* queue) {
+    char done = '#';
+    animationLock(queue, ANIMATION_LOCK_BASE, true);
+    animationQueueIo(queue, ANIMATION_HEADER_SIZE + queue->claimed, &done, 1, true);
+    animationUnlock(queue, ANIMATION_LOCK_BASE + 1 + queue->claimed);
+    animationUnlock(queue, ANIMATION_LOCK_BASE);
+    queue->claimed = -1;
+}
+
+// Frame to render after `frame` (-1 to start): the next one of the held
+// chunk that is not on disk yet, else the first of a newly claimed
+// chunk. Returns -1 once no chunk is left to claim.
+static int nextAnimationFrame(AnimationQueue* queue, int frame) {
+    char path[1024];
+    for (;;) {
+        if (queue->claimed >= 0) {
+            int first = queue->claimed * queue->chunkFrames;
+            int end = first + queue->chunkFrames < queue->frames ? first + queue->chunkFrames : queue->frames;
+            for (frame = frame + 1 > first ? frame + 1 : first; frame < end; frame++) {
+                animationFramePath(queue, frame, "", path, sizeof(path));
+                FILE* existing = fopen(path, "rb");
+                if (!existing) return frame;
+                fclose(existing);
+            }
+            finishAnimationChunk(queue);
+        }
+        int doneCount;
+        if (claimAnimationChunk(queue, &doneCount) < 0) return -1;
+        printf("\nAnimation: chunk %d (frames %d-%d), %d of %d chunks done\n", queue->claimed,
+               queue->claimed * queue->chunkFrames,
+               (queue->claimed + 1) * queue->chunkFrames < queue->frames
+                   ? (queue->claimed + 1) * queue->chunkFrames - 1 : queue->frames - 1,
+               doneCount, queue->chunkCount);
+        frame = -1;
+    }
+}
+
+// Renders one animation frame with the fractal program, which must be
+// bound with its uniforms set, into target (width x height RGBA8) in
+// tiles, so no single draw runs long enough to trip a GPU watchdog. The
+// frame is written under a temporary name and renamed into place.
+static bool renderAnimationFrame(AnimationQueue* queue, int frame, GLuint fbo, int width, int height,
+                                 unsigned char* pixels, const FractalUniforms* uniforms) {
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glUniform2f(uniforms->resolution, (float)width, (float)height);
+    // gl_FragCoord stays in target pixels under a tile's viewport
+    for (int y = 0; y < height; y += ANIMATION_TILE) {
+        for (int x = 0; x < width; x += ANIMATION_TILE) {
+            glViewport(x, y, width - x < ANIMATION_TILE ? width - x : ANIMATION_TILE,
+                       height - y < ANIMATION_TILE ? height - y : ANIMATION_TILE);
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            glFlush();
+        }
+    }
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    
+    char temporary[1024], path[1024];
+    animationFramePath(queue, frame, ".part", temporary, sizeof(temporary));
+    animationFramePath(queue, frame, "", path, sizeof(path));
+    FILE* file = fopen(temporary, "wb");
+    if (!file) {
+        fprintf(stderr, "\nCould not open %s for writing\n", temporary);
+        return false;
+    }
+    bool ok = fprintf(file, "P6\n%d %d\n255\n", width, height) > 0;
+    // Image rows run top to bottom
+    for (int y = height - 1; ok && y >= 0; y--) {
+        ok = fwrite(pixels + (size_t)y * width * 3, 1, (size_t)width * 3, file) == (size_t)width * 3;
+    }
+    // The frame's existence marks it done, so it must be on disk before
+    // it gets its name
+    ok = ok && syncFile(file);
+    ok = fclose(file) == 0 && ok;
+    ok = ok && rename(temporary, path) == 0;
+    if (!ok) {
+        fprintf(stderr, "\nFailed to write %s\n", path);
+        remove(temporary);
+    }
+    queue->rendered += ok ? 1 : 0;
+    return ok;
+}
+
+// Distributed tiles: a coordinator splits one frame into tiles and hands
+// them to worker processes over TCP, usually on the same machine. It
+// first renders a low-resolution cost preview to estimate each tile's
+// cost, then gives every worker a contiguous run of tiles holding an
+// equal share of the estimate. A worker whose run is used up steals the
+// far half, by cost, of the run with the most cost left, so the estimate
+// only has to be roughly right. Each worker has TILE_IN_FLIGHT requests
+// outstanding and never waits on the network between tiles. If a worker
+// disconnects, its tiles are handed out again. Tiles are written into the
+// output file as they arrive, so the coordinator holds no frame buffer.
+#define TILE_HEADER_SIZE 128
+#define TILE_COST_SAMPLES 8         // cost preview pixels across a tile
+#define TILE_IN_FLIGHT 2
+#define TILE_MAX_WORKERS 32
+#define TILE_MAX_FRAME 16384        // keeps file offsets within a long
+#define TILE_STOP 0xffffffffu
+#define TILE_CONNECT_SECONDS 30
+
+#ifdef _WIN32
+typedef SOCKET TileSocket;
+#define TILE_NO_SOCKET INVALID_SOCKET
+#define closeTileSocket closesocket
+#else
+typedef int TileSocket;
+#define TILE_NO_SOCKET (-1)
+#define closeTileSocket close
+#endif
+
+static bool tileSocketsInit(void) {
+#ifdef _WIN32
+    WSADATA data;
+    if (WSAStartup(MAKEWORD(2, 2), &data) != 0) {
+        fprintf(stderr, "Could not initialize Winsock\n");
+        return false;
+    }
+#else
+    // A peer that goes away must not take this process down with it
+    signal(SIGPIPE, SIG_IGN);
+#endif
+    return true;
+}
+
+static void tileSocketsQuit(void) {
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+// Resolves [HOST:]PORT; HOST defaults to the loopback interface
+static struct addrinfo* tileAddress(const char* address, bool listening) {
+    char host[256] = "127.0.0.1";
+    const char* port = address;
+    const char* colon = strrchr(address, ':');
+    if (colon) {
+        size_t length = (size_t)(colon - address);
+        if (length >= sizeof(host)) length = sizeof(host) - 1;
+        memcpy(host, address, length);
+        host[length] = '\0';
+        port = colon + 1;
+    }
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = listening ? AI_PASSIVE : 0;
+    struct addrinfo* result = NULL;
+    int error = getaddrinfo(host, port, &hints, &result);
+    if (error != 0) {
+        fprintf(stderr, "Could not resolve %s: %s\n", address, gai_strerror(error));
+        return NULL;
+    }
+    return result;
+}
+
+// Requests and replies are small and latency-bound
+static void tileSocketOptions(TileSocket s) {
+    int on = 1;
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char*)&on, sizeof(on));
+}
+
+static TileSocket tileListen(const char* address) {
+    struct addrinfo* info = tileAddress(address, true);
+    TileSocket s = TILE_NO_SOCKET;
+    for (struct addrinfo* a = info; a && s == TILE_NO_SOCKET; a = a->ai_next) {
+        s = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (s == TILE_NO_SOCKET) continue;
+        int on = 1;
+        setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char*)&on, sizeof(on));
+        if (bind(s, a->ai_addr, (int)a->ai_addrlen) != 0 || listen(s, TILE_MAX_WORKERS) != 0) {
+            closeTileSocket(s);
+            s = TILE_NO_SOCKET;
+        }
+    }
+    if (info) freeaddrinfo(info);
+    if (s == TILE_NO_SOCKET) fprintf(stderr, "Could not listen on %s\n", address);
+    return s;
+}
+
+// Connects to the coordinator, retrying while it starts up
+static TileSocket tileConnect(const char* address) {
+    struct addrinfo* info = tileAddress(address, false);
+    TileSocket s = TILE_NO_SOCKET;
+    for (int attempt = 0; info && s == TILE_NO_SOCKET && attempt < TILE_CONNECT_SECONDS * 4; attempt++) {
+        if (attempt > 0) SDL_Delay(250);
+        for (struct addrinfo* a = info; a && s == TILE_NO_SOCKET; a = a->ai_next) {
+            s = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+            if (s != TILE_NO_SOCKET && connect(s, a->ai_addr, (int)a->ai_addrlen) != 0) {
+                closeTileSocket(s);
+                s = TILE_NO_SOCKET;
+            }
+        }
+    }
+    if (info) freeaddrinfo(info);
+    if (s == TILE_NO_SOCKET) {
+        fprintf(stderr, "Could not connect to the tile coordinator at %s\n", address);
+    } else {
+        tileSocketOptions(s);
+    }
+    return s;
+}
+
+static bool tileSend(TileSocket s, const void* data, size_t size) {
+    const char* at = (const char*)data;
+    while (size > 0) {
+        int sent = send(s, at, size < (1 << 20) ? (int)size : (1 << 20), 0);
+        if (sent <= 0) return false;
+        at += sent;
+        size -= (size_t)sent;
+    }
+    return true;
+}
+
+static bool tileReceive(TileSocket s, void* data, size_t size) {
+    char* at = (char*)data;
+    while (size > 0) {
+        int got = recv(s, at, size < (1 << 20) ? (int)size : (1 << 20), 0);
+        if (got <= 0) return false;
+        at += got;
+        size -= (size_t)got;
+    }
+    return true;
+}
+
+// Messages are runs of 32-bit words in network byte order
+static bool tileSendWords(TileSocket s, const uint32_t* words, int count) {
+    uint32_t wire[8];
+    for (int i = 0; i < count; i++) wire[i] = htonl(words[i]);
+    return tileSend(s, wire, (size_t)count * sizeof(uint32_t));
+}
+
+static bool tileReceiveWords(TileSocket s, uint32_t* words, int count) {
+    if (!tileReceive(s, words, (size_t)count * sizeof(uint32_t))) return false;
+    for (int i = 0; i < count; i++) words[i] = ntohl(words[i]);
+    return true;
+}
+
+// The coordinator greets each worker with the frame and the settings that
+// change the image, which the worker must have been started with as well
+static void tileHeader(char* header, int width, int height, int tileSize, const char* settings) {
+    memset(header, ' ', TILE_HEADER_SIZE);
+    int length = snprintf(header, TILE_HEADER_SIZE, "SIERTILE 1 size=%dx%d tile=%d %s", width, height, tileSize,
+                          settings);
+    header[length < TILE_HEADER_SIZE ? length : TILE_HEADER_SIZE - 1] = ' ';
+    header[TILE_HEADER_SIZE - 1] = '\n';
+}
+
+typedef struct {
+    int x, y, width, height;
+    float cost;             // estimated by the cost preview
+    float seconds;          // measured by the worker that rendered it
+} FrameTile;
+
+typedef struct {
+    TileSocket socket;      // TILE_NO_SOCKET once gone
+    int begin, end;         // its run of tiles still to hand out
+    int inFlight[TILE_IN_FLIGHT];
+    int inFlightCount;
+    int rendered;
+    int stolen;             // tiles it took from other runs
+    double estimated;       // estimated cost of the tiles it rendered
+    double seconds;         // time it spent rendering them
+} TileWorker;
+
+typedef struct {
+    FrameTile* tiles;       // in scan order from the bottom left
+    int count;
+    double* prefix;         // estimated cost of tiles [0, i)
+    TileWorker workers[TILE_MAX_WORKERS];
+    int workerCount;        // slots used, including gone workers
+    int* retry;             // tiles of gone workers, handed out first
+    int retryCount;
+    int remaining;
+    int width, height;
+    FILE* file;
+    long dataStart;
+    bool writeFailed;
+    unsigned char* pixels;  // one tile
+} TileCoordinator;
+
+// Sums the cost preview over each tile. The preview, drawn with the
+// frame's camera, has TILE_COST_SAMPLES pixels across a tile.
+static bool estimateTileCosts(TileCoordinator* c, int kernel, int tileSize, const float* rotation,
+                              const float* camPos, int* previewWidth, int* previewHeight) {
+    int step = tileSize / TILE_COST_SAMPLES;
+    int columns = (c->width + tileSize - 1) / tileSize;
+    *previewWidth = (c->width + step - 1) / step;
+    *previewHeight = (c->height + step - 1) / step;
+    GLuint program = createTileCostProgram(kernel);
+    GLuint texture = createTargetTexture(GL_R32F, *previewWidth, *previewHeight);
+    GLuint fbo = 0;
+    glGenFramebuffers(1, &fbo);
+    float* costs = (float*)malloc((size_t)*previewWidth * *previewHeight * sizeof(float));
+    bool ok = program && costs && attachColorTarget(fbo, texture, "Tile cost");
+    if (ok) {
+        glUseProgram(program);
+        glUniform2f(glGetUniformLocation(program, "u_resolution"), (float)c->width, (float)c->height);
+        glUniform3fv(glGetUniformLocation(program, "u_camPos"), 1, camPos);
+        glUniformMatrix3fv(glGetUniformLocation(program, "u_rotation"), 1, GL_FALSE, rotation);
+        glUniform1f(glGetUniformLocation(program, "u_costStep"), (float)step);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glViewport(0, 0, *previewWidth, *previewHeight);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        glReadPixels(0, 0, *previewWidth, *previewHeight, GL_RED, GL_FLOAT, costs);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        for (int y = 0; y < *previewHeight; y++) {
+            for (int x = 0; x < *previewWidth; x++) {
+                int tile = (y / TILE_COST_SAMPLES) * columns + x / TILE_COST_SAMPLES;
+                c->tiles[tile].cost += costs[(size_t)y * *previewWidth + x];
+            }
+        }
+    }
+    glUseProgram(0);
+    glDeleteProgram(program);
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteTextures(1, &texture);
+    free(costs);
+    return ok;
+}
+
+// The worker's next tile: one a gone worker left, else the next of its
+// own run, else the first of the far half, by cost, of the run with the
+// most cost left. Returns -1 once no tile is left to hand out.
+static int nextFrameTile(TileCoordinator* c, TileWorker* worker) {
+    if (c->retryCount > 0) return c->retry[--c->retryCount];
+    if (worker->begin == worker->end) {
+        TileWorker* victim = NULL;
+        double most = 0.0;
+        for (int i = 0; i < c->workerCount; i++) {
+            TileWorker* other = &c->workers[i];
+            double left = c->prefix[other->end] - c->prefix[other->begin];
+            if (other->end > other->begin && (!victim || left > most)) {
+                victim = other;
+                most = left;
+            }
+        }
+        if (!victim) return -1;
+        int split = victim->end - 1;
+        while (split > victim->begin && c->prefix[victim->end] - c->prefix[split - 1] <= most * 0.5) {
+            split--;
+        }
+        worker->begin = split;
+        worker->end = victim->end;
+        worker->stolen += worker->end - worker->begin;
+        victim->end = split;
+    }
+    return worker->begin++;
+}
+
+// Tops up the worker's requests; false if it cannot be reached
+static bool dispatchFrameTiles(TileCoordinator* c, TileWorker* worker) {
+    while (worker->inFlightCount < TILE_IN_FLIGHT) {
+        int tile = nextFrameTile(c, worker);
+        if (tile < 0) break;
+        const FrameTile* t = &c->tiles[tile];
+        uint32_t request[5] = { (uint32_t)tile, (uint32_t)t->x, (uint32_t)t->y, (uint32_t)t->width,
+                                (uint32_t)t->height };
+        worker->inFlight[worker->inFlightCount++] = tile;
+        if (!tileSendWords(worker->socket, request, 5)) return false;
+    }
+    return true;
+}
+
+static void dropTileWorker(TileCoordinator* c, TileWorker* worker) {
+    for (int i = 0; i < worker->inFlightCount; i++) {
+        c->retry[c->retryCount++] = worker->inFlight[i];
+    }
+    printf("\nTiles: worker %d disconnected with %d tiles in flight\n", (int)(worker - c->workers),
+           worker->inFlightCount);
+    worker->inFlightCount = 0;
+    closeTileSocket(worker->socket);
+    worker->socket = TILE_NO_SOCKET;
+}
+
+// Receives one finished tile and writes its rows into the file; false if
+// the worker sent something other than a tile it was asked for
+static bool receiveFrameTile(TileCoordinator* c, TileWorker* worker) {
+    uint32_t reply[2];
+    if (!tileReceiveWords(worker->socket, reply, 2)) return false;
+    int slot = 0;
+    while (slot < worker->inFlightCount && worker->inFlight[slot] != (int)reply[0]) slot++;
+    if (slot == worker->inFlightCount) return false;
+    FrameTile* t = &c->tiles[reply[0]];
+    size_t rowSize = (size_t)t->width * 3;
+    if (!tileReceive(worker->socket, c->pixels, rowSize * t->height)) return false;
+    
+    // Rows arrive bottom up, as read back; the file runs top down
+    for (int row = 0; row < t->height && !c->writeFailed; row++) {
+        long offset = c->dataStart + ((long)(c->height - 1 - t->y - row) * c->width + t->x) * 3;
+        c->writeFailed = fseek(c->file, offset, SEEK_SET) != 0 ||
+                         fwrite(c->pixels + row * rowSize, 1, rowSize, c->file) != rowSize;
+    }
+    worker->inFlight[slot] = worker->inFlight[--worker->inFlightCount];
+    t->seconds = reply[1] / 1e6f;
+    worker->rendered++;
+    worker->estimated += t->cost;
+    worker->seconds += t->seconds;
+    c->remaining--;
+    return true;
+}
+
+// Gives the connected workers contiguous runs of equal estimated cost
+static void planFrameTiles(TileCoordinator* c) {
+    int live = 0;
+    for (int i = 0; i < c->workerCount; i++) {
+        live += c->workers[i].socket != TILE_NO_SOCKET ? 1 : 0;
+    }
+    int at = 0;
+    for (int i = 0, k = 0; i < c->workerCount; i++) {
+        TileWorker* worker = &c->workers[i];
+        if (worker->socket == TILE_NO_SOCKET) continue;
+        double target = c->prefix[c->count] * ++k / live;
+        int end = at;
+        while (end < c->count && (k == live || c->prefix[end] + c->tiles[end].cost * 0.5 < target)) end++;
+        worker->begin = at;
+        worker->end = end;
+        at = end;
+    }
+}
+
+// Renders the frame with the workers that connect to address, which
+// render the fractal with settings, and writes it to path as a PPM
+static bool runTileCoordinator(const char* address, int width, int height, int tileSize, int expectedWorkers,
+                               const char* path, const char* settings, int kernel, const float* rotation,
+                               const float* camPos) {
+    TileCoordinator c;
+    memset(&c, 0, sizeof(c));
+    c.width = width;
+    c.height = height;
+    int columns = (width + tileSize - 1) / tileSize;
+    int rows = (height + tileSize - 1) / tileSize;
+    c.count = columns * rows;
+    c.remaining = c.count;
+    c.tiles = (FrameTile*)calloc((size_t)c.count, sizeof(FrameTile));
+    c.prefix = (double*)malloc(((size_t)c.count + 1) * sizeof(double));
+    c.retry = (int*)malloc((size_t)c.count * sizeof(int));
+    c.pixels = (unsigned char*)malloc((size_t)tileSize * tileSize * 3);
+    bool ok = c.tiles && c.prefix && c.retry && c.pixels;
+    for (int i = 0; ok && i < c.count; i++) {
+        FrameTile* t = &c.tiles[i];
+        t->x = (i % columns) * tileSize;
+        t->y = (i / columns) * tileSize;
+        t->width = width - t->x < tileSize ? width - t->x : tileSize;
+        t->height = height - t->y < tileSize ? height - t->y : tileSize;
+    }
+    
+    Uint64 frequency = SDL_GetPerformanceFrequency();
+    Uint64 start = SDL_GetPerformanceCounter();
+    int previewWidth = 0, previewHeight = 0;
+    ok = ok && estimateTileCosts(&c, kernel, tileSize, rotation, camPos, &previewWidth, &previewHeight);
+    if (ok) {
+        c.prefix[0] = 0.0;
+        for (int i = 0; i < c.count; i++) c.prefix[i + 1] = c.prefix[i] + c.tiles[i].cost;
+        printf("Tiles: %d tiles of %dx%d, costs estimated from a %dx%d preview in %.2f s\n", c.count, tileSize,
+               tileSize, previewWidth, previewHeight,
+               (SDL_GetPerformanceCounter() - start) / (double)frequency);
+    }
+    
+    TileSocket listener = ok ? tileListen(address) : TILE_NO_SOCKET;
+    ok = ok && listener != TILE_NO_SOCKET;
+    if (ok) {
+        c.file = fopen(path, "wb");
+        ok = c.file && fprintf(c.file, "P6\n%d %d\n255\n", width, height) > 0;
+        if (!ok) fprintf(stderr, "Could not open %s for writing\n", path);
+        if (ok) c.dataStart = ftell(c.file);
+    }
+    if (ok) {
+        printf("Tiles: waiting for %d worker%s on %s\n", expectedWorkers, expectedWorkers > 1 ? "s" : "", address);
+        fflush(stdout);
+    }
+    char header[TILE_HEADER_SIZE];
+    tileHeader(header, width, height, tileSize, settings);
+    bool planned = false;
+    Uint64 renderStart = 0;
+    
+    while (ok && c.remaining > 0 && !c.writeFailed) {
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(listener, &readable);
+        TileSocket highest = listener;
+        for (int i = 0; i < c.workerCount; i++) {
+            if (c.workers[i].socket == TILE_NO_SOCKET) continue;
+            FD_SET(c.workers[i].socket, &readable);
+            if (c.workers[i].socket > highest) highest = c.workers[i].socket;
+        }
+        struct timeval timeout = { 1, 0 };
+        int ready = select((int)highest + 1, &readable, NULL, NULL, &timeout);
+        if (ready < 0 && errno == EINTR) continue;
+        if (ready < 0) {
+            fprintf(stderr, "\nTiles: select failed\n");
+            ok = false;
+            break;
+        }
+        
+        // New workers join; once the frame is planned they start stealing
+        if (FD_ISSET(listener, &readable)) {
+            TileSocket s = accept(listener, NULL, NULL);
+            if (s != TILE_NO_SOCKET && c.workerCount < TILE_MAX_WORKERS && tileSend(s, header, sizeof(header))) {
+                TileWorker* worker = &c.workers[c.workerCount++];
+                memset(worker, 0, sizeof(*worker));
+                worker->socket = s;
+                tileSocketOptions(s);
+                printf("\nTiles: worker %d connected\n", c.workerCount - 1);
+                if (planned && !dispatchFrameTiles(&c, worker)) dropTileWorker(&c, worker);
+            } else if (s != TILE_NO_SOCKET) {
+                closeTileSocket(s);
+            }
+        }
+        
+        if (!planned) {
+            int live = 0;
+            for (int i = 0; i < c.workerCount; i++) {
+                live += c.workers[i].socket != TILE_NO_SOCKET ? 1 : 0;
+            }
+            if (live >= expectedWorkers) {
+                planFrameTiles(&c);
+                planned = true;
+                renderStart = SDL_GetPerformanceCounter();
+                for (int i = 0; i < c.workerCount; i++) {
+                    TileWorker* worker = &c.workers[i];
+                    if (worker->socket != TILE_NO_SOCKET && !dispatchFrameTiles(&c, worker)) {
+                        dropTileWorker(&c, worker);
+                    }
+                }
+            }
+        }
+        
+        for (int i = 0; i < c.workerCount; i++) {
+            TileWorker* worker = &c.workers[i];
+            if (worker->socket == TILE_NO_SOCKET || !FD_ISSET(worker->socket, &readable)) continue;
+            if (!receiveFrameTile(&c, worker) || !dispatchFrameTiles(&c, worker)) {
+                dropTileWorker(&c, worker);
+            }
+            // The tiles a worker dropped go to the next one with room
+            for (int j = 0; c.retryCount > 0 && j < c.workerCount; j++) {
+                if (c.workers[j].socket != TILE_NO_SOCKET && !dispatchFrameTiles(&c, &c.workers[j])) {
+                    dropTileWorker(&c, &c.workers[j]);
+                }
+            }
+        }
+        if (planned) {
+            printf("\rTiles: %d of %d done", c.count - c.remaining, c.count);
+            fflush(stdout);
+        }
+    }
+    
+    // Workers exit once told there is nothing left
+    uint32_t stop[5] = { TILE_STOP, 0, 0, 0, 0 };
+    for (int i = 0; i < c.workerCount; i++) {
+        if (c.workers[i].socket == TILE_NO_SOCKET) continue;
+        tileSendWords(c.workers[i].socket, stop, 5);
+        closeTileSocket(c.workers[i].socket);
+    }
+    if (listener != TILE_NO_SOCKET) closeTileSocket(listener);
+    if (c.file) ok = fclose(c.file) == 0 && ok;
+    ok = ok && !c.writeFailed;
+    
+    if (ok) {
+        Uint64 end = SDL_GetPerformanceCounter();
+        printf("\nTiles: %dx%d frame written to %s in %.1f s, %.1f s of it with workers rendering\n", width,
+               height, path, (end - start) / (double)frequency, (end - renderStart) / (double)frequency);
+        // How well the preview predicted the measured tile times
+        double n = c.count, sc = 0.0, ss = 0.0, scc = 0.0, sss = 0.0, scs = 0.0;
+        for (int i = 0; i < c.count; i++) {
+            double cost = c.tiles[i].cost, seconds = c.tiles[i].seconds;
+            sc += cost;
+            ss += seconds;
+            scc += cost * cost;
+            sss += seconds * seconds;
+            scs += cost * seconds;
+        }
+        double spread = sqrt((n * scc - sc * sc) * (n * sss - ss * ss));
+        for (int i = 0; i < c.workerCount; i++) {
+            const TileWorker* worker = &c.workers[i];
+            if (worker->rendered == 0) continue;
+            printf("  worker %d: %d tiles, %d stolen, %.0f%% of the estimated cost, %.1f s rendering\n", i,
+                   worker->rendered, worker->stolen, 100.0 * worker->estimated / c.prefix[c.count],
+                   worker->seconds);
+        }
+        printf("  estimated cost against tile time: r = %.2f\n", spread > 0.0 ? (n * scs - sc * ss) / spread : 0.0);
+    } else if (c.file) {
+        fprintf(stderr, "\nFailed to write the tiled frame to %s\n", path);
+    }
+    free(c.tiles);
+    free(c.prefix);
+    free(c.retry);
+    free(c.pixels);
+    return ok;
+}
+
+// Connects to the coordinator at address and renders the tiles it asks
+// for with the fractal program, which must be bound with its uniforms
+// set, until it has none left
+static bool runTileWorker(const char* address, const char* settings, const FractalUniforms* uniforms) {
+    TileSocket s = tileConnect(address);
+    if (s == TILE_NO_SOCKET) return false;
+    // One byte more for a terminator, so sscanf stops inside the header
+    char header[TILE_HEADER_SIZE + 1], expected[TILE_HEADER_SIZE];
+    int width = 0, height = 0, tileSize = 0;
+    bool ok = tileReceive(s, header, TILE_HEADER_SIZE);
+    header[TILE_HEADER_SIZE] = '\0';
+    ok = ok && sscanf(header, "SIERTILE 1 size=%dx%d tile=%d", &width, &height, &tileSize) == 3 && width > 0 &&
+         height > 0 && tileSize > 0 && tileSize <= 1024;
+    if (!ok) {
+        fprintf(stderr, "No tile job from %s\n", address);
+    } else {
+        tileHeader(expected, width, height, tileSize, settings);
+        ok = memcmp(header, expected, TILE_HEADER_SIZE) == 0;
+        if (!ok) {
+            fprintf(stderr, "The coordinator renders with other settings:\n%.*s\nthis worker has:\n%.*s\n",
+                    TILE_HEADER_SIZE - 1, header, TILE_HEADER_SIZE - 1, expected);
+        }
+    }
+    
+    GLuint fbo = 0;
+    GLuint texture = 0;
+    unsigned char* pixels = NULL;
+    if (ok) {
+        texture = createTargetTexture(GL_RGBA8, tileSize, tileSize);
+        glGenFramebuffers(1, &fbo);
+        pixels = (unsigned char*)malloc((size_t)tileSize * tileSize * 3);
+        ok = pixels && attachColorTarget(fbo, texture, "Tile");
+    }
+    if (ok) {
+        printf("Tile worker: %dx%d tiles of a %dx%d frame for %s\n", tileSize, tileSize, width, height, address);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glUniform2f(uniforms->resolution, (float)width, (float)height);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    }
+    
+    Uint64 frequency = SDL_GetPerformanceFrequency();
+    Uint64 start = SDL_GetPerformanceCounter();
+    int rendered = 0;
+    double busy = 0.0;
+    while (ok) {
+        uint32_t request[5];
+        if (!tileReceiveWords(s, request, 5)) {
+            fprintf(stderr, "\nLost the tile coordinator\n");
+            ok = false;
+            break;
+        }
+        if (request[0] == TILE_STOP) break;
+        int tileWidth = (int)request[3];
+        int tileHeight = (int)request[4];
+        if (tileWidth < 1 || tileWidth > tileSize || tileHeight < 1 || tileHeight > tileSize) {
+            fprintf(stderr, "\nBad tile request\n");
+            ok = false;
+            break;
+        }
+        // The tile's origin shifts gl_FragCoord to frame pixels
+        Uint64 begin = SDL_GetPerformanceCounter();
+        glViewport(0, 0, tileWidth, tileHeight);
+        glUniform2f(uniforms->tileOrigin, (float)request[1], (float)request[2]);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        glReadPixels(0, 0, tileWidth, tileHeight, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+        double seconds = (SDL_GetPerformanceCounter() - begin) / (double)frequency;
+        uint32_t reply[2] = { request[0], (uint32_t)(seconds * 1e6) };
+        ok = tileSendWords(s, reply, 2) && tileSend(s, pixels, (size_t)tileWidth * tileHeight * 3);
+        rendered++;
+        busy += seconds;
+        printf("\rTile worker: %d tiles rendered", rendered);
+        fflush(stdout);
+    }
+    
+    glUniform2f(uniforms->tileOrigin, 0.0f, 0.0f);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteTextures(1, &texture);
+    free(pixels);
+    closeTileSocket(s);
+    if (rendered > 0) {
+        printf("\nTile worker: %d tiles in %.1f s, %.1f s of it rendering\n", rendered,
+               (SDL_GetPerformanceCounter() - start) / (double)frequency, busy);
+    }
+    return ok;
+}
+
+// A file mapped into memory
+typedef struct {
+    unsigned char* data;
+    size_t size;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#else
+    int file;
+#endif
+} MappedFile;
+
+// Maps path: with size 0 an existing file, read-only at its own size,
+// otherwise a new file of size bytes for writing. The mapping must be
+// released with unmapFile whether this succeeds or not.
+static bool mapFile(MappedFile* m, const char* path, size_t size) {
+    memset(m, 0, sizeof(*m));
+    bool writing = size > 0;
+#ifdef _WIN32
+    m->file = CreateFileA(path, writing ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ, FILE_SHARE_READ, NULL,
+                          writing ? CREATE_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (m->file == INVALID_HANDLE_VALUE) {
+        m->file = NULL;
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    fileSize.QuadPart = (LONGLONG)size;
+    if (!writing && !GetFileSizeEx(m->file, &fileSize)) return false;
+    m->size = (size_t)fileSize.QuadPart;
+    if (m->size == 0) return false;
+    m->mapping = CreateFileMappingA(m->file, NULL, writing ? PAGE_READWRITE : PAGE_READONLY,
+                                    (DWORD)(fileSize.QuadPart >> 32), (DWORD)fileSize.QuadPart, NULL);
+    if (m->mapping) {
+        m->data = (unsigned char*)MapViewOfFile(m->mapping, writing ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, m->size);
+    }
+#else
+    m->file = open(path, writing ? O_RDWR | O_CREAT | O_TRUNC : O_RDONLY, 0644);
+    if (m->file < 0) return false;
+    struct stat info;
+    if (writing) {
+        if (ftruncate(m->file, (off_t)size) != 0) return false;
+        m->size = size;
+    } else {
+        if (fstat(m->file, &info) != 0) return false;
+        m->size = (size_t)info.st_size;
+    }
+    if (m->size == 0) return false;
+    void* data = mmap(NULL, m->size, writing ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, m->file, 0);
+    m->data = data == MAP_FAILED ? NULL : (unsigned char*)data;
+#endif
+    return m->data != NULL;
+}
+
+// Waits until the mapped pages and the file are on disk
+static bool flushMappedFile(MappedFile* m) {
+#ifdef _WIN32
+    return FlushViewOfFile(m->data, m->size) && FlushFileBuffers(m->file);
+#else
+    return msync(m->data, m->size, MS_SYNC) == 0 && fsync(m->file) == 0;
+#endif
+}
+
+static void unmapFile(MappedFile* m) {
+#ifdef _WIN32
+    if (m->data) UnmapViewOfFile(m->data);
+    if (m->mapping) CloseHandle(m->mapping);
+    if (m->file) CloseHandle(m->file);
+#else
+    if (m->data) munmap(m->data, m->size);
+    if (m->file > 0) close(m->file);
+#endif
+    memset(m, 0, sizeof(*m));
+}
+
+// Progressive accumulation: each pass adds one jittered frame of linear
+// color into a float target by additive blending, its alpha counting the
+// passes of every pixel, and the average is color graded once on output,
+// as the shader grades the average of its own samples. The jitter of pass n is the R4 sequence at n over the
+// fixed blue-noise tile, so the pass count is all the random state there
+// is. A checkpoint is a text header with the render parameters and the
+// pass count, then the target's RGBA sums as floats in host byte order.
+// It is written through a mapping under a temporary name and renamed
+// over the last one once on disk, so a crash leaves one or the other.
+#define CHECKPOINT_HEADER_SIZE 512
+#define ACCUMULATION_STRIP 64
+
+// Everything up to the pass count must match to resume a checkpoint;
+// returns the length of that part. The header is not NUL-terminated.
+static size_t checkpointHeader(char* header, int width, int height, const char* settings, const float* camPos,
+                               const float* rotation, int passes) {
+    memset(header, ' ', CHECKPOINT_HEADER_SIZE);
+    int fixed = snprintf(header, CHECKPOINT_HEADER_SIZE,
+                         "SIERACCU 2 size=%dx%d %s\ncamera=%.5f,%.5f,%.5f\n"
+                         "rotation=%.5f,%.5f,%.5f,%.5f,%.5f,%.5f,%.5f,%.5f,%.5f\n",
+                         width, height, settings, camPos[0], camPos[1], camPos[2], rotation[0], rotation[1],
+                         rotation[2], rotation[3], rotation[4], rotation[5], rotation[6], rotation[7], rotation[8]);
+    fixed = fixed < CHECKPOINT_HEADER_SIZE ? fixed : CHECKPOINT_HEADER_SIZE - 1;
+    int length = fixed + snprintf(header + fixed, CHECKPOINT_HEADER_SIZE - fixed, "passes=%d\n", passes);
+    header[length < CHECKPOINT_HEADER_SIZE ? length : CHECKPOINT_HEADER_SIZE - 1] = ' ';
+    header[CHECKPOINT_HEADER_SIZE - 1] = '\n';
+    return (size_t)fixed;
+}
+
+// Adds pass number `pass` with the fractal program, which must be bound
+// with its uniforms set, in tiles like an animation frame
+static void renderAccumulationPass(GLuint fbo, int width, int height, int pass, const FractalUniforms* uniforms) {
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glUniform2f(uniforms->resolution, (float)width, (float)height);
+    glUniform1i(uniforms->jitter, 1);
+    glUniform1i(uniforms->hdr, 1);
+    glUniform4f(uniforms->noiseOffset, (float)fmod(pass * 0.85667488, 1.0), (float)fmod(pass * 0.73389453, 1.0),
+                (float)fmod(pass * 0.62870167, 1.0), (float)fmod(pass * 0.53859339, 1.0));
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+    for (int y = 0; y < height; y += ANIMATION_TILE) {
+        for (int x = 0; x < width; x += ANIMATION_TILE) {
+            glViewport(x, y, width - x < ANIMATION_TILE ? width - x : ANIMATION_TILE,
+                       height - y < ANIMATION_TILE ? height - y : ANIMATION_TILE);
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            glFlush();
+        }
+    }
+    glDisable(GL_BLEND);
+    glUniform1i(uniforms->hdr, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+// colorGradeSource on the CPU
+static void colorGrade(float* color) {
+    float brightness = 0.2126f * color[0] + 0.7152f * color[1] + 0.0722f * color[2];
+    for (int c = 0; c < 3; c++) {
+        if (brightness > 0.8f) color[c] += (color[c] - 0.8f) * 0.3f;
+        color[c] = powf(color[c] > 0.0f ? color[c] : 0.0f, 0.9f);
+    }
+    float luma = 0.299f * color[0] + 0.587f * color[1] + 0.114f * color[2];
+    for (int c = 0; c < 3; c++) {
+        color[c] = luma + (color[c] - luma) * 1.1f;
+        color[c] = powf(color[c] > 0.0f ? color[c] : 0.0f, 0.4545f);
+    }
+}
+
+// Reads the target straight into a new checkpoint file's mapping
+static bool writeCheckpoint(const char* path, const char* header, GLuint fbo, int width, int height) {
+    char temporary[1024];
+    snprintf(temporary, sizeof(temporary), "%s.part", path);
+    MappedFile m;
+    bool ok = mapFile(&m, temporary, CHECKPOINT_HEADER_SIZE + (size_t)width * height * 4 * sizeof(float));
+    if (ok) {
+        memcpy(m.data, header, CHECKPOINT_HEADER_SIZE);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_FLOAT, m.data + CHECKPOINT_HEADER_SIZE);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        ok = flushMappedFile(&m);
+    }
+    unmapFile(&m);
+    ok = ok && replaceFile(temporary, path);
+    if (!ok) {
+        fprintf(stderr, "\nFailed to write the checkpoint %s\n", path);
+        remove(temporary);
+    }
+    return ok;
+}
+
+// Loads the checkpoint at path into the accumulation target if its
+// header starts with the fixed bytes of header, as checkpointHeader
+// returns them; returns its pass count, 0 without a checkpoint, or -1 if
+// it cannot be resumed
+static int resumeCheckpoint(const char* path, const char* header, size_t fixed, GLuint texture, int width,
+                            int height) {
+    FILE* existing = fopen(path, "rb");
+    if (!existing) return 0;
+    fclose(existing);
+    int passes = -1;
+    MappedFile m;
+    bool mapped = mapFile(&m, path, 0);
+    // The saved header is parsed from a terminated copy, never the mapping
+    char saved[CHECKPOINT_HEADER_SIZE + 1] = "";
+    if (mapped && m.size >= CHECKPOINT_HEADER_SIZE) memcpy(saved, m.data, CHECKPOINT_HEADER_SIZE);
+    if (!mapped) {
+        fprintf(stderr, "Could not map the checkpoint %s\n", path);
+    } else if (m.size != CHECKPOINT_HEADER_SIZE + (size_t)width * height * 4 * sizeof(float) ||
+               memcmp(saved, header, fixed) != 0 || sscanf(saved + fixed, "passes=%d", &passes) != 1) {
+        fprintf(stderr, "%s was made for other render parameters:\n%.*s\n", path, (int)fixed, saved);
+        passes = -1;
+    } else {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_FLOAT, m.data + CHECKPOINT_HEADER_SIZE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+    unmapFile(&m);
+    return passes;
+}
+
+// Writes the color-graded average of the passes as a PPM, reading the
+// target back in strips of rows from the top
+static bool writeAccumulation(const char* path, GLuint fbo, int width, int height) {
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "\nCould not open %s for writing\n", path);
+        return false;
+    }
+    float* strip = (float*)malloc((size_t)width * ACCUMULATION_STRIP * 4 * sizeof(float));
+    unsigned char* row = (unsigned char*)malloc((size_t)width * 3);
+    bool ok = strip && row && fprintf(file, "P6\n%d %d\n255\n", width, height) > 0;
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    for (int top = height; ok && top > 0; top -= ACCUMULATION_STRIP) {
+        int rows = top < ACCUMULATION_STRIP ? top : ACCUMULATION_STRIP;
+        glReadPixels(0, top - rows, width, rows, GL_RGBA, GL_FLOAT, strip);
+        for (int y = rows - 1; ok && y >= 0; y--) {
+            const float* sum = strip + (size_t)y * width * 4;
+            for (int x = 0; x < width; x++) {
+                float passes = sum[x * 4 + 3] > 0.0f ? sum[x * 4 + 3] : 1.0f;
+                float color[3] = { sum[x * 4 + 0] / passes, sum[x * 4 + 1] / passes, sum[x * 4 + 2] / passes };
+                colorGrade(color);
+                for (int c = 0; c < 3; c++) {
+                    float value = color[c];
+                    row[x * 3 + c] = (unsigned char)(value <= 0.0f ? 0 : value >= 1.0f ? 255 : value * 255.0f + 0.5f);
+                }
+            }
+            ok = fwrite(row, 1, (size_t)width * 3, file) == (size_t)width * 3;
+        }
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    free(strip);
+    free(row);
+    ok = fclose(file) == 0 && ok;
+    if (!ok) fprintf(stderr, "\nFailed to write %s\n", path);
+    return ok;
+}
+
+// Linear frame at render size for the tone-mapping pass, with the guide
+// for capture. Time-sliced and checkerboard frames are tone mapped from
+// their own targets unless post-processing comes after them.
+typedef struct {
+    GLuint fbo;
+    GLuint colorTex;
+    GLuint guideTex;
+    int width;
+    int height;
+} HdrTarget;
+
+bool createHdrTarget(HdrTarget* target, int width, int height) {
+    target->width = width;
+    target->height = height;
+    target->colorTex = createTargetTexture(SCENE_COLOR_FORMAT, width, height);
+    target->guideTex = createTargetTexture(GL_RGBA16F, width, height);
+    glGenFramebuffers(1, &target->fbo);
+    return attachColorTargets(target->fbo, target->colorTex, target->guideTex, "HDR frame");
+}
+
+void destroyHdrTarget(HdrTarget* target) {
+    glDeleteFramebuffers(1, &target->fbo);
+    glDeleteTextures(1, &target->colorTex);
+    glDeleteTextures(1, &target->guideTex);
+    memset(target, 0, sizeof(*target));
+}
+
+// Per-sample shading renders linear color into a multisampled target.
+// Its resolve into the HDR target averages the samples in linear color,
+// and the tone-map pass grades the average, as the manual grid grades
+// the average of its samples.
+#define MSAA_SAMPLES 4
+
+typedef struct {
+    GLuint fbo;
+    GLuint colorRb;
+    int width;
+    int height;
+} MsaaTarget;
+
+bool createMsaaTarget(MsaaTarget* target, int width, int height) {
+    target->width = width;
+    target->height = height;
+    glGenRenderbuffers(1, &target->colorRb);
+    glBindRenderbuffer(GL_RENDERBUFFER, target->colorRb);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, MSAA_SAMPLES, SCENE_COLOR_FORMAT, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    glGenFramebuffers(1, &target->fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, target->fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, target->colorRb);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "MSAA framebuffer incomplete (0x%x)\n", status);
+        return false;
+    }
+    return true;
+}
+
+void destroyMsaaTarget(MsaaTarget* target) {
+    glDeleteFramebuffers(1, &target->fbo);
+    glDeleteRenderbuffers(1, &target->colorRb);
+    memset(target, 0, sizeof(*target));
+}
+
+// Resolves the samples into the color of the HDR target; its guide is
+// left alone
+void resolveMsaaTarget(const MsaaTarget* target, const HdrTarget* hdrTarget) {
+    static const GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, target->fbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, hdrTarget->fbo);
+    glDrawBuffer(GL_COLOR_ATTACHMENT0);
+    glBlitFramebuffer(0, 0, target->width, target->height, 0, 0, target->width, target->height,
+                      GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glDrawBuffers(2, drawBuffers);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+typedef enum {
+    TONE_CURVE_CLASSIC,     // the fractal shader's own grade
+    TONE_CURVE_ACES,
+    TONE_CURVE_FILMIC,
+    TONE_CURVE_COUNT
+} ToneCurve;
+
+static const char* const toneCurveNames[TONE_CURVE_COUNT] = { "classic", "aces", "filmic" };
+
+typedef struct {
+    GLuint program;
+    GLint source;
+    GLint exposure;
+    GLint curve;
+} ToneMapPass;
+
+GLuint createToneMapProgram(void) {
+    const char* fragSrcs[] = { "#version 330 core\n", colorGradeSource, toneMapFragmentShaderSource };
+    return createShaderProgram(vertexShaderSource, fragSrcs, 3);
+}
+
+// Tone maps source into the bound framebuffer; the quad must be bound
+void drawToneMap(const ToneMapPass* pass, GLuint source, float exposure, int curve) {
+    glUseProgram(pass->program);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, source);
+    glUniform1i(pass->source, 0);
+    glUniform1f(pass->exposure, exposure);
+    glUniform1i(pass->curve, curve);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+}
+
+// HDR frame capture. Frames are read into a ring of pixel buffers and
+// written out once their fence has passed, a frame or two later, so the
+// readback does not stall rendering. Each file gets the capture number
+// before its extension (shot.exr becomes shot_00000.exr); .exr files
+// hold half floats, .pfm files 32-bit floats. With the guide, PFM frames
+// come with the first-hit distance (_depth.pfm, negative for the sky)
+// and orbit trap (_trap.pfm) that denoise.c filters them by.
+#define HDR_CAPTURE_SLOTS 3
+
+typedef struct {
+    GLuint pbo[HDR_CAPTURE_SLOTS];
+    GLuint guidePbo[HDR_CAPTURE_SLOTS];
+    GLsync fence[HDR_CAPTURE_SLOTS];
+    int width[HDR_CAPTURE_SLOTS];
+    int height[HDR_CAPTURE_SLOTS];
+    bool hasGuide[HDR_CAPTURE_SLOTS];
+    const char* path;       // NULL: no capture
+    bool exr;
+    bool guide;
+    int issued;             // frames read back; frame n uses slot n % HDR_CAPTURE_SLOTS
+    int written;            // frames written out or failed
+    bool failed;
+} HdrCapture;
+
+// Appends one EXR attribute to the header in out
+static size_t exrAttribute(unsigned char* out, size_t at, const char* name, const char* type, const void* value,
+                           int32_t size) {
+    size_t nameSize = strlen(name) + 1;
+    size_t typeSize = strlen(type) + 1;
+    memcpy(out + at, name, nameSize);
+    memcpy(out + at + nameSize, type, typeSize);
+    at += nameSize + typeSize;
+    memcpy(out + at, &size, 4);
+    memcpy(out + at + 4, value, size);
+    return at + 4 + size;
+}
+
+// Writes bottom-up rows of RGBA half floats as an uncompressed
+// single-part scanline OpenEXR file with B, G and R channels (EXR keeps
+// channels in name order and rows top-down)
+static bool writeExr(const char* path, const uint16_t* pixels, int width, int height) {
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "Could not open %s for writing\n", path);
+        return false;
+    }
+    
+    unsigned char header[512];
+    static const unsigned char magic[8] = { 0x76, 0x2f, 0x31, 0x01, 2, 0, 0, 0 };
+    memcpy(header, magic, 8);
+    size_t size = 8;
+    // chlist: name, pixel type 1 (half), pLinear and padding, x and y sampling
+    unsigned char channels[3 * 18 + 1] = {0};
+    for (int c = 0; c < 3; c++) {
+        static const int32_t layout[4] = { 1, 0, 1, 1 };
+        channels[c * 18] = "BGR"[c];
+        memcpy(channels + c * 18 + 2, layout, sizeof(layout));
+    }
+    int32_t window[4] = { 0, 0, width - 1, height - 1 };
+    unsigned char none = 0;
+    float one = 1.0f;
+    float center[2] = { 0.0f, 0.0f };
+    size = exrAttribute(header, size, "channels", "chlist", channels, sizeof(channels));
+    size = exrAttribute(header, size, "compression", "compression", &none, 1);
+    size = exrAttribute(header, size, "dataWindow", "box2i", window, sizeof(window));
+    size = exrAttribute(header, size, "displayWindow", "box2i", window, sizeof(window));
+    size = exrAttribute(header, size, "lineOrder", "lineOrder", &none, 1);
+    size = exrAttribute(header, size, "pixelAspectRatio", "float", &one, 4);
+    size = exrAttribute(header, size, "screenWindowCenter", "v2f", center, sizeof(center));
+    size = exrAttribute(header, size, "screenWindowWidth", "float", &one, 4);
+    header[size++] = 0;
+    
+    // Offset table, then one chunk per row: y, byte count and the planes
+    int32_t lineBytes = width * 3 * 2;
+    bool ok = fwrite(header, 1, size, file) == size;
+    for (int y = 0; ok && y < height; y++) {
+        uint64_t offset = size + 8 * (uint64_t)height + (uint64_t)y * (8 + lineBytes);
+        ok = fwrite(&offset, 8, 1, file) == 1;
+    }
+    uint16_t* line = (uint16_t*)malloc((size_t)width * 3 * sizeof(uint16_t));
+    ok = ok && line;
+    for (int y = 0; ok && y < height; y++) {
+        const uint16_t* src = pixels + (size_t)(height - 1 - y) * width * 4;
+        for (int x = 0; x < width; x++) {
+            line[x] = src[x * 4 + 2];
+            line[width + x] = src[x * 4 + 1];
+            line[2 * width + x] = src[x * 4];
+        }
+        int32_t chunk[2] = { y, lineBytes };
+        ok = fwrite(chunk, 4, 2, file) == 2 && fwrite(line, 1, lineBytes, file) == (size_t)lineBytes;
+    }
+    free(line);
+    ok = fclose(file) == 0 && ok;
+    if (!ok) {
+        fprintf(stderr, "Failed to write %s\n", path);
+    }
+    return ok;
+}
+
+// Writes channels [first, first + count) of bottom-up rows of floats with
+// stride channels per pixel as a little-endian PFM, which keeps the rows
+// in that order; count is 3 (color) or 1 (greyscale)
+static bool writePfm(const char* path, const float* pixels, int stride, int first, int count, int width,
+                     int height) {
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "Could not open %s for writing\n", path);
+        return false;
+    }
+    bool ok = fprintf(file, "P%c\n%d %d\n-1.0\n", count == 3 ? 'F' : 'f', width, height) > 0;
+    float* row = (float*)malloc((size_t)width * count * sizeof(float));
+    ok = ok && row;
+    for (int y = 0; ok && y < height; y++) {
+        const float* src = pixels + (size_t)y * width * stride + first;
+        for (int x = 0; x < width; x++) {
+            for (int c = 0; c < count; c++) {
+                row[x * count + c] = src[x * stride + c];
+            }
+        }
+        ok = fwrite(row, sizeof(float), (size_t)width * count, file) == (size_t)width * count;
+    }
+    free(row);
+    ok = fclose(file) == 0 && ok;
+    if (!ok) {
+        fprintf(stderr, "Failed to write %s\n", path);
+    }
+    return ok;
+}
+
+static bool hdrCaptureFormat(const char* path, bool* exr) {
+    const char* dot = strrchr(path, '.');
+    if (dot && (strcmp(dot, ".exr") == 0 || strcmp(dot, ".pfm") == 0)) {
+        *exr = strcmp(dot, ".exr") == 0;
+        return true;
+    }
+    return false;
+}
+
+void initHdrCapture(HdrCapture* capture, const char* path, bool guide) {
+    memset(capture, 0, sizeof(*capture));
+    capture->path = path;
+    if (path) {
+        hdrCaptureFormat(path, &capture->exr);
+        capture->guide = guide && !capture->exr;
+        glGenBuffers(HDR_CAPTURE_SLOTS, capture->pbo);
+        glGenBuffers(HDR_CAPTURE_SLOTS, capture->guidePbo);
+    }
+}
+
+// Maps the oldest pending frame, waiting for it if need be, and writes it
+static void hdrCaptureWriteOldest(HdrCapture* capture) {
+    int slot = capture->written % HDR_CAPTURE_SLOTS;
+    glClientWaitSync(capture->fence[slot], GL_SYNC_FLUSH_COMMANDS_BIT, (GLuint64)10 * 1000 * 1000 * 1000);
+    glDeleteSync(capture->fence[slot]);
+    capture->fence[slot] = 0;
+    
+    int width = capture->width[slot];
+    int height = capture->height[slot];
+    size_t bytes = (size_t)width * height * (capture->exr ? 4 * 2 : 3 * 4);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, capture->pbo[slot]);
+    const void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT);
+    char path[1024];
+    const char* dot = strrchr(capture->path, '.');
+    snprintf(path, sizeof(path), "%.*s_%05d%s", (int)(dot - capture->path), capture->path, capture->written, dot);
+    bool ok = pixels && (capture->exr ? writeExr(path, (const uint16_t*)pixels, width, height)
+                                      : writePfm(path, (const float*)pixels, 3, 0, 3, width, height));
+    if (pixels) {
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    
+    // The guide as RGBA floats: orbit trap, then first-hit distance
+    if (ok && capture->hasGuide[slot]) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, capture->guidePbo[slot]);
+        const float* guide = (const float*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (size_t)width * height * 16,
+                                                            GL_MAP_READ_BIT);
+        char guidePath[1024];
+        snprintf(guidePath, sizeof(guidePath), "%.*s_%05d_depth%s", (int)(dot - capture->path), capture->path,
+                 capture->written, dot);
+        ok = guide && writePfm(guidePath, guide, 4, 3, 1, width, height);
+        snprintf(guidePath, sizeof(guidePath), "%.*s_%05d_trap%s", (int)(dot - capture->path), capture->path,
+                 capture->written, dot);
+        ok = ok && writePfm(guidePath, guide, 4, 0, 3, width, height);
+        if (guide) {
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    if (ok) {
+        printf("\nHDR frame written to %s%s\n", path,
+               capture->guide && !capture->hasGuide[slot] ? " (no guide in this rendering mode)" : "");
+    } else {
+        capture->failed = true;
+    }
+    capture->written++;
+}
+
+// Writes the pending frames the GPU has finished, or all of them
+void hdrCapturePoll(HdrCapture* capture, bool wait) {
+    while (capture->written < capture->issued) {
+        GLsync fence = capture->fence[capture->written % HDR_CAPTURE_SLOTS];
+        if (!wait && glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+            break;
+        }
+        hdrCaptureWriteOldest(capture);
+    }
+}
+
+// Starts reading back attachment 0 of fbo, and the guide at attachment 1
+// of guideFbo unless that is 0
+void hdrCaptureFrame(HdrCapture* capture, GLuint fbo, GLuint guideFbo, int width, int height) {
+    if (capture->issued - capture->written == HDR_CAPTURE_SLOTS) {
+        hdrCaptureWriteOldest(capture);
+    }
+    int slot = capture->issued % HDR_CAPTURE_SLOTS;
+    capture->width[slot] = width;
+    capture->height[slot] = height;
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, capture->pbo[slot]);
+    glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)width * height * (capture->exr ? 4 * 2 : 3 * 4), NULL,
+                 GL_STREAM_READ);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, width, height, capture->exr ? GL_RGBA : GL_RGB, capture->exr ? GL_HALF_FLOAT : GL_FLOAT,
+                 (void*)0);
+    capture->hasGuide[slot] = capture->guide && guideFbo;
+    if (capture->hasGuide[slot]) {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, guideFbo);
+        glReadBuffer(GL_COLOR_ATTACHMENT1);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, capture->guidePbo[slot]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)width * height * 16, NULL, GL_STREAM_READ);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_FLOAT, (void*)0);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    capture->fence[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    capture->issued++;
+}
+
+void destroyHdrCapture(HdrCapture* capture) {
+    if (capture->path) {
+        hdrCapturePoll(capture, true);
+        glDeleteBuffers(HDR_CAPTURE_SLOTS, capture->pbo);
+        glDeleteBuffers(HDR_CAPTURE_SLOTS, capture->guidePbo);
+    }
+}
+
+// Live frame export through the shared ring of frame_share.h. Each shown
+// frame is read back into a ring of pixel buffers, as HDR captures are,
+// and copied from the mapped buffer into its slot by the first poll, at
+// the top of a loop pass, after its fence has passed; the loop keeps
+// polling while idle until every frame is out. Nothing here waits: a
+// frame is dropped when every buffer is
+// still in flight, or when it is larger than the slots.
+#define FRAME_SHARE_PBOS 3
+
+typedef struct {
+    FrameShareMapping mapping;
+    const char* name;       // NULL: no export
+    GLuint pbo[FRAME_SHARE_PBOS];
+    GLsync fence[FRAME_SHARE_PBOS];
+    FrameShareSlot pending[FRAME_SHARE_PBOS];   // description of each readback
+    int issued;             // frames read back; frame n uses buffer n % FRAME_SHARE_PBOS
+    int published;          // frames copied to the ring or given up
+    int dropped;            // frames never read back
+} FrameShare;
+
+bool initFrameShare(FrameShare* share, const char* name, int slots, int maxWidth, int maxHeight) {
+    memset(share, 0, sizeof(*share));
+    if (!name) {
+        return true;
+    }
+    if (frameShareOpen(&share->mapping, name, (uint32_t)slots, (uint32_t)maxWidth, (uint32_t)maxHeight) != 0) {
+        fprintf(stderr, "Could not create the shared frame ring %s\n", name);
+        frameShareClose(&share->mapping, name, 1);
+        return false;
+    }
+    share->name = name;
+    glGenBuffers(FRAME_SHARE_PBOS, share->pbo);
+    printf("Sharing frames as %s: %d slots of up to %dx%d\n", name, slots, maxWidth, maxHeight);
+    return true;
+}
+
+// Starts reading back the window's back buffer, described by the camera
+// and palette it was drawn with
+void frameShareFrame(FrameShare* share, int width, int height, int palette, float time, const float* camPos,
+                     const float* rotation) {
+    FrameShareHeader* header = share->mapping.header;
+    if (share->issued - share->published == FRAME_SHARE_PBOS || (uint32_t)width > header->maxWidth ||
+        (uint32_t)height > header->maxHeight) {
+        share->dropped++;
+        return;
+    }
+    int buffer = share->issued % FRAME_SHARE_PBOS;
+    FrameShareSlot* frame = &share->pending[buffer];
+    frame->width = (uint32_t)width;
+    frame->height = (uint32_t)height;
+    frame->palette = palette;
+    frame->timestamp = (int64_t)((double)SDL_GetPerformanceCounter() / SDL_GetPerformanceFrequency() * 1e6);
+    frame->time = time;
+    memcpy(frame->camPos, camPos, sizeof(frame->camPos));
+    memcpy(frame->rotation, rotation, sizeof(frame->rotation));
+    
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glReadBuffer(GL_BACK);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, share->pbo[buffer]);
+    glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)width * height * 4, NULL, GL_STREAM_READ);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    share->fence[buffer] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    share->issued++;
+}
+
+// Publishes the frames whose readback has finished
+void frameSharePoll(FrameShare* share) {
+    FrameShareHeader* header = share->mapping.header;
+    while (share->published < share->issued) {
+        int buffer = share->published % FRAME_SHARE_PBOS;
+        if (glClientWaitSync(share->fence[buffer], 0, 0) == GL_TIMEOUT_EXPIRED) {
+            break;
+        }
+        glDeleteSync(share->fence[buffer]);
+        share->fence[buffer] = 0;
+        
+        const FrameShareSlot* frame = &share->pending[buffer];
+        size_t bytes = (size_t)frame->width * frame->height * 4;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, share->pbo[buffer]);
+        const void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)bytes, GL_MAP_READ_BIT);
+        if (pixels) {
+            // Frames are numbered as published, so a consumer can tell
+            // from a gap in the numbers that it missed some
+            int number = SDL_AtomicGet(&header->latest);
+            uint32_t index = (uint32_t)number % header->slotCount;
+            FrameShareSlot* slot = &header->slots[index];
+            SDL_AtomicSet(&slot->sequence, 2 * number + 1);
+            SDL_MemoryBarrierRelease();
+            memcpy(frameSharePixels(header, index), pixels, bytes);
+            slot->width = frame->width;
+            slot->height = frame->height;
+            slot->palette = frame->palette;
+            slot->timestamp = frame->timestamp;
+            slot->time = frame->time;
+            memcpy(slot->camPos, frame->camPos, sizeof(slot->camPos));
+            memcpy(slot->rotation, frame->rotation, sizeof(slot->rotation));
+            // The frame must be visible before the sequence says it is complete
+            SDL_MemoryBarrierRelease();
+            SDL_AtomicSet(&slot->sequence, 2 * number + 2);
+            SDL_AtomicSet(&header->latest, number + 1);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        share->published++;
+    }
+}
+
+void destroyFrameShare(FrameShare* share) {
+    if (!share->name) {
+        return;
+    }
+    // The last frames shown still go out
+    glFinish();
+    frameSharePoll(share);
+    for (int i = 0; i < FRAME_SHARE_PBOS; i++) {
+        if (share->fence[i]) glDeleteSync(share->fence[i]);
+    }
+    glDeleteBuffers(FRAME_SHARE_PBOS, share->pbo);
+    printf("\nShared frames: %d published as %s, %d dropped\n", SDL_AtomicGet(&share->mapping.header->latest),
+           share->name, share->dropped);
+    SDL_AtomicSet(&share->mapping.header->open, 0);
+    frameShareClose(&share->mapping, share->name, 1);
+}
+
+// Archive playback: --play shows the frames of a memory-mapped frame
+// archive (frame_archive.h) in place of the renderer. A decoder thread
+// keeps the PLAYBACK_AHEAD frames after the one on screen decoded, and
+// asks the OS to read in the frame after those before it gets there. A
+// frame that is not ready, after a seek, is decoded on the spot, so
+// seeking anywhere costs one frame's decode. Positions count frames
+// from time zero without wrapping, so a loop keeps reading ahead across
+// its end; position p shows frame p % frameCount, and the decoded frame
+// of position p sits in buffer p % PLAYBACK_AHEAD.
+#define PLAYBACK_AHEAD 8
+
+typedef struct {
+    MappedFile file;
+    const FRAHeader* header;    // NULL: no playback
+    uint8_t* ahead[PLAYBACK_AHEAD];
+    int aheadPosition[PLAYBACK_AHEAD];  // position each buffer holds, -1 while empty or being decoded
+    uint8_t* current;           // frame decoded on the spot
+    int shown;                  // position on screen, -1 before the first
+    bool quit;
+    SDL_mutex* lock;
+    SDL_cond* wake;
+    SDL_Thread* thread;
+    GLuint texture;
+    GLuint fbo;
+    int fromAhead;              // frames shown that were decoded ahead
+    int onTheSpot;              // frames shown that had to be decoded first
+} Playback;
+
+// Asks the OS to start reading the stored frame of position
+static void prefetchPlaybackFrame(Playback* playback, int position) {
+#ifdef _WIN32
+    // The decoder thread faulting the pages in is the readahead here
+    (void)playback;
+    (void)position;
+#else
+    const FRAFrameEntry* entry = fraFrameEntry(playback->file.data, (uint32_t)position % playback->header->frameCount);
+    madvise(playback->file.data + entry->offset, entry->size, MADV_WILLNEED);
+#endif
+}
+
+int playbackThread(void* data) {
+    Playback* playback = (Playback*)data;
+    uint32_t frameCount = playback->header->frameCount;
+    int lookahead = frameCount - 1 < PLAYBACK_AHEAD ? (int)frameCount - 1 : PLAYBACK_AHEAD;
+    SDL_LockMutex(playback->lock);
+    while (!playback->quit) {
+        // The nearest position after the screen that is not decoded yet
+        int position = -1;
+        for (int k = 1; k <= lookahead && playback->shown >= 0; k++) {
+            if (playback->aheadPosition[(playback->shown + k) % PLAYBACK_AHEAD] != playback->shown + k) {
+                position = playback->shown + k;
+                break;
+            }
+        }
+        if (position < 0) {
+            SDL_CondWait(playback->wake, playback->lock);
+            continue;
+        }
+        int buffer = position % PLAYBACK_AHEAD;
+        playback->aheadPosition[buffer] = -1;
+        SDL_UnlockMutex(playback->lock);
+        prefetchPlaybackFrame(playback, position + lookahead);
+        const FRAFrameEntry* entry = fraFrameEntry(playback->file.data, (uint32_t)position % frameCount);
+        bool ok = fraDecodeFrame(playback->file.data, entry, playback->ahead[buffer]) != 0;
+        SDL_LockMutex(playback->lock);
+        // A corrupt frame stops the readahead; the screen finds out when
+        // it decodes the frame itself
+        if (!ok) break;
+        playback->aheadPosition[buffer] = position;
+    }
+    SDL_UnlockMutex(playback->lock);
+    return 0;
+}
+
+bool openPlayback(Playback* playback, const char* path) {
+    memset(playback, 0, sizeof(*playback));
+    playback->shown = -1;
+    for (int i = 0; i < PLAYBACK_AHEAD; i++) {
+        playback->aheadPosition[i] = -1;
+    }
+    if (!mapFile(&playback->file, path, 0) || !fraValidHeader(playback->file.data, playback->file.size)) {
+        fprintf(stderr, "%s is not a frame archive\n", path);
+        return false;
+    }
+    const FRAHeader* header = (const FRAHeader*)playback->file.data;
+    size_t frameBytes = (size_t)header->width * header->height * 3;
+#ifndef _WIN32
+    // Access follows the screen, not the file: leave readahead to the hints
+    madvise(playback->file.data, playback->file.size, MADV_RANDOM);
+#endif
+    bool ok = (playback->current = (uint8_t*)malloc(frameBytes)) != NULL;
+    for (int i = 0; ok && i < PLAYBACK_AHEAD; i++) {
+        ok = (playback->ahead[i] = (uint8_t*)malloc(frameBytes)) != NULL;
+    }
+    if (!ok) {
+        fprintf(stderr, "Out of memory for %ux%u playback\n", header->width, header->height);
+        return false;
+    }
+    playback->texture = createTargetTexture(GL_RGB8, (int)header->width, (int)header->height);
+    glGenFramebuffers(1, &playback->fbo);
+    if (!attachColorTarget(playback->fbo, playback->texture, "Playback")) {
+        return false;
+    }
+    playback->header = header;
+    playback->lock = SDL_CreateMutex();
+    playback->wake = SDL_CreateCond();
+    if (playback->lock && playback->wake) {
+        playback->thread = SDL_CreateThread(playbackThread, "playback", playback);
+    }
+    
+    uint64_t stored = playback->file.size;
+    double length = header->frameCount / header->fps;
+    printf("Playback: %s, %u frames of %ux%u at %.3f fps (%.1f s), %.1f MiB (%.2f:1)%s\n", path,
+           header->frameCount, header->width, header->height, header->fps, length, stored / (1024.0 * 1024.0),
+           (double)frameBytes * header->frameCount / stored, playback->thread ? "" : ", no readahead");
+    return true;
+}
+
+// Shows the frame of the given time letterboxed in the window. Returns
+// false if the frame is corrupt.
+bool showPlaybackFrame(Playback* playback, double time, int windowWidth, int windowHeight) {
+    const FRAHeader* header = playback->header;
+    int width = (int)header->width;
+    int height = (int)header->height;
+    int position = (int)floor(time * header->fps);
+    if (position != playback->shown) {
+        uint32_t frame = fraFrameAt(header, time);
+        const uint8_t* pixels = NULL;
+        SDL_LockMutex(playback->lock);
+        int buffer = position % PLAYBACK_AHEAD;
+        bool ready = playback->thread && playback->aheadPosition[buffer] == position;
+        glBindTexture(GL_TEXTURE_2D, playback->texture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        if (ready) {
+            // The decoder leaves a buffer alone while it holds the shown position
+            pixels = playback->ahead[buffer];
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+            playback->fromAhead++;
+        }
+        playback->shown = position;
+        SDL_CondSignal(playback->wake);
+        SDL_UnlockMutex(playback->lock);
+        if (!ready) {
+            if (!fraDecodeFrame(playback->file.data, fraFrameEntry(playback->file.data, frame), playback->current)) {
+                fprintf(stderr, "\nFrame %u of the archive is corrupt\n", frame);
+                glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+                glBindTexture(GL_TEXTURE_2D, 0);
+                return false;
+            }
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, playback->current);
+            playback->onTheSpot++;
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+    
+    // Largest rectangle of the frame's aspect that fits the window
+    int drawWidth = windowWidth;
+    int drawHeight = (int)((long long)windowWidth * height / width);
+    if (drawHeight > windowHeight) {
+        drawHeight = windowHeight;
+        drawWidth = (int)((long long)windowHeight * width / height);
+    }
+    int x = (windowWidth - drawWidth) / 2;
+    int y = (windowHeight - drawHeight) / 2;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, playback->fbo);
+    glBlitFramebuffer(0, 0, width, height, x, y, x + drawWidth, y + drawHeight, GL_COLOR_BUFFER_BIT,
+                      drawWidth == width && drawHeight == height ? GL_NEAREST : GL_LINEAR);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return true;
+}
+
+void closePlayback(Playback* playback) {
+    if (playback->thread) {
+        SDL_LockMutex(playback->lock);
+        playback->quit = true;
+        SDL_CondSignal(playback->wake);
+        SDL_UnlockMutex(playback->lock);
+        SDL_WaitThread(playback->thread, NULL);
+    }
+    if (playback->header) {
+        printf("\nPlayback: %d frames shown, %d decoded ahead, %d on the spot\n",
+               playback->fromAhead + playback->onTheSpot, playback->fromAhead, playback->onTheSpot);
+    }
+    if (playback->wake) SDL_DestroyCond(playback->wake);
+    if (playback->lock) SDL_DestroyMutex(playback->lock);
+    if (playback->fbo) glDeleteFramebuffers(1, &playback->fbo);
+    if (playback->texture) glDeleteTextures(1, &playback->texture);
+    for (int i = 0; i < PLAYBACK_AHEAD; i++) {
+        free(playback->ahead[i]);
+    }
+    free(playback->current);
+    unmapFile(&playback->file);
+    memset(playback, 0, sizeof(*playback));
+}
+
+// GPU time per render pass from timer queries. Results are read when a
+// query slot comes around again, PASS_TIMER_LATENCY frames later, by
+// which time the GPU has finished with it and the read does not stall.
+#define PASS_TIMER_LATENCY 3
+
+typedef enum {
+    PASS_SCENE,     // hull pre-pass and fractal; a copy to the window counts
+                    // toward the pass before it
+    PASS_RECONSTRUCT,
+    PASS_RATE_HALF,
+    PASS_RATE_QUARTER,
+    PASS_RATE_PROBE,    // the outer rings at full rate, now and then
+    PASS_COMPOSITE,
+    PASS_RIGHT_EYE,     // reprojection, re-marched holes and the side-by-side copy
+    PASS_DENOISE,       // features and every wavelet level
+    PASS_DOF,
+    PASS_MOTION_BLUR,   // velocity and blur
+    PASS_TONEMAP,       // and the HDR readback
+    PASS_UPSCALE,
+    PASS_SHARPEN,
+    PASS_COUNT
+} RenderPass;
+
+static const char* const renderPassNames[PASS_COUNT] = {
+    "scene", "reconstruct", "1/2 rate", "1/4 rate", "1x probe", "composite", "right eye", "denoise", "DOF",
+    "motion blur", "tone map", "upscale", "sharpen"
+};
+
+typedef struct {
+    GLuint queries[PASS_TIMER_LATENCY][PASS_COUNT];
+    bool issued[PASS_TIMER_LATENCY][PASS_COUNT];
+    unsigned int frame;
+    int active;             // pass whose query is open, -1 for none
+    double totalMs[PASS_COUNT];
+    int samples[PASS_COUNT];
+} PassTimer;
+
+void initPassTimer(PassTimer* timer) {
+    memset(timer, 0, sizeof(*timer));
+    timer->active = -1;
+    glGenQueries(PASS_TIMER_LATENCY * PASS_COUNT, &timer->queries[0][0]);
+}
+
+// Collects the results of the slot about to be reused. The first frame
+// also pays for the driver finishing the shaders (and some drivers
+// report a bogus time for their very first query), so it is left out.
+void passTimerBeginFrame(PassTimer* timer) {
+    int slot = timer->frame % PASS_TIMER_LATENCY;
+    for (int pass = 0; pass < PASS_COUNT; pass++) {
+        if (timer->issued[slot][pass]) {
+            GLuint64 ns = 0;
+            glGetQueryObjectui64v(timer->queries[slot][pass], GL_QUERY_RESULT, &ns);
+            if (timer->frame != PASS_TIMER_LATENCY) {
+                timer->totalMs[pass] += ns / 1e6;
+                timer->samples[pass]++;
+            }
+            timer->issued[slot][pass] = false;
+        }
+    }
+}
+
+void passTimerBegin(PassTimer* timer, RenderPass pass) {
+    int slot = timer->frame % PASS_TIMER_LATENCY;
+    glBeginQuery(GL_TIME_ELAPSED, timer->queries[slot][pass]);
+    timer->issued[slot][pass] = true;
+    timer->active = pass;
+}
+
+void passTimerEnd(PassTimer* timer) {
+    if (timer->active < 0) return;
+    glEndQuery(GL_TIME_ELAPSED);
+    timer->active = -1;
+}
+
+void passTimerEndFrame(PassTimer* timer) {
+    // Wrap to a later frame in the same slot, past the skipped first one
+    timer->frame++;
+    if (timer->frame == PASS_TIMER_LATENCY * 1000) {
+        timer->frame = PASS_TIMER_LATENCY * 2;
+    }
+}
+
+// Mean time of a pass since the last report, 0 if it did not run
+double passTimerMean(const PassTimer* timer, RenderPass pass) {
+    return timer->samples[pass] > 0 ? timer->totalMs[pass] / timer->samples[pass] : 0.0;
+}
+
+// Writes the mean time of each pass since the last call and resets them
+void passTimerReport(PassTimer* timer, char* text, size_t size) {
+    size_t used = 0;
+    text[0] = '\0';
+    for (int pass = 0; pass < PASS_COUNT && used < size; pass++) {
+        if (timer->samples[pass] > 0) {
+            int n = snprintf(text + used, size - used, "%s%s %.1f ms", used ? ", " : " | GPU ",
+                             renderPassNames[pass], timer->totalMs[pass] / timer->samples[pass]);
+            used += n > 0 ? (size_t)n : 0;
+        }
+        timer->totalMs[pass] = 0.0;
+        timer->samples[pass] = 0;
+    }
+}
+
+void destroyPassTimer(PassTimer* timer) {
+    glDeleteQueries(PASS_TIMER_LATENCY * PASS_COUNT, &timer->queries[0][0]);
+}
+
+// Upscaler and sharpening programs for render scaling
+typedef struct {
+    GLuint upscaleProgram;
+    GLint upscaleSource;
+    GLint upscaleInputSize;
+    GLint upscaleOutputSize;
+    GLuint sharpenProgram;
+    GLint sharpenSource;
+    GLint sharpenAmount;
+} UpscalePasses;
+
+// Upscales the render-size frame in source to the window, through the
+// sharpening pass when sharpness is above 0. The quad must be bound and
+// the viewport set to the window.
+void upscaleFrame(const UpscalePasses* passes, const UpscaleTarget* target, GLuint source, float sharpness,
+                  PassTimer* timer) {
+    bool sharpen = sharpness > 0.0f;
+    passTimerBegin(timer, PASS_UPSCALE);
+    glBindFramebuffer(GL_FRAMEBUFFER, sharpen ? target->upscaleFbo : 0);
+    glUseProgram(passes->upscaleProgram);
+    glBindTexture(GL_TEXTURE_2D, source);
+    glUniform1i(passes->upscaleSource, 0);
+    glUniform2f(passes->upscaleInputSize, (float)target->width, (float)target->height);
+    glUniform2f(passes->upscaleOutputSize, (float)target->outputWidth, (float)target->outputHeight);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    passTimerEnd(timer);
+    
+    if (sharpen) {
+        passTimerBegin(timer, PASS_SHARPEN);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glUseProgram(passes->sharpenProgram);
+        glBindTexture(GL_TEXTURE_2D, target->upscaleTex);
+        glUniform1i(passes->sharpenSource, 0);
+        glUniform1f(passes->sharpenAmount, sharpness);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        passTimerEnd(timer);
+    }
+}
+
+// Blue-noise tile: four independent 64x64 void-and-cluster masks in the
+// channels of an RGBA8 texture, tiled over the screen
+#define BLUE_NOISE_SIZE 64
+#define BLUE_NOISE_SIGMA 1.5f
+#define BLUE_NOISE_RADIUS 7      // the Gaussian is below 1e-4 beyond this
+
+// Gaussian energy of every pixel from the set pixels, on a torus
+typedef struct {
+    float* kernel;   // energy contribution by toroidal offset
+    float* energy;
+    unsigned char* set;
+} BlueNoiseState;
+
+static void blueNoiseToggle(BlueNoiseState* st, int pixel, bool on) {
+    const int n = BLUE_NOISE_SIZE;
+    int px = pixel % n, py = pixel / n;
+    float sign = on ? 1.0f : -1.0f;
+    st->set[pixel] = on;
+    for (int dy = -BLUE_NOISE_RADIUS; dy <= BLUE_NOISE_RADIUS; dy++) {
+        int y = (py + dy + n) % n;
+        int ky = (dy + n) % n;
+        for (int dx = -BLUE_NOISE_RADIUS; dx <= BLUE_NOISE_RADIUS; dx++) {
+            int x = (px + dx + n) % n;
+            st->energy[y * n + x] += sign * st->kernel[ky * n + (dx + n) % n];
+        }
+    }
+}
+
+// Tightest cluster (most energetic set pixel) or largest void (least
+// energetic unset pixel)
+static int blueNoiseExtreme(const BlueNoiseState* st, bool cluster) {
+    int best = -1;
+    for (int i = 0; i < BLUE_NOISE_SIZE * BLUE_NOISE_SIZE; i++) {
+        if (st->set[i] != cluster) continue;
+        if (best < 0 || (cluster ? st->energy[i] > st->energy[best] : st->energy[i] < st->energy[best])) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+// Ulichney's void-and-cluster: ranks every pixel of the tile so that any
+// threshold of the ranks is evenly spread. initial and initialEnergy are
+// scratch space for the starting pattern.
+static void rankBlueNoise(BlueNoiseState* st, unsigned char* initial, float* initialEnergy, int* rank,
+                          unsigned int seed) {
+    const int n = BLUE_NOISE_SIZE;
+    const int count = n * n;
+    const int initialOnes = count / 10;
+    
+    for (int y = 0; y < n; y++) {
+        for (int x = 0; x < n; x++) {
+            float dx = (float)(x <= n / 2 ? x : n - x);
+            float dy = (float)(y <= n / 2 ? y : n - y);
+            st->kernel[y * n + x] = expf(-(dx * dx + dy * dy) / (2.0f * BLUE_NOISE_SIGMA * BLUE_NOISE_SIGMA));
+        }
+    }
+    
+    // Random initial pattern, then move points from clusters into voids
+    // until the tightest cluster is the void just filled
+    for (int placed = 0; placed < initialOnes;) {
+        seed = seed * 1664525u + 1013904223u;
+        int pixel = (int)((seed >> 8) % (unsigned int)count);
+        if (!st->set[pixel]) {
+            blueNoiseToggle(st, pixel, true);
+            placed++;
+        }
+    }
+    for (;;) {
+        int cluster = blueNoiseExtreme(st, true);
+        blueNoiseToggle(st, cluster, false);
+        int hole = blueNoiseExtreme(st, false);
+        blueNoiseToggle(st, hole, true);
+        if (hole == cluster) break;
+    }
+    memcpy(initial, st->set, count);
+    memcpy(initialEnergy, st->energy, sizeof(float) * count);
+    
+    // Ranks below the initial pattern: remove tightest clusters
+    for (int r = initialOnes - 1; r >= 0; r--) {
+        int cluster = blueNoiseExtreme(st, true);
+        blueNoiseToggle(st, cluster, false);
+        rank[cluster] = r;
+    }
+    
+    // Ranks above it: fill largest voids
+    memcpy(st->set, initial, count);
+    memcpy(st->energy, initialEnergy, sizeof(float) * count);
+    for (int r = initialOnes; r < count; r++) {
+        int hole = blueNoiseExtreme(st, false);
+        blueNoiseToggle(st, hole, true);
+        rank[hole] = r;
+    }
+}
+
+// Writes a blue-noise tile as 0-255 into every fourth byte of out
+static bool generateBlueNoise(unsigned char* out, unsigned int seed) {
+    const int count = BLUE_NOISE_SIZE * BLUE_NOISE_SIZE;
+    BlueNoiseState st;
+    st.kernel = (float*)malloc(sizeof(float) * count);
+    st.energy = (float*)calloc(count, sizeof(float));
+    st.set = (unsigned char*)calloc(count, 1);
+    unsigned char* initial = (unsigned char*)malloc(count);
+    float* initialEnergy = (float*)malloc(sizeof(float) * count);
+    int* rank = (int*)malloc(sizeof(int) * count);
+    
+    bool ok = st.kernel && st.energy && st.set && initial && initialEnergy && rank;
+    if (ok) {
+        rankBlueNoise(&st, initial, initialEnergy, rank, seed);
+        for (int i = 0; i < count; i++) {
+            out[i * 4] = (unsigned char)(rank[i] * 256 / count);
+        }
+    }
+    
+    free(st.kernel);
+    free(st.energy);
+    free(st.set);
+    free(initial);
+    free(initialEnergy);
+    free(rank);
+    return ok;
+}
+
+GLuint createBlueNoiseTexture(void) {
+    unsigned char* texels = (unsigned char*)malloc(BLUE_NOISE_SIZE * BLUE_NOISE_SIZE * 4);
+    if (!texels) {
+        return 0;
+    }
+    for (int channel = 0; channel < 4; channel++) {
+        if (!generateBlueNoise(texels + channel, 0x9E3779B9u * (unsigned int)(channel + 1))) {
+            free(texels);
+            return 0;
+        }
+    }
+    
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, BLUE_NOISE_SIZE, BLUE_NOISE_SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, texels);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    free(texels);
+    return texture;
+}
+
+// Baked lighting volume: RGBA8 voxels holding light 1 visibility, light 2
+// visibility and AO. Cached on disk per kernel and resolution.
+#define LIGHTING_CACHE_MAGIC "SIERLVOL"
+
+typedef struct {
+    GLuint texture;
+    int resolution;
+    int kernel;  // kernel the volume was baked with, -1 if empty
+} LightingVolume;
+
+typedef struct {
+    char magic[8];
+    int resolution;
+    int iterations;
+    char kernel[32];
+} LightingCacheHeader;
+
+// DE_ITERATIONS from the fragment shader prelude, which changes the bake
+static int lightingIterations(void) {
+    const char* define = strstr(fragmentShaderPrelude, "DE_ITERATIONS");
+    return define ? atoi(define + strlen("DE_ITERATIONS")) : 0;
+}
+
+// Relative to the working directory, as every other file the program writes
+static void lightingCachePath(char* path, size_t size, int kernel, int resolution) {
+    snprintf(path, size, "sierpinski_lighting_%s_%d.cache", deKernels[kernel].name, resolution);
+}
+
+static void lightingCacheHeader(LightingCacheHeader* header, int kernel, int resolution) {
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, LIGHTING_CACHE_MAGIC, sizeof(header->magic));
+    header->resolution = resolution;
+    header->iterations = lightingIterations();
+    strncpy(header->kernel, deKernels[kernel].name, sizeof(header->kernel) - 1);
+}
+
+static bool loadLightingCache(const char* path, int kernel, int resolution, unsigned char* voxels, size_t bytes) {
+    FILE* file = fopen(path, "rb");
+    if (!file) return false;
+    
+    LightingCacheHeader expected, header;
+    lightingCacheHeader(&expected, kernel, resolution);
+    bool ok = fread(&header, sizeof(header), 1, file) == 1 &&
+              memcmp(&header, &expected, sizeof(header)) == 0 &&
+              fread(voxels, 1, bytes, file) == bytes;
+    fclose(file);
+    return ok;
+}
+
+static bool saveLightingCache(const char* path, int kernel, int resolution, const unsigned char* voxels, size_t bytes) {
+    FILE* file = fopen(path, "wb");
+    if (!file) return false;
+    
+    LightingCacheHeader header;
+    lightingCacheHeader(&header, kernel, resolution);
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(voxels, 1, bytes, file) == bytes;
+    ok = fclose(file) == 0 && ok;
+    if (!ok) remove(path);
+    return ok;
+}
+
+// Renders the bake shader into every slice of the volume texture
+static bool bakeLightingSlices(GLuint texture, int kernel, int resolution, GLuint quadVao) {
+    GLuint program = createLightingBakeProgram(kernel);
+    if (!program) return false;
+    
+    GLuint fbo;
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glViewport(0, 0, resolution, resolution);
+    glUseProgram(program);
+    glUniform1f(glGetUniformLocation(program, "u_bakeResolution"), (float)resolution);
+    GLint sliceLocation = glGetUniformLocation(program, "u_bakeSlice");
+    glBindVertexArray(quadVao);
+    
+    bool ok = true;
+    for (int z = 0; z < resolution && ok; z++) {
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, texture, 0, z);
+        if (z == 0 && glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            fprintf(stderr, "Lighting bake framebuffer incomplete\n");
+            ok = false;
+            break;
+        }
+        glUniform1f(sliceLocation, (float)z);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    }
+    glFinish();
+    
+    glBindVertexArray(0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteProgram(program);
+    return ok;
+}
+
+// Fills the volume for `kernel`, from the cache file if it matches and by
+// baking on the GPU otherwise. Restores the viewport to the window size.
+bool prepareLightingVolume(LightingVolume* volume, int kernel, int resolution, bool rebake,
+                           GLuint quadVao, int windowWidth, int windowHeight) {
+    size_t bytes = (size_t)resolution * resolution * resolution * 4;
+    unsigned char* voxels = (unsigned char*)malloc(bytes);
+    if (!voxels) {
+        fprintf(stderr, "Out of memory for the %d^3 lighting volume\n", resolution);
+        return false;
+    }
+    
+    if (!volume->texture) glGenTextures(1, &volume->texture);
+    glBindTexture(GL_TEXTURE_3D, volume->texture);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    
+    char path[256];
+    lightingCachePath(path, sizeof(path), kernel, resolution);
+    Uint64 start = SDL_GetPerformanceCounter();
+    bool ok = true;
+    
+    if (!rebake && loadLightingCache(path, kernel, resolution, voxels, bytes)) {
+        glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA8, resolution, resolution, resolution, 0,
+                     GL_RGBA, GL_UNSIGNED_BYTE, voxels);
+        double ms = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+        printf("Lighting volume: loaded %d^3 from %s in %.1f ms (%.1f MiB)\n",
+               resolution, path, ms, bytes / (1024.0 * 1024.0));
+    } else {
+        glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA8, resolution, resolution, resolution, 0,
+                     GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        ok = bakeLightingSlices(volume->texture, kernel, resolution, quadVao);
+        if (ok) {
+            double ms = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+            printf("Lighting volume: baked %d^3 in %.1f ms (%.1f MiB)\n",
+                   resolution, ms, bytes / (1024.0 * 1024.0));
+            glBindTexture(GL_TEXTURE_3D, volume->texture);
+            glGetTexImage(GL_TEXTURE_3D, 0, GL_RGBA, GL_UNSIGNED_BYTE, voxels);
+            if (saveLightingCache(path, kernel, resolution, voxels, bytes)) {
+                printf("Lighting volume: cached to %s\n", path);
+            } else {
+                fprintf(stderr, "Could not write lighting cache %s\n", path);
+            }
+        }
+    }
+    
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_3D, 0);
+    glViewport(0, 0, windowWidth, windowHeight);
+    free(voxels);
+    
+    volume->resolution = resolution;
+    volume->kernel = ok ? kernel : -1;
+    return ok;
+}
+
+// 3x3 rotation matrices
+void rotationMatrixY(float angle, float* mat) {
+    float c = cosf(angle);
+    float s = sinf(angle);
+    
+    mat[0] = c;  mat[1] = 0;  mat[2] = s;
+    mat[3] = 0;  mat[4] = 1;  mat[5] = 0;
+    mat[6] = -s; mat[7] = 0;  mat[8] = c;
+}
+
+void rotationMatrixX(float angle, float* mat) {
+    float c = cosf(angle);
     float s = sinf(angle);
     
     mat[0] = 1;  mat[1] = 0;   mat[2] = 0;
@@ -473,12 +4497,497 @@ void multiplyMat3(float* result, float* a, float* b) {
             }
         }
     }
-    for (int i = 0; i < 9; i++) {
-        result[i] = temp[i];
+    for (int i = 0; i < 9; i++) {
+        result[i] = temp[i];
+    }
+}
+
+// The animation as a function of time: scene rotation and camera
+// position `time` seconds in, with the user's camera adjustments
+static void animationCamera(float time, float rotationSpeed, float offsetX, float offsetY, float distance,
+                            float rotMat[9], float camPos[3]) {
+    float rotAngleY = time * 0.25f * rotationSpeed;
+    float rotAngleX = sinf(time * 0.1f) * 0.15f;
+    
+    float rotY[9], rotX[9];
+    rotationMatrixY(rotAngleY, rotY);
+    rotationMatrixX(rotAngleX, rotX);
+    multiplyMat3(rotMat, rotY, rotX);
+    
+    // Camera position with organic motion
+    camPos[0] = sinf(time * 0.12f) * 0.4f + offsetX;
+    camPos[1] = sinf(time * 0.18f) * 0.3f + cosf(time * 0.15f) * 0.2f + offsetY;
+    camPos[2] = distance + cosf(time * 0.08f) * 0.6f;
+}
+
+// Frames a still picture takes to become complete: one per reflection
+// slice, or one per checkerboard field
+static int refreshFrameCount(int reflectionSlices, bool checkerboard) {
+    return checkerboard ? 2 : reflectionSlices;
+}
+
+int main(int argc, char* argv[]) {
+    Uint64 launchTick = SDL_GetPerformanceCounter();
+    
+    // Command line options
+    int deKernel = deKernelFind("plane-fold");
+    bool exactIntersector = false;
+    bool depthPrepass = false;
+    int hullLevel = 3;
+    bool bakedLighting = false;
+    bool rebakeLighting = false;
+    int bakeResolution = 128;
+    int maxFps = 0;
+    int backgroundFps = 20;
+    bool paused = false;
+    bool asyncCompile = true;
+    int reflectionSlices = 1;
+    bool sampleShading = false;
+    bool blueNoise = false;
+    int glowSteps = 32;
+    float renderScale = 1.0f;
+    bool easuUpscaler = true;
+    float sharpness = 0.5f;
+    bool checkerboard = false;
+    bool variableRate = false;
+    float rateRadii[2] = {0.5f, 0.75f};  // full rate inside [0], half rate inside [1]
+    bool stereo = false;
+    float eyeSeparation = 0.1f;
+    int panoramaWidth = 0;      // 0: no panorama capture
+    int panoramaHeight = 0;
+    const char* panoramaPath = "panorama.ppm";
+    const char* animationDir = NULL;    // NULL: interactive
+    int animationFrames = 600;
+    double animationFps = 60.0;
+    int animationWidth = 1920;
+    int animationHeight = 1080;
+    int animationChunk = 8;
+    const char* tileCoordinator = NULL;    // [HOST:]PORT to serve tiles on
+    const char* tileWorker = NULL;         // [HOST:]PORT of the coordinator
+    int tileFrameWidth = 3840;
+    int tileFrameHeight = 2160;
+    int tileSize = 256;
+    int tileWorkers = 2;
+    const char* tileOutput = "tiles.ppm";
+    int accumulatePasses = 0;           // 0: no progressive accumulation
+    int accumulateWidth = 1920;
+    int accumulateHeight = 1080;
+    const char* accumulateOutput = "accumulated.ppm";
+    const char* checkpointPath = NULL;  // NULL: no checkpoints
+    double checkpointInterval = 60.0;   // seconds
+    const char* shareName = NULL;       // NULL: no shared-memory export
+    int shareSlots = 3;
+    const char* playPath = NULL;        // NULL: render live
+    bool depthOfField = false;
+    float focusDistance = 0.0f;     // 0: the camera depth of the fractal's center
+    float aperture = 0.05f;         // lens radius
+    bool motionBlur = false;
+    float shutter = 0.5f;           // fraction of the frame interval
+    int postQuality = 1;
+    bool hdr = false;
+    int toneCurve = TONE_CURVE_ACES;
+    float exposure = 0.0f;          // stops
+    const char* hdrPath = NULL;     // NULL: no HDR capture
+    int hdrFrames = 1;              // frames to capture before exiting, 0: until quit
+    bool hdrGuide = false;
+    bool denoise = false;
+    int denoisePasses = 3;
+    int samplesPerPixel = 4;        // of the manual AA grid
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--intersector") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "exact") == 0) {
+                exactIntersector = true;
+            } else if (strcmp(argv[i], "march") == 0) {
+                exactIntersector = false;
+            } else {
+                fprintf(stderr, "--intersector must be 'exact' or 'march'\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--depth-prepass") == 0) {
+            depthPrepass = true;
+        } else if (strcmp(argv[i], "--baked-lighting") == 0) {
+            bakedLighting = true;
+        } else if (strcmp(argv[i], "--rebake") == 0) {
+            bakedLighting = true;
+            rebakeLighting = true;
+        } else if (strcmp(argv[i], "--bake-resolution") == 0 && i + 1 < argc) {
+            bakeResolution = atoi(argv[++i]);
+            if (bakeResolution < 16 || bakeResolution > 512) {
+                fprintf(stderr, "--bake-resolution must be between 16 and 512\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--max-fps") == 0 && i + 1 < argc) {
+            maxFps = atoi(argv[++i]);
+            if (maxFps < 0) {
+                fprintf(stderr, "--max-fps must be 0 (vsync only) or positive\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--background-fps") == 0 && i + 1 < argc) {
+            backgroundFps = atoi(argv[++i]);
+            if (backgroundFps < 0) {
+                fprintf(stderr, "--background-fps must be 0 (no throttle) or positive\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--paused") == 0) {
+            paused = true;
+        } else if (strcmp(argv[i], "--reflection-slices") == 0 && i + 1 < argc) {
+            reflectionSlices = atoi(argv[++i]);
+            if (reflectionSlices < 1 || reflectionSlices > 16) {
+                fprintf(stderr, "--reflection-slices must be between 1 and 16\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--blue-noise") == 0) {
+            blueNoise = true;
+        } else if (strcmp(argv[i], "--glow-steps") == 0 && i + 1 < argc) {
+            glowSteps = atoi(argv[++i]);
+            if (glowSteps < 4 || glowSteps > 64) {
+                fprintf(stderr, "--glow-steps must be between 4 and 64\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--checkerboard") == 0) {
+            checkerboard = true;
+        } else if (strcmp(argv[i], "--variable-rate") == 0) {
+            variableRate = true;
+        } else if (strcmp(argv[i], "--rate-radii") == 0 && i + 1 < argc) {
+            variableRate = true;
+            if (sscanf(argv[++i], "%f,%f", &rateRadii[0], &rateRadii[1]) != 2 ||
+                rateRadii[0] <= 0.0f || rateRadii[1] <= rateRadii[0]) {
+                fprintf(stderr, "--rate-radii takes two increasing radii, e.g. 0.5,0.75\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--stereo") == 0) {
+            stereo = true;
+        } else if (strcmp(argv[i], "--eye-separation") == 0 && i + 1 < argc) {
+            stereo = true;
+            eyeSeparation = (float)atof(argv[++i]);
+            if (eyeSeparation <= 0.0f || eyeSeparation > 1.0f) {
+                fprintf(stderr, "--eye-separation must be above 0 and at most 1\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--panorama") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%dx%d", &panoramaWidth, &panoramaHeight) != 2 || panoramaWidth <= 0 ||
+                panoramaWidth % PANORAMA_MAX_STRETCH != 0 || panoramaHeight <= 0) {
+                fprintf(stderr, "--panorama takes WIDTHxHEIGHT, the width a multiple of %d, e.g. 8192x4096\n",
+                        PANORAMA_MAX_STRETCH);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--panorama-output") == 0 && i + 1 < argc) {
+            panoramaPath = argv[++i];
+        } else if (strcmp(argv[i], "--animation") == 0 && i + 1 < argc) {
+            animationDir = argv[++i];
+        } else if (strcmp(argv[i], "--animation-frames") == 0 && i + 1 < argc) {
+            animationFrames = atoi(argv[++i]);
+            if (animationFrames < 1) {
+                fprintf(stderr, "--animation-frames must be at least 1\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--animation-fps") == 0 && i + 1 < argc) {
+            animationFps = atof(argv[++i]);
+            if (!(animationFps > 0.0 && animationFps <= 1000.0)) {
+                fprintf(stderr, "--animation-fps must be positive and at most 1000\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--animation-size") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%dx%d", &animationWidth, &animationHeight) != 2 || animationWidth <= 0 ||
+                animationHeight <= 0) {
+                fprintf(stderr, "--animation-size takes WIDTHxHEIGHT, e.g. 3840x2160\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--animation-chunk") == 0 && i + 1 < argc) {
+            animationChunk = atoi(argv[++i]);
+            if (animationChunk < 1) {
+                fprintf(stderr, "--animation-chunk must be at least 1\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--tile-coordinator") == 0 && i + 1 < argc) {
+            tileCoordinator = argv[++i];
+        } else if (strcmp(argv[i], "--tile-worker") == 0 && i + 1 < argc) {
+            tileWorker = argv[++i];
+        } else if (strcmp(argv[i], "--tile-frame") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%dx%d", &tileFrameWidth, &tileFrameHeight) != 2 || tileFrameWidth <= 0 ||
+                tileFrameHeight <= 0 || tileFrameWidth > TILE_MAX_FRAME || tileFrameHeight > TILE_MAX_FRAME) {
+                fprintf(stderr, "--tile-frame takes WIDTHxHEIGHT up to %d on a side, e.g. 15360x8640\n",
+                        TILE_MAX_FRAME);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--tile-size") == 0 && i + 1 < argc) {
+            tileSize = atoi(argv[++i]);
+            if (tileSize < 64 || tileSize > 1024 || tileSize % TILE_COST_SAMPLES != 0) {
+                fprintf(stderr, "--tile-size must be a multiple of %d between 64 and 1024\n", TILE_COST_SAMPLES);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--tile-workers") == 0 && i + 1 < argc) {
+            tileWorkers = atoi(argv[++i]);
+            if (tileWorkers < 1 || tileWorkers > TILE_MAX_WORKERS) {
+                fprintf(stderr, "--tile-workers must be between 1 and %d\n", TILE_MAX_WORKERS);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--tile-output") == 0 && i + 1 < argc) {
+            tileOutput = argv[++i];
+        } else if (strcmp(argv[i], "--accumulate") == 0 && i + 1 < argc) {
+            accumulatePasses = atoi(argv[++i]);
+            if (accumulatePasses < 1) {
+                fprintf(stderr, "--accumulate must be at least 1\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--accumulate-size") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%dx%d", &accumulateWidth, &accumulateHeight) != 2 || accumulateWidth <= 0 ||
+                accumulateHeight <= 0) {
+                fprintf(stderr, "--accumulate-size takes WIDTHxHEIGHT, e.g. 3840x2160\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--accumulate-output") == 0 && i + 1 < argc) {
+            accumulateOutput = argv[++i];
+        } else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) {
+            checkpointPath = argv[++i];
+        } else if (strcmp(argv[i], "--share") == 0 && i + 1 < argc) {
+            shareName = argv[++i];
+            if (strchr(shareName, '/') || strchr(shareName, '\\') || strlen(shareName) > 200) {
+                fprintf(stderr, "--share takes a plain name, e.g. sierpinski\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--share-slots") == 0 && i + 1 < argc) {
+            shareSlots = atoi(argv[++i]);
+            if (shareSlots < 2 || shareSlots > FRAME_SHARE_MAX_SLOTS) {
+                fprintf(stderr, "--share-slots must be between 2 and %d\n", FRAME_SHARE_MAX_SLOTS);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--play") == 0 && i + 1 < argc) {
+            playPath = argv[++i];
+        } else if (strcmp(argv[i], "--checkpoint-interval") == 0 && i + 1 < argc) {
+            checkpointInterval = atof(argv[++i]);
+            if (checkpointInterval < 0.0) {
+                fprintf(stderr, "--checkpoint-interval must be 0 (every pass) or positive\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--dof") == 0) {
+            depthOfField = true;
+        } else if (strcmp(argv[i], "--focus") == 0 && i + 1 < argc) {
+            depthOfField = true;
+            focusDistance = (float)atof(argv[++i]);
+            if (focusDistance <= 0.0f) {
+                fprintf(stderr, "--focus must be a positive distance\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--aperture") == 0 && i + 1 < argc) {
+            depthOfField = true;
+            aperture = (float)atof(argv[++i]);
+            if (aperture <= 0.0f || aperture > 1.0f) {
+                fprintf(stderr, "--aperture must be above 0 and at most 1\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--motion-blur") == 0) {
+            motionBlur = true;
+        } else if (strcmp(argv[i], "--shutter") == 0 && i + 1 < argc) {
+            motionBlur = true;
+            shutter = (float)atof(argv[++i]);
+            if (shutter <= 0.0f || shutter > 1.0f) {
+                fprintf(stderr, "--shutter must be above 0 and at most 1\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--post-quality") == 0 && i + 1 < argc) {
+            i++;
+            postQuality = -1;
+            for (int q = 0; q < POST_QUALITY_COUNT; q++) {
+                if (strcmp(argv[i], postQualityLevels[q].name) == 0) postQuality = q;
+            }
+            if (postQuality < 0) {
+                fprintf(stderr, "--post-quality must be 'low', 'medium' or 'high'\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--hdr") == 0) {
+            hdr = true;
+        } else if (strcmp(argv[i], "--tonemap") == 0 && i + 1 < argc) {
+            hdr = true;
+            i++;
+            toneCurve = -1;
+            for (int c = 0; c < TONE_CURVE_COUNT; c++) {
+                if (strcmp(argv[i], toneCurveNames[c]) == 0) toneCurve = c;
+            }
+            if (toneCurve < 0) {
+                fprintf(stderr, "--tonemap must be 'classic', 'aces' or 'filmic'\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--exposure") == 0 && i + 1 < argc) {
+            hdr = true;
+            exposure = (float)atof(argv[++i]);
+            if (exposure < -8.0f || exposure > 8.0f) {
+                fprintf(stderr, "--exposure must be between -8 and 8 stops\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--hdr-output") == 0 && i + 1 < argc) {
+            hdr = true;
+            hdrPath = argv[++i];
+            bool exr;
+            if (!hdrCaptureFormat(hdrPath, &exr)) {
+                fprintf(stderr, "--hdr-output must name an .exr or .pfm file\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--hdr-frames") == 0 && i + 1 < argc) {
+            hdrFrames = atoi(argv[++i]);
+            if (hdrFrames < 0) {
+                fprintf(stderr, "--hdr-frames must be 0 (until quit) or positive\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--hdr-guide") == 0) {
+            hdrGuide = true;
+        } else if (strcmp(argv[i], "--denoise") == 0) {
+            denoise = true;
+        } else if (strcmp(argv[i], "--denoise-passes") == 0 && i + 1 < argc) {
+            denoise = true;
+            denoisePasses = atoi(argv[++i]);
+            if (denoisePasses < 1 || denoisePasses > DENOISE_MAX_PASSES) {
+                fprintf(stderr, "--denoise-passes must be between 1 and %d\n", DENOISE_MAX_PASSES);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--spp") == 0 && i + 1 < argc) {
+            samplesPerPixel = atoi(argv[++i]);
+            if (samplesPerPixel != 1 && samplesPerPixel != 4) {
+                fprintf(stderr, "--spp must be 1 or 4\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--render-scale") == 0 && i + 1 < argc) {
+            renderScale = (float)atof(argv[++i]);
+            if (renderScale < 0.25f || renderScale > 1.0f) {
+                fprintf(stderr, "--render-scale must be between 0.25 and 1\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--upscaler") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "bilinear") == 0) {
+                easuUpscaler = false;
+            } else if (strcmp(argv[i], "easu") != 0) {
+                fprintf(stderr, "--upscaler must be 'easu' or 'bilinear'\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--sharpness") == 0 && i + 1 < argc) {
+            sharpness = (float)atof(argv[++i]);
+            if (sharpness < 0.0f || sharpness > 1.0f) {
+                fprintf(stderr, "--sharpness must be between 0 (off) and 1\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--aa") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "msaa") == 0) {
+                sampleShading = true;
+            } else if (strcmp(argv[i], "manual") != 0) {
+                fprintf(stderr, "--aa must be 'manual' or 'msaa'\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--sync-compile") == 0) {
+            asyncCompile = false;
+        } else if (strcmp(argv[i], "--hull-level") == 0 && i + 1 < argc) {
+            hullLevel = atoi(argv[++i]);
+            if (hullLevel < 1 || hullLevel > 5) {
+                fprintf(stderr, "--hull-level must be between 1 and 5\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--kernel") == 0 && i + 1 < argc) {
+            deKernel = deKernelFind(argv[++i]);
+            if (deKernel < 0) {
+                fprintf(stderr, "Unknown DE kernel '%s'. Available kernels:\n", argv[i]);
+                deKernelPrintList(stderr);
+                return 1;
+            }
+        } else {
+            fprintf(stderr, "Unknown option '%s'\n", argv[i]);
+            fprintf(stderr, "Usage: %s [--kernel <name>] [--intersector march|exact]\n"
+                            "          [--depth-prepass] [--hull-level 1-5]\n"
+                            "          [--baked-lighting] [--bake-resolution 16-512] [--rebake]\n"
+                            "          [--max-fps n] [--background-fps n] [--paused] [--sync-compile]\n"
+                            "          [--reflection-slices 1-16] [--aa manual|msaa]\n"
+                            "          [--blue-noise] [--glow-steps 4-64]\n"
+                            "          [--render-scale 0.25-1] [--upscaler easu|bilinear] [--sharpness 0-1]\n"
+                            "          [--checkerboard] [--variable-rate] [--rate-radii full,half]\n"
+                            "          [--stereo] [--eye-separation d]\n"
+                            "          [--panorama WxH] [--panorama-output FILE]\n"
+                            "          [--dof] [--focus d] [--aperture r] [--motion-blur] [--shutter 0-1]\n"
+                            "          [--post-quality low|medium|high]\n"
+                            "          [--hdr] [--tonemap classic|aces|filmic] [--exposure stops]\n"
+                            "          [--hdr-output FILE.exr|FILE.pfm] [--hdr-frames n] [--hdr-guide]\n"
+                            "          [--denoise] [--denoise-passes 1-5] [--spp 1|4]\n"
+                            "          [--animation DIR] [--animation-frames n] [--animation-fps f]\n"
+                            "          [--animation-size WxH] [--animation-chunk n]\n"
+                            "          [--tile-coordinator [HOST:]PORT] [--tile-worker [HOST:]PORT]\n"
+                            "          [--tile-frame WxH] [--tile-size n] [--tile-workers n] [--tile-output FILE]\n"
+                            "          [--accumulate n] [--accumulate-size WxH] [--accumulate-output FILE]\n"
+                            "          [--checkpoint FILE] [--checkpoint-interval s]\n"
+                            "          [--share NAME] [--share-slots 2-8] [--play FILE]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+    
+    // A panorama is one still frame at full quality, shaded pixel by
+    // pixel, from the camera at animation time zero. Animation frames are
+    // shaded the same way, each on its own, at the time of the frame, and
+    // so are the tiles of a distributed frame and the passes of an
+    // accumulated one, at time zero.
+    bool tiled = tileCoordinator || tileWorker;
+    int offlineModes = (animationDir ? 1 : 0) + (tileCoordinator ? 1 : 0) + (tileWorker ? 1 : 0) +
+                       (accumulatePasses > 0 ? 1 : 0);
+    if (offlineModes > 1) {
+        fprintf(stderr, "Choose one of --animation, --tile-coordinator, --tile-worker and --accumulate\n");
+        return 1;
     }
-}
-
-int main(int argc, char* argv[]) {
+    if (playPath && (offlineModes > 0 || panoramaWidth > 0)) {
+        fprintf(stderr, "--play shows an archive and cannot be combined with rendering to files\n");
+        return 1;
+    }
+    const char* offlineFrames = animationDir ? "Animation frames are" : tiled ? "Tiled frames are"
+                              : accumulatePasses > 0 ? "Accumulated frames are" : "The panorama is";
+    if (offlineModes > 0) {
+        panoramaWidth = 0;
+        maxFps = 0;
+        backgroundFps = 0;
+        if (depthOfField || motionBlur || denoise) {
+            fprintf(stderr, "%s rendered without post-processing\n", offlineFrames);
+        }
+        depthOfField = false;
+        motionBlur = false;
+        denoise = false;
+    }
+    if (panoramaWidth > 0 || offlineModes > 0) {
+        if (sampleShading || stereo || checkerboard || variableRate || reflectionSlices > 1 || renderScale < 1.0f ||
+            depthPrepass) {
+            fprintf(stderr, "%s rendered without MSAA, stereo, checkerboard, variable-rate, "
+                            "time-sliced reflections, render scaling and the hull pre-pass\n",
+                    offlineFrames);
+        }
+        sampleShading = false;
+        stereo = false;
+        checkerboard = false;
+        variableRate = false;
+        reflectionSlices = 1;
+        renderScale = 1.0f;
+        depthPrepass = false;
+        asyncCompile = false;
+        paused = true;
+        hdr = false;
+        hdrPath = NULL;
+    }
+    // Accumulation passes differ only in their jitter
+    if (accumulatePasses > 0) blueNoise = true;
+    
+    // The capture guide holds the orbit trap, where time-sliced reflections
+    // keep their history, and the full frame's distances, which
+    // variable-rate shading and stereo do not keep
+    if (hdrGuide && hdrPath) {
+        bool exr;
+        hdrCaptureFormat(hdrPath, &exr);
+        if (exr) {
+            fprintf(stderr, "--hdr-guide is written with .pfm captures only\n");
+            hdrGuide = false;
+        } else if (reflectionSlices > 1 || variableRate || stereo) {
+            fprintf(stderr, "The capture guide replaces time-sliced reflections, variable-rate shading "
+                            "and stereo rendering\n");
+            reflectionSlices = 1;
+            variableRate = false;
+            stereo = false;
+        }
+    }
+    
     // Initialize SDL
     if (SDL_Init(SDL_INIT_VIDEO) < 0) {
         fprintf(stderr, "SDL initialization failed: %s\n", SDL_GetError());
@@ -490,9 +4999,6 @@ int main(int argc, char* argv[]) {
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
     SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
-    SDL_GL_SetAttribute(SDL_GL_MULTISAMPLEBUFFERS, 1);
-    SDL_GL_SetAttribute(SDL_GL_MULTISAMPLESAMPLES, 4);
-    
     // Create window
     int windowWidth = 1920;
     int windowHeight = 1080;
@@ -501,7 +5007,7 @@ int main(int argc, char* argv[]) {
         SDL_WINDOWPOS_CENTERED,
         SDL_WINDOWPOS_CENTERED,
         windowWidth, windowHeight,
-        SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE
+        SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE | (panoramaWidth > 0 || offlineModes > 0 ? SDL_WINDOW_HIDDEN : 0)
     );
     
     if (!window) {
@@ -533,6 +5039,64 @@ int main(int argc, char* argv[]) {
     // Enable VSync
     SDL_GL_SetSwapInterval(1);
     
+    if (sampleShading) {
+        // The samples go to an offscreen target, so the window itself is
+        // not multisampled
+        GLint samples = 0;
+        glGetIntegerv(GL_MAX_SAMPLES, &samples);
+        if (!GLEW_ARB_sample_shading || samples < MSAA_SAMPLES) {
+            fprintf(stderr, "Per-sample shading unavailable (%d samples%s), using manual AA\n", samples,
+                    GLEW_ARB_sample_shading ? "" : ", no GL_ARB_sample_shading");
+            sampleShading = false;
+        } else if (reflectionSlices > 1) {
+            // The reflection history target is single-sampled
+            fprintf(stderr, "Time-sliced reflections need manual AA, disabling them\n");
+            reflectionSlices = 1;
+        }
+        if (sampleShading && renderScale < 1.0f) {
+            // So does the reduced-resolution scene
+            fprintf(stderr, "Render scaling needs manual AA, rendering at full resolution\n");
+            renderScale = 1.0f;
+        }
+        if (sampleShading && checkerboard) {
+            fprintf(stderr, "Checkerboard rendering needs manual AA, disabling it\n");
+            checkerboard = false;
+        }
+        if (sampleShading && variableRate) {
+            fprintf(stderr, "Variable-rate shading needs manual AA, disabling it\n");
+            variableRate = false;
+        }
+        if (sampleShading && stereo) {
+            fprintf(stderr, "Stereo rendering needs manual AA, disabling it\n");
+            stereo = false;
+        }
+        if (sampleShading && hdr) {
+            // The HDR frame is single-sampled too
+            fprintf(stderr, "HDR rendering needs manual AA, rendering LDR\n");
+            hdr = false;
+            hdrPath = NULL;
+        }
+    }
+    if (stereo && (variableRate || checkerboard || reflectionSlices > 1)) {
+        // Their histories and rings are laid out over the whole frame
+        fprintf(stderr, "Stereo rendering replaces variable-rate shading, checkerboard rendering "
+                        "and time-sliced reflections\n");
+        variableRate = false;
+        checkerboard = false;
+        reflectionSlices = 1;
+    }
+    if (variableRate && (checkerboard || reflectionSlices > 1)) {
+        // Each of them decides which pixels a fragment shades
+        fprintf(stderr, "Variable-rate shading replaces checkerboard rendering and time-sliced reflections\n");
+        checkerboard = false;
+        reflectionSlices = 1;
+    }
+    if (checkerboard && reflectionSlices > 1) {
+        // Both keep a history at the same attachment of the fractal shader
+        fprintf(stderr, "Checkerboard rendering replaces time-sliced reflections, disabling them\n");
+        reflectionSlices = 1;
+    }
+    
     printf("╔══════════════════════════════════════════════════════════╗\n");
     printf("║  Enhanced Sierpinski Tetrahedron Ray Tracer             ║\n");
     printf("╚══════════════════════════════════════════════════════════╝\n");
@@ -541,18 +5105,49 @@ int main(int argc, char* argv[]) {
     printf("\nControls:\n");
     printf("  ESC / Q      - Quit\n");
     printf("  SPACE        - Cycle color palette\n");
-    printf("  Arrow Keys   - Adjust camera\n");
+    printf("  Arrow Keys   - Adjust camera (--play: Left/Right seek 1 s)\n");
+    printf("  0-9          - Jump to tenths of the archive (--play)\n");
     printf("  +/-          - Zoom in/out\n");
+    printf("  K            - Cycle distance estimator kernel\n");
+    printf("  X            - Toggle exact / ray-marched primary rays\n");
+    printf("  D            - Toggle bounding-hull depth pre-pass\n");
+    printf("  B            - Toggle baked / per-pixel shadows and AO\n");
+    printf("  P            - Pause / resume animation (idle until input)\n");
+    printf("  T            - Cycle time-sliced reflections (1, 2, 4, 8 slices)\n");
+    printf("  N            - Toggle blue-noise jitter for AA, glow and shadows\n");
+    printf("  U            - Cycle render scale (100%%, 67%%, 50%%) with upscaling\n");
+    printf("  C            - Toggle checkerboard rendering (half the pixels per frame)\n");
+    printf("  V            - Toggle variable-rate shading (coarser toward the edges)\n");
+    printf("  S            - Toggle side-by-side stereo (right eye reprojected)\n");
+    printf("  F            - Toggle depth of field\n");
+    printf("  M            - Toggle motion blur\n");
     printf("\n");
+    printf("DE kernel: %s | Intersector: %s\n", deKernels[deKernel].name,
+           exactIntersector ? "exact" : "march");
     
-    // Create shader program
-    GLuint shaderProgram = createShaderProgram(vertexShaderSource, fragmentShaderSource);
+    // Create shader program. The full program compiles in the background
+    // while a quick preview program draws the first frames.
+    ShaderCompiler compiler;
+    initShaderCompiler(&compiler, window, glContext, asyncCompile, sampleShading);
+    startFractalCompile(&compiler, deKernel, exactIntersector);
+    GLuint shaderProgram = 0;
+    bool fullQuality = false;
+    if (!pollFractalCompile(&compiler, &shaderProgram)) {
+        printf("Compiling shader in the background (%s)\n",
+               compiler.mode == COMPILE_PARALLEL ? "parallel shader compile" : "worker thread");
+        shaderProgram = createPreviewProgram(deKernel);
+    } else {
+        fullQuality = true;
+    }
     if (!shaderProgram) {
+        destroyShaderCompiler(&compiler);
         SDL_GL_DeleteContext(glContext);
         SDL_DestroyWindow(window);
         SDL_Quit();
         return 1;
     }
+    bool firstFrameLogged = false;
+    bool fullQualityLogged = false;
     
     // Full-screen quad vertices
     float quadVertices[] = {
@@ -577,31 +5172,347 @@ int main(int argc, char* argv[]) {
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
     
+    // Bounding hull: inflated level-n tetrahedra rasterized into a depth target
+    GLuint hullProgram = createShaderProgram(hullVertexShaderSource, &hullFragmentShaderSource, 1);
+    int hullVertexCount = (int)ifsTetraCount(hullLevel) * 12;
+    float* hullVertices = (float*)malloc(sizeof(float) * 3 * hullVertexCount);
+    if (!hullProgram || !hullVertices) {
+        fprintf(stderr, "Failed to set up the bounding-hull pre-pass\n");
+        free(hullVertices);
+        SDL_GL_DeleteContext(glContext);
+        SDL_DestroyWindow(window);
+        SDL_Quit();
+        return 1;
+    }
+    ifsBuildHullMesh(hullLevel, HULL_MARGIN, hullVertices);
+    
+    GLuint hullVao, hullVbo;
+    glGenVertexArrays(1, &hullVao);
+    glGenBuffers(1, &hullVbo);
+    glBindVertexArray(hullVao);
+    glBindBuffer(GL_ARRAY_BUFFER, hullVbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 3 * hullVertexCount, hullVertices, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+    free(hullVertices);
+    
+    GLint hullResolution = glGetUniformLocation(hullProgram, "u_resolution");
+    GLint hullCamPos = glGetUniformLocation(hullProgram, "u_camPos");
+    GLint hullRotation = glGetUniformLocation(hullProgram, "u_rotation");
+    
+    DepthTarget hullTarget = {0};
+    
+    // Time-sliced reflections render offscreen and copy to the window
+    GLuint copyProgram = createShaderProgram(vertexShaderSource, &copyFragmentShaderSource, 1);
+    GLint copySource = glGetUniformLocation(copyProgram, "u_source");
+    GLint copyOffset = glGetUniformLocation(copyProgram, "u_offset");
+    ReflectionTarget reflectionTarget = {0};
+    
+    // Render scaling: the scene is drawn at a fraction of the window size,
+    // then upscaled and sharpened into the window
+    UpscalePasses upscalePasses;
+    upscalePasses.upscaleProgram = createShaderProgram(vertexShaderSource,
+                                                       easuUpscaler ? &easuFragmentShaderSource
+                                                                    : &bilinearFragmentShaderSource, 1);
+    upscalePasses.upscaleSource = glGetUniformLocation(upscalePasses.upscaleProgram, "u_source");
+    upscalePasses.upscaleInputSize = glGetUniformLocation(upscalePasses.upscaleProgram, "u_inputSize");
+    upscalePasses.upscaleOutputSize = glGetUniformLocation(upscalePasses.upscaleProgram, "u_outputSize");
+    upscalePasses.sharpenProgram = createShaderProgram(vertexShaderSource, &rcasFragmentShaderSource, 1);
+    upscalePasses.sharpenSource = glGetUniformLocation(upscalePasses.sharpenProgram, "u_source");
+    upscalePasses.sharpenAmount = glGetUniformLocation(upscalePasses.sharpenProgram, "u_sharpness");
+    UpscaleTarget upscaleTarget = {0};
+    
+    // Checkerboard rendering: one field per frame, completed by reprojection
+    GLuint checkerProgram = createShaderProgram(vertexShaderSource, &checkerboardFragmentShaderSource, 1);
+    CheckerboardUniforms checkerUniforms;
+    getCheckerboardUniforms(checkerProgram, &checkerUniforms);
+    CheckerboardTarget checkerTarget = {0};
+    int checkerParity = 0;
+    bool checkerHistoryValid = false;
+    
+    // Variable-rate shading: the fractal passes per level, then a blend
+    GLuint compositeProgram = createShaderProgram(vertexShaderSource, &rateCompositeFragmentShaderSource, 1);
+    GLint compositeLevels[RATE_LEVELS] = {
+        glGetUniformLocation(compositeProgram, "u_full"),
+        glGetUniformLocation(compositeProgram, "u_half"),
+        glGetUniformLocation(compositeProgram, "u_quarter")
+    };
+    GLint compositeResolution = glGetUniformLocation(compositeProgram, "u_resolution");
+    GLint compositeRates = glGetUniformLocation(compositeProgram, "u_rates");
+    GLint compositeBand = glGetUniformLocation(compositeProgram, "u_band");
+    RateTarget rateTarget = {0};
+    
+    // Stereo: the left eye is reprojected into the right one, and the
+    // pixels it could not see are counted with an occlusion query
+    GLuint stereoProgram = createShaderProgram(vertexShaderSource, &stereoFragmentShaderSource, 1);
+    GLint stereoLeftColor = glGetUniformLocation(stereoProgram, "u_leftColor");
+    GLint stereoLeftGuide = glGetUniformLocation(stereoProgram, "u_leftGuide");
+    GLint stereoResolution = glGetUniformLocation(stereoProgram, "u_resolution");
+    GLint stereoDisparityScale = glGetUniformLocation(stereoProgram, "u_disparityScale");
+    GLint stereoMaxDisparity = glGetUniformLocation(stereoProgram, "u_maxDisparity");
+    StereoTarget stereoTarget = {0};
+    GLuint stereoHoleQuery;
+    glGenQueries(1, &stereoHoleQuery);
+    
+    // HDR: the frame stays linear until a tone-mapping pass of its own,
+    // which is all that re-runs for a grading change while paused
+    ToneMapPass toneMap;
+    toneMap.program = createToneMapProgram();
+    toneMap.source = glGetUniformLocation(toneMap.program, "u_source");
+    toneMap.exposure = glGetUniformLocation(toneMap.program, "u_exposure");
+    toneMap.curve = glGetUniformLocation(toneMap.program, "u_curve");
+    HdrTarget hdrTarget = {0};
+    MsaaTarget msaaTarget = {0};
+    HdrCapture hdrCapture;
+    initHdrCapture(&hdrCapture, hdrPath, hdrGuide);
+    // Shared frames are the window's, up to the size of the desktop
+    FrameShare frameShare;
+    SDL_DisplayMode desktop;
+    int shareWidth = windowWidth;
+    int shareHeight = windowHeight;
+    if (SDL_GetDesktopDisplayMode(0, &desktop) == 0) {
+        shareWidth = desktop.w > shareWidth ? desktop.w : shareWidth;
+        shareHeight = desktop.h > shareHeight ? desktop.h : shareHeight;
+    }
+    if (!initFrameShare(&frameShare, shareName, shareSlots, shareWidth, shareHeight)) {
+        return 1;
+    }
+    // Archive playback shows stored frames in place of rendered ones
+    Playback playback;
+    memset(&playback, 0, sizeof(playback));
+    if (playPath && !openPlayback(&playback, playPath)) {
+        closePlayback(&playback);
+        return 1;
+    }
+    GLuint gradeSource = 0;     // linear frame last shown, 0 if none
+    int gradeWidth = 0;
+    int gradeHeight = 0;
+    bool regradePending = false;
+    bool stereoHolePending = false;
+    int stereoHolePixels = 0;       // eye size of the pending query
+    double stereoHoleFraction = -1.0;
+    
+    // Depth of field and motion blur
+    GLuint velocityProgram = createShaderProgram(vertexShaderSource, &velocityFragmentShaderSource, 1);
+    GLint velocityGuide = glGetUniformLocation(velocityProgram, "u_guide");
+    GLint velocityResolution = glGetUniformLocation(velocityProgram, "u_resolution");
+    GLint velocityCamPos = glGetUniformLocation(velocityProgram, "u_camPos");
+    GLint velocityRotation = glGetUniformLocation(velocityProgram, "u_rotation");
+    GLint velocityPrevCamPos = glGetUniformLocation(velocityProgram, "u_prevCamPos");
+    GLint velocityPrevRotation = glGetUniformLocation(velocityProgram, "u_prevRotation");
+    GLint velocityShutter = glGetUniformLocation(velocityProgram, "u_shutter");
+    GLuint dofProgram = createShaderProgram(vertexShaderSource, &dofFragmentShaderSource, 1);
+    GLint dofColor = glGetUniformLocation(dofProgram, "u_color");
+    GLint dofGuide = glGetUniformLocation(dofProgram, "u_guide");
+    GLint dofResolution = glGetUniformLocation(dofProgram, "u_resolution");
+    GLint dofFocus = glGetUniformLocation(dofProgram, "u_focus");
+    GLint dofCocScale = glGetUniformLocation(dofProgram, "u_cocScale");
+    GLint dofMaxCoc = glGetUniformLocation(dofProgram, "u_maxCoc");
+    GLint dofSamples = glGetUniformLocation(dofProgram, "u_samples");
+    GLuint blurProgram = createShaderProgram(vertexShaderSource, &motionBlurFragmentShaderSource, 1);
+    GLint blurColor = glGetUniformLocation(blurProgram, "u_color");
+    GLint blurVelocity = glGetUniformLocation(blurProgram, "u_velocity");
+    GLint blurMaxBlur = glGetUniformLocation(blurProgram, "u_maxBlur");
+    GLint blurSamples = glGetUniformLocation(blurProgram, "u_samples");
+    
+    // Edge-aware denoising, before depth of field
+    GLuint featureProgram = createShaderProgram(vertexShaderSource, &denoiseFeatureFragmentShaderSource, 1);
+    GLint featureGuide = glGetUniformLocation(featureProgram, "u_guide");
+    GLint featureResolution = glGetUniformLocation(featureProgram, "u_resolution");
+    GLuint atrousProgram = createShaderProgram(vertexShaderSource, &atrousFragmentShaderSource, 1);
+    GLint atrousColor = glGetUniformLocation(atrousProgram, "u_color");
+    GLint atrousFeature = glGetUniformLocation(atrousProgram, "u_feature");
+    GLint atrousGuide = glGetUniformLocation(atrousProgram, "u_guide");
+    GLint atrousResolution = glGetUniformLocation(atrousProgram, "u_resolution");
+    GLint atrousStep = glGetUniformLocation(atrousProgram, "u_step");
+    GLint atrousColorSigma = glGetUniformLocation(atrousProgram, "u_colorSigma");
+    GLint atrousUseTrap = glGetUniformLocation(atrousProgram, "u_useTrap");
+    PostTarget postTarget = {0};
+    bool postHistoryValid = false;  // prevCamPos is last frame's camera
+    bool msaaPostFallbackNoted = false;
+    unsigned int rateFrame = 0;
+    double rateProbeMs = 0.0;  // last full-rate time of the outer rings
+    PassTimer passTimer;
+    initPassTimer(&passTimer);
+    
+    // Blue-noise jitter, rotated every frame; the tile takes ~0.1 s to
+    // generate, so that waits until jitter is first turned on
+    GLuint blueNoiseTexture = 0;
+    unsigned int noiseFrame = 0;
+    if (blueNoise) {
+        blueNoiseTexture = createBlueNoiseTexture();
+        blueNoise = blueNoiseTexture != 0;
+    }
+    unsigned int reflectionFrame = 0;
+    int reflectionSlice = 0;        // slot traced next, below reflectionSlices
+    bool reflectionHistoryValid = false;
+    float prevCamPos[3] = {0.0f, 0.0f, 0.0f};
+    float prevRotation[9] = {0.0f};
+    int refreshFrames = 0;  // frames until every slice and field has been shaded
+    printf("Hull pre-pass: %s, level %d (%lld tetrahedra)\n", depthPrepass ? "on" : "off",
+           hullLevel, ifsTetraCount(hullLevel));
+    
     // Get uniform locations
-    GLint u_resolution = glGetUniformLocation(shaderProgram, "u_resolution");
-    GLint u_time = glGetUniformLocation(shaderProgram, "u_time");
-    GLint u_camPos = glGetUniformLocation(shaderProgram, "u_camPos");
-    GLint u_rotation = glGetUniformLocation(shaderProgram, "u_rotation");
-    GLint u_colorPalette = glGetUniformLocation(shaderProgram, "u_colorPalette");
+    FractalUniforms uniforms;
+    getFractalUniforms(shaderProgram, &uniforms);
+    
+    // Baked shadows and AO, filled when first enabled
+    LightingVolume lightingVolume = {0, 0, -1};
+    if (bakedLighting) {
+        bakedLighting = prepareLightingVolume(&lightingVolume, deKernel, bakeResolution, rebakeLighting,
+                                              vao, windowWidth, windowHeight);
+    }
     
     // Application state
     bool running = true;
+    int exitCode = 0;
     Uint32 startTime = SDL_GetTicks();
+    bool needsRedraw = true;     // something changed since the last frame
+    bool windowHidden = false;   // minimized or hidden: nothing to draw
+    bool windowFocused = true;   // unfocused windows are often covered; throttle them
+    double animationTime = 0.0;  // advances only while not paused
+    Uint64 perfFrequency = SDL_GetPerformanceFrequency();
+    Uint64 lastTick = SDL_GetPerformanceCounter();
+    Uint64 nextFrameTick = lastTick;
     int colorPalette = 0;
     float cameraOffsetX = 0.0f;
     float cameraOffsetY = 0.0f;
     float cameraDistance = 4.5f;
     float rotationSpeedMult = 1.0f;
     
+    // Offline animation worker: renders the frames of the chunks it claims
+    AnimationQueue animationQueue = {0};
+    animationQueue.claimed = -1;
+    int animationFrame = -1;        // frame to render next, -1 when interactive
+    GLuint animationFbo = 0;
+    GLuint animationTexture = 0;
+    unsigned char* animationPixels = NULL;
+    Uint64 animationStart = SDL_GetPerformanceCounter();
+    if (animationDir) {
+        animationTexture = createTargetTexture(GL_RGBA8, animationWidth, animationHeight);
+        glGenFramebuffers(1, &animationFbo);
+        animationPixels = (unsigned char*)malloc((size_t)animationWidth * animationHeight * 3);
+        if (!animationPixels || !attachColorTarget(animationFbo, animationTexture, "Animation frame") ||
+            !openAnimationQueue(&animationQueue, animationDir, animationFrames, animationFps, animationWidth,
+                                animationHeight, animationChunk)) {
+            exitCode = 1;
+            running = false;
+        } else {
+            animationFrame = nextAnimationFrame(&animationQueue, -1);
+            if (animationFrame < 0) {
+                printf("Animation: every chunk is done or held by another worker\n");
+                running = false;
+            }
+        }
+    }
+    
+    // Everything that changes the image, which must match between a tile
+    // coordinator and its workers, and for a checkpoint to be resumed
+    char frameSettings[96];
+    snprintf(frameSettings, sizeof(frameSettings), "kernel=%s intersector=%s spp=%d glow=%d noise=%d bake=%d",
+             deKernels[deKernel].name, exactIntersector ? "exact" : "march", samplesPerPixel, glowSteps,
+             blueNoise ? 1 : 0, bakedLighting ? bakeResolution : 0);
+    if (tiled && !tileSocketsInit()) {
+        exitCode = 1;
+        running = false;
+    }
+    
+    // Progressive accumulation, resumed from the checkpoint if there is one
+    GLuint accumulationFbo = 0;
+    GLuint accumulationTexture = 0;
+    int accumulatedPasses = 0;
+    int checkpointedPasses = 0;
+    Uint64 checkpointTick = SDL_GetPerformanceCounter();
+    if (accumulatePasses > 0) {
+        accumulationTexture = createTargetTexture(GL_RGBA32F, accumulateWidth, accumulateHeight);
+        glGenFramebuffers(1, &accumulationFbo);
+        if (!blueNoise || !attachColorTarget(accumulationFbo, accumulationTexture, "Accumulation")) {
+            exitCode = 1;
+            running = false;
+        } else {
+            glBindFramebuffer(GL_FRAMEBUFFER, accumulationFbo);
+            glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        }
+        if (running && checkpointPath) {
+            float rotation[9], position[3];
+            char header[CHECKPOINT_HEADER_SIZE];
+            animationCamera(0.0f, rotationSpeedMult, cameraOffsetX, cameraOffsetY, cameraDistance, rotation,
+                            position);
+            size_t fixed = checkpointHeader(header, accumulateWidth, accumulateHeight, frameSettings, position,
+                                            rotation, 0);
+            accumulatedPasses = resumeCheckpoint(checkpointPath, header, fixed, accumulationTexture,
+                                                 accumulateWidth, accumulateHeight);
+            if (accumulatedPasses < 0) {
+                exitCode = 1;
+                running = false;
+            } else if (accumulatedPasses > 0) {
+                printf("Accumulation: resuming after %d passes from %s\n", accumulatedPasses, checkpointPath);
+            }
+            checkpointedPasses = accumulatedPasses;
+        }
+    }
+    
     // FPS counter
     Uint32 frameCount = 0;
     Uint32 lastFPSTime = startTime;
     float fps = 0.0f;
     
     while (running) {
-        // Event handling
+        // Publish the shared frames whose readback has finished, also
+        // once the loop has gone idle
+        if (frameShare.name) {
+            frameSharePoll(&frameShare);
+        }
+        
+        // Frame pacing: sleep on the event queue until the next frame is due,
+        // or until input arrives when nothing on screen would change
+        int frameLimit = maxFps;
+        if (!windowFocused && backgroundFps > 0 && (frameLimit == 0 || backgroundFps < frameLimit)) {
+            frameLimit = backgroundFps;
+        }
+        Uint64 frameInterval = frameLimit > 0 ? perfFrequency / frameLimit : 0;
+        bool idle = windowHidden || (paused && !needsRedraw && !regradePending);
+        
         SDL_Event event;
-        while (SDL_PollEvent(&event)) {
+        bool haveEvent = false;
+        if (idle) {
+            // Keep checking on a background compile or shared frames still
+            // being read back while idle
+            bool polling = compiler.active || (frameShare.name && frameShare.published < frameShare.issued);
+            haveEvent = (polling ? SDL_WaitEventTimeout(&event, 10) : SDL_WaitEvent(&event)) == 1;
+        } else {
+            Uint64 now = SDL_GetPerformanceCounter();
+            if (frameInterval > 0 && now < nextFrameTick) {
+                int waitMs = (int)(((nextFrameTick - now) * 1000 + perfFrequency - 1) / perfFrequency);
+                haveEvent = SDL_WaitEventTimeout(&event, waitMs) == 1;
+            }
+        }
+        
+        // Event handling
+        while (haveEvent || SDL_PollEvent(&event)) {
+            haveEvent = false;
+            SDL_Keycode key = event.type == SDL_KEYDOWN ? event.key.keysym.sym : SDLK_UNKNOWN;
+            if (key == SDLK_g || key == SDLK_LEFTBRACKET || key == SDLK_RIGHTBRACKET) {
+                regradePending = true;
+            } else if (event.type == SDL_KEYDOWN || event.type == SDL_WINDOWEVENT) {
+                needsRedraw = true;
+                refreshFrames = refreshFrameCount(reflectionSlices, checkerboard);
+                checkerHistoryValid = false;
+            }
+            // During playback the arrow keys seek a second and the digits
+            // jump to tenths of the archive, instead of moving the camera
+            if (playback.header && (key == SDLK_LEFT || key == SDLK_RIGHT || (key >= SDLK_0 && key <= SDLK_9))) {
+                double length = playback.header->frameCount / playback.header->fps;
+                animationTime = key == SDLK_LEFT ? animationTime - 1.0
+                              : key == SDLK_RIGHT ? animationTime + 1.0 : length * (key - SDLK_0) / 10.0;
+                if (animationTime < 0.0) animationTime = 0.0;
+                printf("\nPlayback: %.2f s\n", fmod(animationTime, length));
+                continue;
+            }
             if (event.type == SDL_QUIT) {
                 running = false;
             } else if (event.type == SDL_KEYDOWN) {
@@ -635,6 +5546,140 @@ int main(int argc, char* argv[]) {
                         cameraDistance += 0.2f;
                         if (cameraDistance > 10.0f) cameraDistance = 10.0f;
                         break;
+                    case SDLK_k:
+                    case SDLK_x: {
+                        // Cycle DE kernel or toggle the intersector; the
+                        // current program stays until the new one is built
+                        if (compiler.active) {
+                            printf("\nStill compiling the previous shader\n");
+                            break;
+                        }
+                        int nextKernel = deKernel;
+                        bool nextExact = exactIntersector;
+                        if (event.key.keysym.sym == SDLK_k) {
+                            nextKernel = (deKernel + 1) % DE_KERNEL_COUNT;
+                        } else {
+                            nextExact = !exactIntersector;
+                        }
+                        startFractalCompile(&compiler, nextKernel, nextExact);
+                        break;
+                    }
+                    case SDLK_b:
+                        bakedLighting = !bakedLighting;
+                        if (bakedLighting && lightingVolume.kernel != deKernel) {
+                            bakedLighting = prepareLightingVolume(&lightingVolume, deKernel, bakeResolution, false,
+                                                                  vao, windowWidth, windowHeight);
+                        }
+                        printf("\nShadows/AO: %s\n", bakedLighting ? "baked" : "per pixel");
+                        break;
+                    case SDLK_d:
+                        depthPrepass = !depthPrepass;
+                        printf("\nHull pre-pass: %s\n", depthPrepass ? "on" : "off");
+                        break;
+                    case SDLK_n:
+                        blueNoise = !blueNoise;
+                        if (blueNoise && !blueNoiseTexture) {
+                            blueNoiseTexture = createBlueNoiseTexture();
+                            blueNoise = blueNoiseTexture != 0;
+                        }
+                        printf("\nBlue-noise jitter: %s\n", blueNoise ? "on" : "off");
+                        break;
+                    case SDLK_t:
+                        if (sampleShading) {
+                            printf("\nTime-sliced reflections need manual AA (--aa manual)\n");
+                            break;
+                        }
+                        if (checkerboard || variableRate || stereo) {
+                            printf("\nTime-sliced reflections are off with checkerboard, variable-rate "
+                                   "or stereo rendering\n");
+                            break;
+                        }
+                        reflectionSlices = reflectionSlices >= 8 ? 1 : reflectionSlices * 2;
+                        refreshFrames = reflectionSlices;
+                        reflectionHistoryValid = false;
+                        printf("\nReflection slices: %d\n", reflectionSlices);
+                        break;
+                    case SDLK_u:
+                        if (sampleShading) {
+                            printf("\nRender scaling needs manual AA (--aa manual)\n");
+                            break;
+                        }
+                        renderScale = renderScale > 0.9f ? 0.67f : renderScale > 0.6f ? 0.5f : 1.0f;
+                        reflectionHistoryValid = false;
+                        printf("\nRender scale: %.0f%%\n", renderScale * 100.0f);
+                        break;
+                    case SDLK_c:
+                        if (sampleShading) {
+                            printf("\nCheckerboard rendering needs manual AA (--aa manual)\n");
+                            break;
+                        }
+                        checkerboard = !checkerboard;
+                        if (checkerboard) {
+                            reflectionSlices = 1;
+                            variableRate = false;
+                            stereo = false;
+                        }
+                        refreshFrames = refreshFrameCount(reflectionSlices, checkerboard);
+                        printf("\nCheckerboard rendering: %s\n", checkerboard ? "on" : "off");
+                        break;
+                    case SDLK_v:
+                        if (sampleShading) {
+                            printf("\nVariable-rate shading needs manual AA (--aa manual)\n");
+                            break;
+                        }
+                        variableRate = !variableRate;
+                        if (variableRate) {
+                            reflectionSlices = 1;
+                            checkerboard = false;
+                            stereo = false;
+                            printf("\nVariable-rate shading: on, %.0f%% of the fragments\n",
+                                   100.0 * rateShadedFraction(rateRadii, windowWidth, windowHeight));
+                        } else {
+                            printf("\nVariable-rate shading: off\n");
+                        }
+                        refreshFrames = refreshFrameCount(reflectionSlices, checkerboard);
+                        break;
+                    case SDLK_s:
+                        if (sampleShading) {
+                            printf("\nStereo rendering needs manual AA (--aa manual)\n");
+                            break;
+                        }
+                        stereo = !stereo;
+                        if (stereo) {
+                            reflectionSlices = 1;
+                            checkerboard = false;
+                            variableRate = false;
+                        }
+                        refreshFrames = refreshFrameCount(reflectionSlices, checkerboard);
+                        printf("\nStereo rendering: %s\n", stereo ? "on" : "off");
+                        break;
+                    case SDLK_f:
+                        depthOfField = !depthOfField;
+                        printf("\nDepth of field: %s\n", depthOfField ? "on" : "off");
+                        break;
+                    case SDLK_m:
+                        motionBlur = !motionBlur;
+                        printf("\nMotion blur: %s\n", motionBlur ? "on" : "off");
+                        break;
+                    case SDLK_w:
+                        denoise = !denoise;
+                        printf("\nDenoiser: %s\n", denoise ? "on" : "off");
+                        break;
+                    case SDLK_g:
+                        toneCurve = (toneCurve + 1) % TONE_CURVE_COUNT;
+                        printf("\nTone curve: %s%s\n", toneCurveNames[toneCurve], hdr ? "" : " (HDR is off)");
+                        break;
+                    case SDLK_LEFTBRACKET:
+                    case SDLK_RIGHTBRACKET:
+                        exposure += key == SDLK_RIGHTBRACKET ? 0.5f : -0.5f;
+                        if (exposure < -8.0f) exposure = -8.0f;
+                        if (exposure > 8.0f) exposure = 8.0f;
+                        printf("\nExposure: %+.1f stops%s\n", exposure, hdr ? "" : " (HDR is off)");
+                        break;
+                    case SDLK_p:
+                        paused = !paused;
+                        printf("\nAnimation: %s\n", paused ? "paused" : "running");
+                        break;
                     case SDLK_r:
                         // Reset camera
                         cameraOffsetX = 0.0f;
@@ -642,67 +5687,940 @@ int main(int argc, char* argv[]) {
                         cameraDistance = 4.5f;
                         break;
                 }
-            } else if (event.type == SDL_WINDOWEVENT && event.window.event == SDL_WINDOWEVENT_RESIZED) {
-                windowWidth = event.window.data1;
-                windowHeight = event.window.data2;
-                glViewport(0, 0, windowWidth, windowHeight);
+            } else if (event.type == SDL_WINDOWEVENT) {
+                switch (event.window.event) {
+                    case SDL_WINDOWEVENT_RESIZED:
+                        windowWidth = event.window.data1;
+                        windowHeight = event.window.data2;
+                        glViewport(0, 0, windowWidth, windowHeight);
+                        break;
+                    case SDL_WINDOWEVENT_MINIMIZED:
+                    case SDL_WINDOWEVENT_HIDDEN:
+                        windowHidden = true;
+                        break;
+                    case SDL_WINDOWEVENT_RESTORED:
+                    case SDL_WINDOWEVENT_MAXIMIZED:
+                    case SDL_WINDOWEVENT_SHOWN:
+                        windowHidden = false;
+                        break;
+                    case SDL_WINDOWEVENT_FOCUS_GAINED:
+                        windowFocused = true;
+                        break;
+                    case SDL_WINDOWEVENT_FOCUS_LOST:
+                        windowFocused = false;
+                        break;
+                }
+            }
+        }
+        
+        // Swap in a finished background compile; keep the old program if
+        // the new one fails
+        GLuint nextProgram;
+        if (pollFractalCompile(&compiler, &nextProgram)) {
+            double compileMs = (SDL_GetPerformanceCounter() - compiler.startTick) * 1000.0 / perfFrequency;
+            if (nextProgram) {
+                glDeleteProgram(shaderProgram);
+                shaderProgram = nextProgram;
+                deKernel = compiler.kernel;
+                exactIntersector = compiler.exact;
+                getFractalUniforms(shaderProgram, &uniforms);
+                needsRedraw = true;
+                refreshFrames = refreshFrameCount(reflectionSlices, checkerboard);
+                reflectionHistoryValid = false;
+                checkerHistoryValid = false;
+            } else if (!fullQuality) {
+                fprintf(stderr, "\nThe full-quality shader failed to build\n");
+                exitCode = 1;
+                break;
+            }
+            printf("\nDE kernel: %s | Intersector: %s | Shader built in %.0f ms\n", deKernels[deKernel].name,
+                   exactIntersector ? "exact" : "march", compileMs);
+            fullQuality = true;
+            if (bakedLighting && lightingVolume.kernel != deKernel) {
+                bakedLighting = prepareLightingVolume(&lightingVolume, deKernel, bakeResolution, false,
+                                                      vao, windowWidth, windowHeight);
+            }
+        }
+        
+        // Advance the animation clock; paused time does not count
+        Uint64 tick = SDL_GetPerformanceCounter();
+        if (!paused) {
+            animationTime += (double)(tick - lastTick) / perfFrequency;
+        }
+        lastTick = tick;
+        
+        // Skip the frame if nothing would change or the limiter says not yet
+        if (windowHidden || (paused && !needsRedraw && !regradePending)) {
+            continue;
+        }
+        if (frameInterval > 0) {
+            if (tick < nextFrameTick) {
+                continue;
+            }
+            // Stay on the frame grid, but do not try to catch up after a stall
+            nextFrameTick = tick - nextFrameTick > frameInterval ? tick + frameInterval
+                                                                 : nextFrameTick + frameInterval;
+        }
+        bool regradeOnly = paused && !needsRedraw;
+        regradePending = false;
+        needsRedraw = false;
+        // A still picture needs one frame per slice before every
+        // reflection has been retraced
+        if (refreshFrames > 0) {
+            refreshFrames--;
+            needsRedraw = refreshFrames > 0;
+        }
+        
+        // Calculate time; an animation worker takes it from its frame
+        if (animationFrame >= 0) {
+            animationTime = animationFrame / animationFps;
+        }
+        float time = (float)animationTime;
+        
+        if (playback.header) {
+            if (!showPlaybackFrame(&playback, animationTime, windowWidth, windowHeight)) {
+                exitCode = 1;
+                break;
+            }
+            SDL_GL_SwapWindow(window);
+            continue;
+        }
+        
+        float rotMat[9], camPos[3];
+        animationCamera(time, rotationSpeedMult, cameraOffsetX, cameraOffsetY, cameraDistance, rotMat, camPos);
+        float camX = camPos[0];
+        float camY = camPos[1];
+        float camZ = camPos[2];
+        
+        // Reduced internal resolution, upscaled to the window at the end
+        bool upscaling = renderScale < 1.0f && upscalePasses.upscaleProgram && upscalePasses.sharpenProgram;
+        int renderWidth = windowWidth;
+        int renderHeight = windowHeight;
+        if (upscaling) {
+            renderWidth = (int)(windowWidth * renderScale + 0.5f);
+            renderHeight = (int)(windowHeight * renderScale + 0.5f);
+            if (renderWidth < 1) renderWidth = 1;
+            if (renderHeight < 1) renderHeight = 1;
+            if (upscaleTarget.width != renderWidth || upscaleTarget.height != renderHeight ||
+                upscaleTarget.outputWidth != windowWidth || upscaleTarget.outputHeight != windowHeight) {
+                if (upscaleTarget.sceneFbo) destroyUpscaleTarget(&upscaleTarget);
+                if (!createUpscaleTarget(&upscaleTarget, renderWidth, renderHeight, windowWidth, windowHeight)) {
+                    destroyUpscaleTarget(&upscaleTarget);
+                    renderScale = 1.0f;
+                    upscaling = false;
+                    renderWidth = windowWidth;
+                    renderHeight = windowHeight;
+                }
+            }
+        }
+        
+        // Re-grade the last frame when only the tone map has changed
+        if (regradeOnly && gradeSource && gradeWidth == renderWidth && gradeHeight == renderHeight) {
+            passTimerBeginFrame(&passTimer);
+            passTimerBegin(&passTimer, PASS_TONEMAP);
+            glBindFramebuffer(GL_FRAMEBUFFER, upscaling ? upscaleTarget.sceneFbo : 0);
+            glViewport(0, 0, renderWidth, renderHeight);
+            glBindVertexArray(vao);
+            drawToneMap(&toneMap, gradeSource, exposure, toneCurve);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glViewport(0, 0, windowWidth, windowHeight);
+            passTimerEnd(&passTimer);
+            if (upscaling) {
+                upscaleFrame(&upscalePasses, &upscaleTarget, upscaleTarget.sceneTex, sharpness, &passTimer);
+            }
+            passTimerEndFrame(&passTimer);
+            glBindVertexArray(0);
+            if (frameShare.name) {
+                frameShareFrame(&frameShare, windowWidth, windowHeight, colorPalette, (float)animationTime, camPos,
+                                rotMat);
+            }
+            SDL_GL_SwapWindow(window);
+            continue;
+        }
+        
+        // Stereo renders each eye into half the frame, from cameras half
+        // the eye separation to either side along the camera's x axis
+        // (row 0 of rotMat, which is uploaded transposed). The hull
+        // target is rendered for the center camera, so it sits out.
+        bool stereoRendered = stereo && fullQuality && stereoProgram;
+        int eyeWidth = renderWidth / 2 > 0 ? renderWidth / 2 : 1;
+        if (stereoRendered && (stereoTarget.width != eyeWidth || stereoTarget.height != renderHeight)) {
+            if (stereoTarget.fbo[0]) destroyStereoTarget(&stereoTarget);
+            if (!createStereoTarget(&stereoTarget, eyeWidth, renderHeight)) {
+                destroyStereoTarget(&stereoTarget);
+                stereo = false;
+                stereoRendered = false;
+            }
+        }
+        float eyeOffset[3] = {0.0f, 0.0f, 0.0f};
+        if (stereoRendered) {
+            for (int i = 0; i < 3; i++) {
+                eyeOffset[i] = rotMat[i] * 0.5f * eyeSeparation;
+            }
+        }
+        // From inside the hull the nearest face is an exit, and a face
+        // closer than the near plane is clipped away, so the march would
+        // start past the geometry in front of the camera; it starts at 0
+        // without the pre-pass instead
+        DEVec3 hullEye = {camX, camY, camZ};
+        bool hullPrepass = depthPrepass && !stereoRendered &&
+                           !ifsInsideHull(hullLevel, HULL_MARGIN + HULL_NEAR, hullEye);
+        
+        passTimerBeginFrame(&passTimer);
+        passTimerBegin(&passTimer, PASS_SCENE);
+        
+        // Hull pre-pass: rasterize the bounding tetrahedra into the depth target
+        if (hullPrepass) {
+            if (hullTarget.width != renderWidth || hullTarget.height != renderHeight) {
+                if (hullTarget.fbo) destroyDepthTarget(&hullTarget);
+                if (!createDepthTarget(&hullTarget, renderWidth, renderHeight)) {
+                    destroyDepthTarget(&hullTarget);
+                    depthPrepass = false;
+                    hullPrepass = false;
+                }
+            }
+        }
+        if (hullPrepass) {
+            glBindFramebuffer(GL_FRAMEBUFFER, hullTarget.fbo);
+            glViewport(0, 0, hullTarget.width, hullTarget.height);
+            glClearDepth(1.0);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            glEnable(GL_DEPTH_TEST);
+            glDepthFunc(GL_LESS);
+            
+            glUseProgram(hullProgram);
+            glUniform2f(hullResolution, (float)renderWidth, (float)renderHeight);
+            glUniform3f(hullCamPos, camX, camY, camZ);
+            glUniformMatrix3fv(hullRotation, 1, GL_FALSE, rotMat);
+            glBindVertexArray(hullVao);
+            glDrawArrays(GL_TRIANGLES, 0, hullVertexCount);
+            
+            glDisable(GL_DEPTH_TEST);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        }
+        
+        // Time-sliced reflections draw into the offscreen target
+        bool timeSliced = reflectionSlices > 1 && copyProgram && !stereoRendered;
+        if (timeSliced && (reflectionTarget.width != renderWidth || reflectionTarget.height != renderHeight)) {
+            if (reflectionTarget.fbo[0]) destroyReflectionTarget(&reflectionTarget);
+            reflectionHistoryValid = false;
+            if (!createReflectionTarget(&reflectionTarget, renderWidth, renderHeight)) {
+                destroyReflectionTarget(&reflectionTarget);
+                reflectionSlices = 1;
+                timeSliced = false;
+            }
+        }
+        if (!timeSliced) {
+            reflectionHistoryValid = false;
+        }
+        
+        // Checkerboard rendering shades one field into a half-width target;
+        // the preview shader draws whole frames
+        bool checkerboarded = checkerboard && fullQuality && checkerProgram && !stereoRendered;
+        if (checkerboarded && (checkerTarget.width != renderWidth || checkerTarget.height != renderHeight)) {
+            if (checkerTarget.fieldFbo) destroyCheckerboardTarget(&checkerTarget);
+            checkerHistoryValid = false;
+            if (!createCheckerboardTarget(&checkerTarget, renderWidth, renderHeight)) {
+                destroyCheckerboardTarget(&checkerTarget);
+                checkerboard = false;
+                checkerboarded = false;
             }
         }
+        if (!checkerboarded) {
+            checkerHistoryValid = false;
+        }
         
-        // Calculate time
-        float time = (SDL_GetTicks() - startTime) / 1000.0f;
+        // Variable-rate shading draws the rings into the levels of its target
+        bool variableRated = variableRate && fullQuality && !timeSliced && !checkerboarded && !stereoRendered &&
+                             compositeProgram;
+        if (variableRated && (rateTarget.width != renderWidth || rateTarget.height != renderHeight)) {
+            if (rateTarget.fbo[0]) destroyRateTarget(&rateTarget);
+            if (!createRateTarget(&rateTarget, renderWidth, renderHeight)) {
+                destroyRateTarget(&rateTarget);
+                variableRate = false;
+                variableRated = false;
+            }
+        }
         
-        // Calculate combined rotation matrix
-        float rotAngleY = time * 0.25f * rotationSpeedMult;
-        float rotAngleX = sinf(time * 0.1f) * 0.15f;
+        // Denoising, depth of field and motion blur read the hit distances,
+        // which variable-rate shading and stereo do not keep for the whole
+        // frame
+        bool postProcessed = (denoise || depthOfField || motionBlur) && fullQuality && !variableRated &&
+                             !stereoRendered && velocityProgram && dofProgram && blurProgram && featureProgram &&
+                             atrousProgram;
+        if (postProcessed && (postTarget.width != renderWidth || postTarget.height != renderHeight)) {
+            if (postTarget.sceneFbo) destroyPostTarget(&postTarget);
+            if (!createPostTarget(&postTarget, renderWidth, renderHeight)) {
+                destroyPostTarget(&postTarget);
+                denoise = false;
+                depthOfField = false;
+                motionBlur = false;
+                postProcessed = false;
+            }
+        }
         
-        float rotY[9], rotX[9], rotMat[9];
-        rotationMatrixY(rotAngleY, rotY);
-        rotationMatrixX(rotAngleX, rotX);
-        multiplyMat3(rotMat, rotY, rotX);
+        // HDR frames go to the tone map through the HDR target, and so do
+        // per-sample shaded ones, resolved into it from the MSAA target;
+        // everything that writes the whole frame at render size writes
+        // frameFbo
+        bool msaaResolved = sampleShading && fullQuality && toneMap.program && !postProcessed;
+        // The post passes read single-sampled targets, so their frames use
+        // the manual grid instead
+        bool msaaPostFallback = sampleShading && (denoise || depthOfField || motionBlur);
+        if (msaaPostFallback && !msaaPostFallbackNoted) {
+            printf("\nDenoising, depth of field and motion blur need manual AA; using the %s grid meanwhile\n",
+                   samplesPerPixel == 1 ? "1x1" : "2x2");
+        }
+        msaaPostFallbackNoted = msaaPostFallback;
+        if (msaaResolved && (msaaTarget.width != renderWidth || msaaTarget.height != renderHeight)) {
+            if (msaaTarget.fbo) destroyMsaaTarget(&msaaTarget);
+            if (!createMsaaTarget(&msaaTarget, renderWidth, renderHeight)) {
+                destroyMsaaTarget(&msaaTarget);
+                sampleShading = false;
+                msaaResolved = false;
+            }
+        }
+        bool hdrRendered = (hdr || msaaResolved) && fullQuality && toneMap.program;
+        if (hdrRendered && (hdrTarget.width != renderWidth || hdrTarget.height != renderHeight)) {
+            if (hdrTarget.fbo) destroyHdrTarget(&hdrTarget);
+            if (!createHdrTarget(&hdrTarget, renderWidth, renderHeight)) {
+                destroyHdrTarget(&hdrTarget);
+                hdr = false;
+                hdrRendered = false;
+                msaaResolved = false;
+            }
+        }
+        GLuint frameFbo = msaaResolved ? msaaTarget.fbo : hdrRendered ? hdrTarget.fbo
+                        : upscaling ? upscaleTarget.sceneFbo : 0;
         
-        // Camera position with organic motion
-        float camX = sinf(time * 0.12f) * 0.4f + cameraOffsetX;
-        float camY = sinf(time * 0.18f) * 0.3f + cosf(time * 0.15f) * 0.2f + cameraOffsetY;
-        float camZ = cameraDistance + cosf(time * 0.08f) * 0.6f;
+        int historyWrite = reflectionFrame & 1;
+        if (timeSliced) {
+            glBindFramebuffer(GL_FRAMEBUFFER, reflectionTarget.fbo[historyWrite]);
+        } else if (checkerboarded) {
+            glBindFramebuffer(GL_FRAMEBUFFER, checkerTarget.fieldFbo);
+        } else if (variableRated) {
+            glBindFramebuffer(GL_FRAMEBUFFER, rateTarget.fbo[0]);
+        } else if (stereoRendered) {
+            glBindFramebuffer(GL_FRAMEBUFFER, stereoTarget.fbo[0]);
+        } else if (postProcessed) {
+            glBindFramebuffer(GL_FRAMEBUFFER, postTarget.sceneFbo);
+        } else {
+            glBindFramebuffer(GL_FRAMEBUFFER, frameFbo);
+        }
+        int viewWidth = checkerboarded ? (renderWidth + 1) / 2 : stereoRendered ? eyeWidth : renderWidth;
+        glViewport(0, 0, viewWidth, renderHeight);
         
         // Render
         glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
         
         glUseProgram(shaderProgram);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, hullPrepass ? hullTarget.depthTex : 0);
+        glUniform1i(uniforms.hullDepth, 0);
+        glUniform1i(uniforms.depthPrepass, hullPrepass ? 1 : 0);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_3D, bakedLighting ? lightingVolume.texture : 0);
+        glUniform1i(uniforms.lightingVolume, 1);
+        glUniform1i(uniforms.bakedLighting, bakedLighting ? 1 : 0);
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, timeSliced ? reflectionTarget.historyTex[historyWrite ^ 1] : 0);
+        glUniform1i(uniforms.reflectionHistory, 2);
+        glActiveTexture(GL_TEXTURE0);
+        glUniform1i(uniforms.reflectionSlices, timeSliced ? reflectionSlices : 1);
+        // The slice count can change between frames
+        reflectionSlice %= reflectionSlices;
+        glUniform1i(uniforms.reflectionSlice, reflectionSlice);
+        glUniform1i(uniforms.historyValid, reflectionHistoryValid ? 1 : 0);
+        glUniform3fv(uniforms.prevCamPos, 1, prevCamPos);
+        glUniformMatrix3fv(uniforms.prevRotation, 1, GL_FALSE, prevRotation);
+        
+        // The noise is shifted by a different irrational step per channel
+        // each frame (powers of the inverse of 1.1673, the R4 sequence), so
+        // every pixel sees an evenly spread series of values over time
+        glActiveTexture(GL_TEXTURE3);
+        glBindTexture(GL_TEXTURE_2D, blueNoise ? blueNoiseTexture : 0);
+        glUniform1i(uniforms.blueNoise, 3);
+        glActiveTexture(GL_TEXTURE0);
+        glUniform1i(uniforms.jitter, blueNoise ? 1 : 0);
+        glUniform4f(uniforms.noiseOffset, fmodf(noiseFrame * 0.85667488f, 1.0f), fmodf(noiseFrame * 0.73389453f, 1.0f),
+                    fmodf(noiseFrame * 0.62870167f, 1.0f), fmodf(noiseFrame * 0.53859339f, 1.0f));
+        glUniform1i(uniforms.glowSteps, glowSteps);
+        glUniform1i(uniforms.aaGrid, samplesPerPixel == 1 ? 1 : 2);
+        glUniform1i(uniforms.sampleShading, msaaResolved ? 1 : 0);
+        glUniform1i(uniforms.checkerboard, checkerboarded ? 1 : 0);
+        glUniform1i(uniforms.checkerParity, checkerParity);
+        // The full-rate center of variable-rate shading discards beyond its ring
+        float rateInner = 0.0f, rateOuter = 1e9f;
+        if (variableRated) {
+            rateRegion(rateRadii, 0, renderHeight, &rateInner, &rateOuter);
+        }
+        glUniform1i(uniforms.pixelScale, 1);
+        glUniform2f(uniforms.rateRegion, rateInner, rateOuter);
+        noiseFrame = (noiseFrame + 1) % 4096;
         
         // Set uniforms
-        glUniform2f(u_resolution, (float)windowWidth, (float)windowHeight);
-        glUniform1f(u_time, time);
-        glUniform3f(u_camPos, camX, camY, camZ);
-        glUniformMatrix3fv(u_rotation, 1, GL_FALSE, rotMat);
-        glUniform1i(u_colorPalette, colorPalette);
+        glUniform2f(uniforms.resolution, (float)(stereoRendered ? eyeWidth : renderWidth), (float)renderHeight);
+        glUniform1f(uniforms.time, time);
+        glUniform3f(uniforms.camPos, camX - eyeOffset[0], camY - eyeOffset[1], camZ - eyeOffset[2]);
+        glUniformMatrix3fv(uniforms.rotation, 1, GL_FALSE, rotMat);
+        glUniform1i(uniforms.colorPalette, colorPalette);
+        glUniform1i(uniforms.hdr, hdrRendered ? 1 : 0);
+        
+        // A panorama capture renders the first frame's camera and exits
+        if (panoramaWidth > 0 && fullQuality) {
+            passTimerEnd(&passTimer);
+            glBindVertexArray(vao);
+            exitCode = renderPanorama(panoramaPath, panoramaWidth, panoramaHeight, &uniforms) ? 0 : 1;
+            break;
+        }
+        
+        // An animation worker writes its frame and moves on to the next
+        // one it holds or can claim, until the queue has none left
+        if (animationFrame >= 0 && fullQuality) {
+            passTimerEnd(&passTimer);
+            glBindVertexArray(vao);
+            if (!renderAnimationFrame(&animationQueue, animationFrame, animationFbo, animationWidth,
+                                      animationHeight, animationPixels, &uniforms)) {
+                exitCode = 1;
+                break;
+            }
+            Uint64 written = SDL_GetPerformanceCounter();
+            printf("\rAnimation: frame %d written in %.2f s", animationFrame,
+                   (written - lastTick) / (double)perfFrequency);
+            fflush(stdout);
+            animationFrame = nextAnimationFrame(&animationQueue, animationFrame);
+            if (animationFrame < 0) {
+                break;
+            }
+            glViewport(0, 0, windowWidth, windowHeight);
+            needsRedraw = true;
+            continue;
+        }
+        
+        // Accumulation adds a pass per iteration, so input is still handled
+        // between passes, checkpoints every so often, and writes the
+        // average once it has every pass
+        if (accumulatePasses > 0 && fullQuality) {
+            passTimerEnd(&passTimer);
+            glBindVertexArray(vao);
+            Uint64 passStart = SDL_GetPerformanceCounter();
+            if (accumulatedPasses < accumulatePasses) {
+                renderAccumulationPass(accumulationFbo, accumulateWidth, accumulateHeight, accumulatedPasses,
+                                       &uniforms);
+                glFinish();
+                accumulatedPasses++;
+            }
+            Uint64 passEnd = SDL_GetPerformanceCounter();
+            bool finished = accumulatedPasses >= accumulatePasses;
+            if (checkpointPath && accumulatedPasses > checkpointedPasses &&
+                (finished || (passEnd - checkpointTick) / (double)perfFrequency >= checkpointInterval)) {
+                char header[CHECKPOINT_HEADER_SIZE];
+                checkpointHeader(header, accumulateWidth, accumulateHeight, frameSettings, camPos, rotMat,
+                                 accumulatedPasses);
+                if (!writeCheckpoint(checkpointPath, header, accumulationFbo, accumulateWidth, accumulateHeight)) {
+                    exitCode = 1;
+                    break;
+                }
+                checkpointedPasses = accumulatedPasses;
+                checkpointTick = SDL_GetPerformanceCounter();
+            }
+            if (finished) {
+                exitCode = writeAccumulation(accumulateOutput, accumulationFbo, accumulateWidth,
+                                             accumulateHeight) ? 0 : 1;
+                if (exitCode == 0) {
+                    printf("\nAccumulation: %d passes of %dx%d written to %s\n", accumulatedPasses,
+                           accumulateWidth, accumulateHeight, accumulateOutput);
+                }
+                break;
+            }
+            printf("\rAccumulation: %d of %d passes, %.2f s per pass, checkpoint at %d", accumulatedPasses,
+                   accumulatePasses, (passEnd - passStart) / (double)perfFrequency, checkpointedPasses);
+            fflush(stdout);
+            glViewport(0, 0, windowWidth, windowHeight);
+            needsRedraw = true;
+            continue;
+        }
+        
+        // A tile coordinator or worker renders its share of one frame at
+        // the first frame's camera and exits
+        if (tiled && fullQuality) {
+            passTimerEnd(&passTimer);
+            glBindVertexArray(vao);
+            bool ok = tileCoordinator
+                ? runTileCoordinator(tileCoordinator, tileFrameWidth, tileFrameHeight, tileSize, tileWorkers,
+                                     tileOutput, frameSettings, deKernel, rotMat, camPos)
+                : runTileWorker(tileWorker, frameSettings, &uniforms);
+            exitCode = ok ? 0 : 1;
+            break;
+        }
         
-        // Draw full-screen quad
+        // Draw full-screen quad, once per MSAA sample with per-sample shading
+        if (msaaResolved) {
+            glEnable(GL_SAMPLE_SHADING_ARB);
+            glMinSampleShadingARB(1.0f);
+        }
         glBindVertexArray(vao);
         glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        if (msaaResolved) {
+            glDisable(GL_SAMPLE_SHADING_ARB);
+        }
+        if (msaaResolved) {
+            resolveMsaaTarget(&msaaTarget, &hdrTarget);
+        }
+        
+        if (variableRated) {
+            // The coarser rings at 1/2 and 1/4 resolution
+            for (int level = 1; level < RATE_LEVELS; level++) {
+                int scale = 1 << level;
+                passTimerEnd(&passTimer);
+                passTimerBegin(&passTimer, level == 1 ? PASS_RATE_HALF : PASS_RATE_QUARTER);
+                glBindFramebuffer(GL_FRAMEBUFFER, rateTarget.fbo[level]);
+                glViewport(0, 0, (renderWidth + scale - 1) / scale, (renderHeight + scale - 1) / scale);
+                glClear(GL_COLOR_BUFFER_BIT);
+                rateRegion(rateRadii, level, renderHeight, &rateInner, &rateOuter);
+                glUniform1i(uniforms.pixelScale, scale);
+                glUniform2f(uniforms.rateRegion, rateInner, rateOuter);
+                glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            }
+            
+            // Now and then time what the outer rings would cost at full
+            // rate, for the saving on the FPS line, starting with the second
+            // frame (the pass timer skips the first). Level 0 is not read
+            // out there, so the probe can draw into it.
+            if (rateFrame % RATE_PROBE_INTERVAL == 1) {
+                passTimerEnd(&passTimer);
+                passTimerBegin(&passTimer, PASS_RATE_PROBE);
+                glBindFramebuffer(GL_FRAMEBUFFER, rateTarget.fbo[0]);
+                glViewport(0, 0, renderWidth, renderHeight);
+                rateRegion(rateRadii, 0, renderHeight, &rateInner, &rateOuter);
+                glUniform1i(uniforms.pixelScale, 1);
+                glUniform2f(uniforms.rateRegion, rateOuter, 1e9f);
+                glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            }
+            rateFrame++;
+            
+            passTimerEnd(&passTimer);
+            passTimerBegin(&passTimer, PASS_COMPOSITE);
+            glBindFramebuffer(GL_FRAMEBUFFER, frameFbo);
+            glViewport(0, 0, renderWidth, renderHeight);
+            glUseProgram(compositeProgram);
+            for (int level = 0; level < RATE_LEVELS; level++) {
+                glActiveTexture(GL_TEXTURE0 + level);
+                glBindTexture(GL_TEXTURE_2D, rateTarget.colorTex[level]);
+                glUniform1i(compositeLevels[level], level);
+            }
+            glActiveTexture(GL_TEXTURE0);
+            glUniform2f(compositeResolution, (float)renderWidth, (float)renderHeight);
+            glUniform2f(compositeRates, rateRadii[0], rateRadii[1]);
+            glUniform1f(compositeBand, RATE_BAND);
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        }
+        
+        if (stereoRendered) {
+            passTimerEnd(&passTimer);
+            passTimerBegin(&passTimer, PASS_RIGHT_EYE);
+            
+            // Reproject the left eye, marking the pixels it fills. The
+            // largest disparity is that of the nearest point of the
+            // fractal's bounding sphere, whose camera depth is at least
+            // 0.85 of its distance anywhere in the view.
+            float camDistance = sqrtf(camX * camX + camY * camY + camZ * camZ);
+            float nearDepth = 0.85f * (camDistance - STEREO_FRACTAL_RADIUS);
+            if (nearDepth < 0.2f) nearDepth = 0.2f;
+            float disparityScale = 1.8f * eyeSeparation * renderHeight;  // CAMERA_FOCAL
+            glBindFramebuffer(GL_FRAMEBUFFER, stereoTarget.fbo[1]);
+            glClearStencil(0);
+            glClear(GL_COLOR_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+            glEnable(GL_STENCIL_TEST);
+            glStencilFunc(GL_ALWAYS, 1, 0xFF);
+            glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+            glUseProgram(stereoProgram);
+            // Units past the fractal shader's, which are still bound for the holes
+            glActiveTexture(GL_TEXTURE4);
+            glBindTexture(GL_TEXTURE_2D, stereoTarget.colorTex[0]);
+            glActiveTexture(GL_TEXTURE5);
+            glBindTexture(GL_TEXTURE_2D, stereoTarget.guideTex[0]);
+            glActiveTexture(GL_TEXTURE0);
+            glUniform1i(stereoLeftColor, 4);
+            glUniform1i(stereoLeftGuide, 5);
+            glUniform2f(stereoResolution, (float)eyeWidth, (float)renderHeight);
+            glUniform1f(stereoDisparityScale, disparityScale);
+            glUniform1i(stereoMaxDisparity, (int)ceilf(disparityScale / nearDepth) + 1);
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            
+            // March the pixels left unmarked. Stencil writes are off, so
+            // the test can run before the shader. The query counts the
+            // pixels for the FPS line and is read once the GPU is done.
+            glStencilFunc(GL_EQUAL, 0, 0xFF);
+            glStencilMask(0x00);
+            glUseProgram(shaderProgram);
+            glUniform3f(uniforms.camPos, camX + eyeOffset[0], camY + eyeOffset[1], camZ + eyeOffset[2]);
+            bool countHoles = !stereoHolePending;
+            if (countHoles) {
+                glBeginQuery(GL_SAMPLES_PASSED, stereoHoleQuery);
+            }
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            if (countHoles) {
+                glEndQuery(GL_SAMPLES_PASSED);
+                stereoHolePending = true;
+                stereoHolePixels = eyeWidth * renderHeight;
+            }
+            glStencilMask(0xFF);
+            glDisable(GL_STENCIL_TEST);
+            
+            // Side by side into the frame, drawn since a blit cannot
+            // convert the float eyes into a fixed-point window
+            glBindFramebuffer(GL_FRAMEBUFFER, frameFbo);
+            glClear(GL_COLOR_BUFFER_BIT);
+            glUseProgram(copyProgram);
+            glUniform1i(copySource, 0);
+            for (int eye = 0; eye < 2; eye++) {
+                glViewport(eye * eyeWidth, 0, eyeWidth, renderHeight);
+                glBindTexture(GL_TEXTURE_2D, stereoTarget.colorTex[eye]);
+                glUniform2i(copyOffset, eye * eyeWidth, 0);
+                glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            }
+            glUniform2i(copyOffset, 0, 0);
+        }
+        if (stereoHolePending) {
+            GLuint available = 0;
+            glGetQueryObjectuiv(stereoHoleQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available) {
+                GLuint holes = 0;
+                glGetQueryObjectuiv(stereoHoleQuery, GL_QUERY_RESULT, &holes);
+                stereoHoleFraction = (double)holes / stereoHolePixels;
+                stereoHolePending = false;
+            }
+        }
+        
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        
+        // Complete the checkerboard frame at render size
+        GLuint sceneTexture = timeSliced ? reflectionTarget.colorTex : upscaleTarget.sceneTex;
+        if (checkerboarded) {
+            passTimerEnd(&passTimer);
+            passTimerBegin(&passTimer, PASS_RECONSTRUCT);
+            glBindFramebuffer(GL_FRAMEBUFFER, checkerTarget.historyFbo[checkerParity]);
+            glViewport(0, 0, renderWidth, renderHeight);
+            glUseProgram(checkerProgram);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, checkerTarget.fieldColorTex);
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, checkerTarget.fieldGuideTex);
+            glActiveTexture(GL_TEXTURE2);
+            glBindTexture(GL_TEXTURE_2D, checkerTarget.historyColorTex[checkerParity ^ 1]);
+            glActiveTexture(GL_TEXTURE3);
+            glBindTexture(GL_TEXTURE_2D, checkerTarget.historyGuideTex[checkerParity ^ 1]);
+            glActiveTexture(GL_TEXTURE0);
+            glUniform1i(checkerUniforms.field, 0);
+            glUniform1i(checkerUniforms.fieldGuide, 1);
+            glUniform1i(checkerUniforms.history, 2);
+            glUniform1i(checkerUniforms.historyGuide, 3);
+            glUniform1i(checkerUniforms.parity, checkerParity);
+            glUniform1i(checkerUniforms.historyValid, checkerHistoryValid ? 1 : 0);
+            glUniform2f(checkerUniforms.resolution, (float)renderWidth, (float)renderHeight);
+            glUniform3f(checkerUniforms.camPos, camX, camY, camZ);
+            glUniformMatrix3fv(checkerUniforms.rotation, 1, GL_FALSE, rotMat);
+            glUniform3fv(checkerUniforms.prevCamPos, 1, prevCamPos);
+            glUniformMatrix3fv(checkerUniforms.prevRotation, 1, GL_FALSE, prevRotation);
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            sceneTexture = checkerTarget.historyColorTex[checkerParity];
+        }
+        
+        // Denoising, depth of field, then motion blur, into the frame at
+        // render size
+        if (postProcessed) {
+            GLuint color = timeSliced || checkerboarded ? sceneTexture : postTarget.colorTex;
+            GLuint guide = timeSliced ? reflectionTarget.historyTex[historyWrite]
+                         : checkerboarded ? checkerTarget.historyGuideTex[checkerParity] : postTarget.guideTex;
+            GLuint output = frameFbo;
+            const PostQuality* quality = &postQualityLevels[postQuality];
+            glViewport(0, 0, renderWidth, renderHeight);
+            if (denoise) {
+                passTimerEnd(&passTimer);
+                passTimerBegin(&passTimer, PASS_DENOISE);
+                glBindFramebuffer(GL_FRAMEBUFFER, postTarget.featureFbo);
+                glUseProgram(featureProgram);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, guide);
+                glUniform1i(featureGuide, 0);
+                glUniform2f(featureResolution, (float)renderWidth, (float)renderHeight);
+                glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+                
+                // Level i spaces its taps 2^i pixels apart; the last one
+                // writes the output unless more passes follow
+                glUseProgram(atrousProgram);
+                glActiveTexture(GL_TEXTURE1);
+                glBindTexture(GL_TEXTURE_2D, postTarget.featureTex);
+                glActiveTexture(GL_TEXTURE2);
+                glBindTexture(GL_TEXTURE_2D, guide);
+                glActiveTexture(GL_TEXTURE0);
+                glUniform1i(atrousColor, 0);
+                glUniform1i(atrousFeature, 1);
+                glUniform1i(atrousGuide, 2);
+                glUniform2f(atrousResolution, (float)renderWidth, (float)renderHeight);
+                glUniform1i(atrousUseTrap, timeSliced ? 0 : 1);
+                for (int level = 0; level < denoisePasses; level++) {
+                    bool last = level == denoisePasses - 1 && !depthOfField && !motionBlur;
+                    glBindFramebuffer(GL_FRAMEBUFFER, last ? output : postTarget.denoiseFbo[level & 1]);
+                    glBindTexture(GL_TEXTURE_2D, color);
+                    glUniform1i(atrousStep, 1 << level);
+                    glUniform1f(atrousColorSigma, DENOISE_COLOR_SIGMA / (float)(1 << level));
+                    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+                    color = postTarget.denoiseTex[level & 1];
+                }
+            }
+            if (depthOfField) {
+                passTimerEnd(&passTimer);
+                passTimerBegin(&passTimer, PASS_DOF);
+                // Focus defaults to the camera depth of the fractal's
+                // center; the view axis is -(row 2 of rotMat)
+                float focus = focusDistance > 0.0f ? focusDistance
+                                                   : camX * rotMat[6] + camY * rotMat[7] + camZ * rotMat[8];
+                if (focus < 0.1f) focus = 0.1f;
+                glBindFramebuffer(GL_FRAMEBUFFER, motionBlur ? postTarget.dofFbo : output);
+                glUseProgram(dofProgram);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, color);
+                glActiveTexture(GL_TEXTURE1);
+                glBindTexture(GL_TEXTURE_2D, guide);
+                glActiveTexture(GL_TEXTURE0);
+                glUniform1i(dofColor, 0);
+                glUniform1i(dofGuide, 1);
+                glUniform2f(dofResolution, (float)renderWidth, (float)renderHeight);
+                glUniform1f(dofFocus, focus);
+                glUniform1f(dofCocScale, aperture * 1.8f * renderHeight);  // CAMERA_FOCAL
+                glUniform1f(dofMaxCoc, quality->maxCoc);
+                glUniform1i(dofSamples, quality->dofSamples);
+                glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+                color = postTarget.dofTex;
+            }
+            if (motionBlur) {
+                passTimerEnd(&passTimer);
+                passTimerBegin(&passTimer, PASS_MOTION_BLUR);
+                // Without a previous frame nothing has moved yet
+                float camPos[3] = {camX, camY, camZ};
+                glBindFramebuffer(GL_FRAMEBUFFER, postTarget.velocityFbo);
+                glUseProgram(velocityProgram);
+                glBindTexture(GL_TEXTURE_2D, guide);
+                glUniform1i(velocityGuide, 0);
+                glUniform2f(velocityResolution, (float)renderWidth, (float)renderHeight);
+                glUniform3fv(velocityCamPos, 1, camPos);
+                glUniformMatrix3fv(velocityRotation, 1, GL_FALSE, rotMat);
+                glUniform3fv(velocityPrevCamPos, 1, postHistoryValid ? prevCamPos : camPos);
+                glUniformMatrix3fv(velocityPrevRotation, 1, GL_FALSE, postHistoryValid ? prevRotation : rotMat);
+                glUniform1f(velocityShutter, shutter);
+                glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+                
+                glBindFramebuffer(GL_FRAMEBUFFER, output);
+                glUseProgram(blurProgram);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, color);
+                glActiveTexture(GL_TEXTURE1);
+                glBindTexture(GL_TEXTURE_2D, postTarget.velocityTex);
+                glActiveTexture(GL_TEXTURE0);
+                glUniform1i(blurColor, 0);
+                glUniform1i(blurVelocity, 1);
+                glUniform1f(blurMaxBlur, quality->maxBlur);
+                glUniform1i(blurSamples, quality->blurSamples);
+                glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            }
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            sceneTexture = upscaleTarget.sceneTex;
+        }
+        
+        // Tone map into the upscaler input or the window, reading back
+        // the linear frame first if it is being captured
+        if (hdrRendered) {
+            bool ownTarget = (timeSliced || checkerboarded) && !postProcessed;
+            GLuint hdrFrame = ownTarget ? sceneTexture : hdrTarget.colorTex;
+            passTimerEnd(&passTimer);
+            passTimerBegin(&passTimer, PASS_TONEMAP);
+            if (hdrCapture.path && (hdrFrames == 0 || hdrCapture.issued < hdrFrames)) {
+                GLuint readFbo = !ownTarget ? hdrTarget.fbo
+                               : timeSliced ? reflectionTarget.fbo[historyWrite]
+                               : checkerTarget.historyFbo[checkerParity];
+                // The guide stays with the checkerboard history or the
+                // scene the post-processing started from
+                GLuint guideFbo = timeSliced || variableRated || stereoRendered ? 0
+                                : checkerboarded ? checkerTarget.historyFbo[checkerParity]
+                                : postProcessed ? postTarget.sceneFbo : hdrTarget.fbo;
+                hdrCaptureFrame(&hdrCapture, readFbo, guideFbo, renderWidth, renderHeight);
+            }
+            glBindFramebuffer(GL_FRAMEBUFFER, upscaling ? upscaleTarget.sceneFbo : 0);
+            glViewport(0, 0, renderWidth, renderHeight);
+            // An LDR frame gets the grade the fractal shader would give it
+            drawToneMap(&toneMap, hdrFrame, hdr ? exposure : 0.0f, hdr ? toneCurve : TONE_CURVE_CLASSIC);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            sceneTexture = upscaleTarget.sceneTex;
+            gradeSource = hdr ? hdrFrame : 0;
+            gradeWidth = renderWidth;
+            gradeHeight = renderHeight;
+        } else {
+            gradeSource = 0;
+        }
+        
+        glViewport(0, 0, windowWidth, windowHeight);
+        if (upscaling) {
+            passTimerEnd(&passTimer);
+            upscaleFrame(&upscalePasses, &upscaleTarget, sceneTexture, sharpness, &passTimer);
+        } else {
+            if ((timeSliced || checkerboarded) && !postProcessed && !hdrRendered) {
+                glUseProgram(copyProgram);
+                glBindTexture(GL_TEXTURE_2D, sceneTexture);
+                glUniform1i(copySource, 0);
+                glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            }
+            passTimerEnd(&passTimer);
+        }
+        passTimerEndFrame(&passTimer);
+        
+        if (timeSliced) {
+            reflectionFrame++;
+            reflectionSlice = (reflectionSlice + 1) % reflectionSlices;
+            // The preview shader writes no history
+            reflectionHistoryValid = fullQuality;
+        }
+        if (checkerboarded) {
+            checkerParity ^= 1;
+            checkerHistoryValid = true;
+        }
+        postHistoryValid = postProcessed;
+        // Camera the history targets were rendered from
+        if (timeSliced || checkerboarded || postProcessed) {
+            prevCamPos[0] = camX;
+            prevCamPos[1] = camY;
+            prevCamPos[2] = camZ;
+            memcpy(prevRotation, rotMat, sizeof(prevRotation));
+        }
         glBindVertexArray(0);
         
+        // Export the frame before it is swapped away
+        if (frameShare.name) {
+            frameShareFrame(&frameShare, windowWidth, windowHeight, colorPalette, time, camPos, rotMat);
+        }
+        
         // Swap buffers
         SDL_GL_SwapWindow(window);
         
+        // Write out the HDR frames that have been read back
+        if (hdrCapture.path) {
+            hdrCapturePoll(&hdrCapture, false);
+            if (hdrCapture.failed) {
+                exitCode = 1;
+                running = false;
+            } else if (hdrFrames > 0 && hdrCapture.issued == hdrFrames) {
+                running = false;
+            }
+        }
+        
+        if (!firstFrameLogged || (fullQuality && !fullQualityLogged)) {
+            double sinceLaunch = (SDL_GetPerformanceCounter() - launchTick) * 1000.0 / perfFrequency;
+            if (!firstFrameLogged) {
+                printf("\nTime to first frame: %.0f ms (%s)\n", sinceLaunch, fullQuality ? "full quality" : "preview");
+                firstFrameLogged = true;
+            }
+            if (fullQuality && !fullQualityLogged) {
+                printf("Time to full quality: %.0f ms\n", sinceLaunch);
+                fullQualityLogged = true;
+            }
+        }
+        
         // FPS counter
         frameCount++;
         Uint32 currentTime = SDL_GetTicks();
         if (currentTime - lastFPSTime >= 1000) {
             fps = frameCount / ((currentTime - lastFPSTime) / 1000.0f);
-            printf("\rFPS: %.1f | Palette: %d | Camera: (%.2f, %.2f, %.2f)     ", 
-                   fps, colorPalette, camX, camY, camZ);
+            // Saving: the outer rings at full rate against the coarse
+            // passes and the blend that replace them
+            char rateSaving[64] = "";
+            if (passTimer.samples[PASS_RATE_PROBE] > 0) {
+                rateProbeMs = passTimerMean(&passTimer, PASS_RATE_PROBE);
+            }
+            if (variableRate && rateProbeMs > 0.0 && passTimer.samples[PASS_COMPOSITE] > 0) {
+                double savedMs = rateProbeMs - passTimerMean(&passTimer, PASS_RATE_HALF) -
+                                 passTimerMean(&passTimer, PASS_RATE_QUARTER) -
+                                 passTimerMean(&passTimer, PASS_COMPOSITE);
+                double fullMs = passTimerMean(&passTimer, PASS_SCENE) + rateProbeMs;
+                snprintf(rateSaving, sizeof(rateSaving), " | VRS saves %.1f ms (%.0f%%)", savedMs,
+                         100.0 * savedMs / fullMs);
+            }
+            char stereoHoles[48] = "";
+            if (stereo && stereoHoleFraction >= 0.0) {
+                snprintf(stereoHoles, sizeof(stereoHoles), " | right eye marched %.1f%%",
+                         100.0 * stereoHoleFraction);
+            }
+            char passTimes[256];
+            passTimerReport(&passTimer, passTimes, sizeof(passTimes));
+            printf("\rFPS: %.1f%s | Palette: %d | Camera: (%.2f, %.2f, %.2f)%s%s%s     ",
+                   fps, paused ? " (paused)" : "", colorPalette, camX, camY, camZ, passTimes, rateSaving,
+                   stereoHoles);
             fflush(stdout);
             frameCount = 0;
             lastFPSTime = currentTime;
         }
     }
     
+    if (animationDir && animationQueue.rendered > 0) {
+        double seconds = (SDL_GetPerformanceCounter() - animationStart) / (double)perfFrequency;
+        printf("\nAnimation: this worker wrote %d frames in %.1f s, %.2f s per frame\n", animationQueue.rendered,
+               seconds, seconds / animationQueue.rendered);
+    }
+    // An interrupted accumulation keeps what it has
+    if (accumulatePasses > 0 && checkpointPath && accumulatedPasses > checkpointedPasses) {
+        float rotation[9], position[3];
+        char header[CHECKPOINT_HEADER_SIZE];
+        animationCamera(0.0f, rotationSpeedMult, cameraOffsetX, cameraOffsetY, cameraDistance, rotation, position);
+        checkpointHeader(header, accumulateWidth, accumulateHeight, frameSettings, position, rotation,
+                         accumulatedPasses);
+        if (writeCheckpoint(checkpointPath, header, accumulationFbo, accumulateWidth, accumulateHeight)) {
+            printf("\nAccumulation: stopped after %d passes, saved to %s\n", accumulatedPasses, checkpointPath);
+        }
+    }
     printf("\n\nShutting down...\n");
     
     // Cleanup
+    closeAnimationQueue(&animationQueue);
+    glDeleteFramebuffers(1, &animationFbo);
+    glDeleteTextures(1, &animationTexture);
+    free(animationPixels);
+    if (tiled) tileSocketsQuit();
+    glDeleteFramebuffers(1, &accumulationFbo);
+    glDeleteTextures(1, &accumulationTexture);
+    destroyShaderCompiler(&compiler);
+    if (lightingVolume.texture) glDeleteTextures(1, &lightingVolume.texture);
+    if (hullTarget.fbo) destroyDepthTarget(&hullTarget);
+    if (reflectionTarget.fbo[0]) destroyReflectionTarget(&reflectionTarget);
+    glDeleteProgram(copyProgram);
+    if (upscaleTarget.sceneFbo) destroyUpscaleTarget(&upscaleTarget);
+    glDeleteProgram(upscalePasses.upscaleProgram);
+    glDeleteProgram(upscalePasses.sharpenProgram);
+    destroyPassTimer(&passTimer);
+    if (checkerTarget.fieldFbo) destroyCheckerboardTarget(&checkerTarget);
+    glDeleteProgram(checkerProgram);
+    if (rateTarget.fbo[0]) destroyRateTarget(&rateTarget);
+    glDeleteProgram(compositeProgram);
+    if (stereoTarget.fbo[0]) destroyStereoTarget(&stereoTarget);
+    glDeleteProgram(stereoProgram);
+    glDeleteQueries(1, &stereoHoleQuery);
+    if (postTarget.sceneFbo) destroyPostTarget(&postTarget);
+    glDeleteProgram(velocityProgram);
+    glDeleteProgram(dofProgram);
+    glDeleteProgram(blurProgram);
+    glDeleteProgram(featureProgram);
+    glDeleteProgram(atrousProgram);
+    if (hdrTarget.fbo) destroyHdrTarget(&hdrTarget);
+    if (msaaTarget.fbo) destroyMsaaTarget(&msaaTarget);
+    destroyHdrCapture(&hdrCapture);
+    destroyFrameShare(&frameShare);
+    closePlayback(&playback);
+    glDeleteProgram(toneMap.program);
+    if (blueNoiseTexture) glDeleteTextures(1, &blueNoiseTexture);
+    glDeleteVertexArrays(1, &hullVao);
+    glDeleteBuffers(1, &hullVbo);
+    glDeleteProgram(hullProgram);
     glDeleteVertexArrays(1, &vao);
     glDeleteBuffers(1, &vbo);
     glDeleteProgram(shaderProgram);
@@ -711,6 +6629,6 @@ int main(int argc, char* argv[]) {
     SDL_DestroyWindow(window);
     SDL_Quit();
     
-    return 0;
+    return exitCode;
 
 }
\ No newline at end of file
@@ -0,0 +1,111 @@
+/*
+ * Sparse voxel brick format for the Sierpinski tetrahedron volume
+ *
+ * The volume is a narrow-band distance field sampled at voxel centers of
+ * a resolution^3 grid over [boundsMin, boundsMin + resolution * voxelSize]^3.
+ * Only bricks of SVX_BRICK_SIZE^3 voxels that come near the surface are
+ * stored. The file is laid out for memory mapping:
+ *
+ *   SVXHeader                      at offset 0
+ *   uint8_t[brickCount][512]       at dataOffset
+ *   SVXBrickEntry[brickCount]      at indexOffset, sorted by Morton code,
+ *                                  entry i describing brick i of the data
+ *
+ * Both offsets are multiples of SVX_ALIGNMENT. The index follows the
+ * data so writers can stream bricks out before the count is known. Inside a brick voxels are
+ * stored x fastest, then y, then z. A voxel holds the distance to the
+ * surface in units of voxelSize / distanceScale, saturated at 255; voxels
+ * of bricks that are not in the index are farther than the band.
+ * All fields are little-endian.
+ */
+
+#ifndef SPARSE_VOXELS_H
+#define SPARSE_VOXELS_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define SVX_MAGIC "SIERVOX1"
+#define SVX_VERSION 1
+#define SVX_BRICK_SIZE 8
+#define SVX_BRICK_VOXELS (SVX_BRICK_SIZE * SVX_BRICK_SIZE * SVX_BRICK_SIZE)
+#define SVX_ALIGNMENT 4096
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t brickSize;
+    uint32_t resolution;      // voxels per axis
+    uint32_t iterations;      // DE iterations used for the export
+    uint64_t brickCount;
+    uint64_t indexOffset;
+    uint64_t dataOffset;
+    float boundsMin[3];
+    float voxelSize;
+    float distanceScale;      // stored value = distance / voxelSize * distanceScale
+    char kernel[32];          // DE kernel name from de_kernels.h
+    uint8_t reserved[28];     // pads the header to 128 bytes
+} SVXHeader;
+
+typedef struct {
+    uint64_t morton;          // svxMorton(x, y, z)
+    uint16_t x, y, z;         // brick coordinates
+    uint16_t reserved;
+} SVXBrickEntry;
+
+// Interleaves the bits of brick coordinates, x in the lowest bit
+static inline uint64_t svxMorton(uint32_t x, uint32_t y, uint32_t z) {
+    uint64_t code = 0;
+    for (int bit = 0; bit < 21; bit++) {
+        code |= (uint64_t)((x >> bit) & 1u) << (3 * bit);
+        code |= (uint64_t)((y >> bit) & 1u) << (3 * bit + 1);
+        code |= (uint64_t)((z >> bit) & 1u) << (3 * bit + 2);
+    }
+    return code;
+}
+
+// Brick data for brick (bx, by, bz) of a mapped file, NULL if empty
+static inline const uint8_t* svxFindBrick(const void* file, uint32_t bx, uint32_t by, uint32_t bz) {
+    const SVXHeader* header = (const SVXHeader*)file;
+    const SVXBrickEntry* index = (const SVXBrickEntry*)((const uint8_t*)file + header->indexOffset);
+    uint64_t key = svxMorton(bx, by, bz);
+    uint64_t lo = 0, hi = header->brickCount;
+
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (index[mid].morton < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo == header->brickCount || index[lo].morton != key) {
+        return NULL;
+    }
+    return (const uint8_t*)file + header->dataOffset + lo * SVX_BRICK_VOXELS;
+}
+
+// Stored distance of voxel (x, y, z) in world units, or -1 if the voxel
+// is outside the band
+static inline float svxVoxelDistance(const void* file, uint32_t x, uint32_t y, uint32_t z) {
+    const SVXHeader* header = (const SVXHeader*)file;
+    const uint8_t* brick = svxFindBrick(file, x / SVX_BRICK_SIZE, y / SVX_BRICK_SIZE, z / SVX_BRICK_SIZE);
+    if (!brick) {
+        return -1.0f;
+    }
+    uint32_t i = ((z % SVX_BRICK_SIZE) * SVX_BRICK_SIZE + (y % SVX_BRICK_SIZE)) * SVX_BRICK_SIZE +
+                 (x % SVX_BRICK_SIZE);
+    return (float)brick[i] * header->voxelSize / header->distanceScale;
+}
+
+static inline int svxValidHeader(const void* file, uint64_t fileSize) {
+    const SVXHeader* header = (const SVXHeader*)file;
+    return fileSize >= sizeof(SVXHeader) &&
+           memcmp(header->magic, SVX_MAGIC, 8) == 0 &&
+           header->version == SVX_VERSION &&
+           header->brickSize == SVX_BRICK_SIZE &&
+           header->indexOffset + header->brickCount * sizeof(SVXBrickEntry) <= fileSize &&
+           header->dataOffset + header->brickCount * SVX_BRICK_VOXELS <= fileSize;
+}
+
+#endif // SPARSE_VOXELS_H
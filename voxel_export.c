@@ -0,0 +1,429 @@
+/*
+ * Sparse Voxel Exporter for the Sierpinski Tetrahedron
+ * Samples a distance-estimator kernel into the narrow-band brick format
+ * of sparse_voxels.h
+ *
+ * - The grid is split into top-level cells in Morton order, handed out
+ *   to worker threads through an atomic counter
+ * - Each cell is refined as an octree down to 8^3 bricks; a cell is
+ *   skipped as soon as the (safety-scaled) DE at its center proves it
+ *   lies farther than the band, so empty space costs one evaluation
+ * - Surviving bricks are sampled at every voxel and kept if any voxel
+ *   is within the band
+ *
+ * Because every cell emits bricks in Morton order and cells are written
+ * in Morton order, the index comes out sorted without a sort step. The
+ * main thread streams each finished cell's voxels to disk in that order
+ * and frees them, so memory holds the index plus the cells that finished
+ * ahead of the write position.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <SDL2/SDL.h>
+#include "de_kernels.h"
+#include "sparse_voxels.h"
+
+#define VOXEL_EXTENT 1.1f         // volume covers [-1.1, 1.1]^3
+#define VOXEL_DE_SAFETY 0.5f      // same factor as sierpinski_enhanced.c
+#define VOXEL_BAND 2.0f           // keep voxels within this many voxels of the surface
+#define VOXEL_DISTANCE_SCALE 32.0f
+#define VOXEL_TOP_CELLS 8         // top-level cells per axis
+#define MAX_THREADS 64
+
+typedef struct {
+    int kernel;
+    int resolution;
+    int iterations;
+    int threads;
+    const char* outputPath;
+    bool verify;
+} ExportOptions;
+
+// Output of one top-level cell, bricks in Morton order
+typedef struct {
+    SVXBrickEntry* entries;
+    uint8_t* voxels;
+    size_t count;
+    size_t capacity;
+    bool failed;
+    SDL_atomic_t done;
+} CellOutput;
+
+typedef struct {
+    const ExportOptions* opt;
+    const DEKernel* kernel;
+    float voxelSize;
+    int cellBricks;           // bricks per axis in a top-level cell
+    int cellsPerAxis;
+    int cellCount;
+    CellOutput* cells;
+    SDL_atomic_t nextCell;
+    SDL_atomic_t liveBricks;  // brick slots allocated and not yet written
+    long long evaluations[MAX_THREADS];
+} ExportJob;
+
+typedef struct {
+    ExportJob* job;
+    int index;
+} ExportWorker;
+
+static double nowSeconds(void) {
+    return (double)SDL_GetPerformanceCounter() / (double)SDL_GetPerformanceFrequency();
+}
+
+// Inverse of svxMorton for small codes
+static void mortonDecode(uint32_t code, uint32_t* x, uint32_t* y, uint32_t* z) {
+    *x = *y = *z = 0;
+    for (int bit = 0; bit < 10; bit++) {
+        *x |= ((code >> (3 * bit)) & 1u) << bit;
+        *y |= ((code >> (3 * bit + 1)) & 1u) << bit;
+        *z |= ((code >> (3 * bit + 2)) & 1u) << bit;
+    }
+}
+
+static float voxelDistance(const ExportJob* job, float x, float y, float z) {
+    DEVec3 p = {x, y, z};
+    return VOXEL_DE_SAFETY * job->kernel->evaluate(p, job->opt->iterations);
+}
+
+static bool cellAppend(ExportJob* job, CellOutput* out, uint32_t bx, uint32_t by, uint32_t bz,
+                       const uint8_t* voxels) {
+    if (out->count == out->capacity) {
+        size_t capacity = out->capacity ? out->capacity * 2 : 64;
+        SVXBrickEntry* entries = (SVXBrickEntry*)realloc(out->entries, capacity * sizeof(SVXBrickEntry));
+        if (entries) out->entries = entries;
+        uint8_t* data = entries ? (uint8_t*)realloc(out->voxels, capacity * SVX_BRICK_VOXELS) : NULL;
+        if (!entries || !data) {
+            out->failed = true;
+            return false;
+        }
+        out->voxels = data;
+        SDL_AtomicAdd(&job->liveBricks, (int)(capacity - out->capacity));
+        out->capacity = capacity;
+    }
+
+    SVXBrickEntry* e = &out->entries[out->count];
+    e->morton = svxMorton(bx, by, bz);
+    e->x = (uint16_t)bx;
+    e->y = (uint16_t)by;
+    e->z = (uint16_t)bz;
+    e->reserved = 0;
+    memcpy(out->voxels + out->count * SVX_BRICK_VOXELS, voxels, SVX_BRICK_VOXELS);
+    out->count++;
+    return true;
+}
+
+// Samples brick (bx, by, bz); keeps it if any voxel is within the band
+static void sampleBrick(ExportJob* job, CellOutput* out, uint32_t bx, uint32_t by, uint32_t bz,
+                        long long* evaluations) {
+    const float v = job->voxelSize;
+    const float band = VOXEL_BAND * v;
+    uint8_t voxels[SVX_BRICK_VOXELS];
+    bool keep = false;
+    int i = 0;
+
+    for (int z = 0; z < SVX_BRICK_SIZE; z++) {
+        float pz = -VOXEL_EXTENT + ((float)(bz * SVX_BRICK_SIZE + z) + 0.5f) * v;
+        for (int y = 0; y < SVX_BRICK_SIZE; y++) {
+            float py = -VOXEL_EXTENT + ((float)(by * SVX_BRICK_SIZE + y) + 0.5f) * v;
+            for (int x = 0; x < SVX_BRICK_SIZE; x++, i++) {
+                float px = -VOXEL_EXTENT + ((float)(bx * SVX_BRICK_SIZE + x) + 0.5f) * v;
+                float d = voxelDistance(job, px, py, pz);
+                float q = d / v * VOXEL_DISTANCE_SCALE;
+                voxels[i] = (uint8_t)(q < 255.0f ? q + 0.5f : 255.0f);
+                keep |= d <= band;
+            }
+        }
+    }
+    *evaluations += SVX_BRICK_VOXELS;
+    if (keep) cellAppend(job, out, bx, by, bz, voxels);
+}
+
+// Octree refinement of the cube of `size` bricks at brick (bx, by, bz),
+// children visited in Morton order
+static void refineCell(ExportJob* job, CellOutput* out, uint32_t bx, uint32_t by, uint32_t bz,
+                       uint32_t size, long long* evaluations) {
+    const float v = job->voxelSize;
+    float halfSize = 0.5f * (float)(size * SVX_BRICK_SIZE) * v;
+    float cx = -VOXEL_EXTENT + (float)(bx * SVX_BRICK_SIZE) * v + halfSize;
+    float cy = -VOXEL_EXTENT + (float)(by * SVX_BRICK_SIZE) * v + halfSize;
+    float cz = -VOXEL_EXTENT + (float)(bz * SVX_BRICK_SIZE) * v + halfSize;
+
+    // Every voxel center is within halfSize * sqrt(3) of the cell center
+    (*evaluations)++;
+    if (voxelDistance(job, cx, cy, cz) > halfSize * 1.7320508f + VOXEL_BAND * v) {
+        return;
+    }
+    if (size == 1) {
+        sampleBrick(job, out, bx, by, bz, evaluations);
+        return;
+    }
+
+    uint32_t h = size / 2;
+    for (uint32_t child = 0; child < 8 && !out->failed; child++) {
+        refineCell(job, out, bx + (child & 1u) * h, by + ((child >> 1) & 1u) * h,
+                   bz + ((child >> 2) & 1u) * h, h, evaluations);
+    }
+}
+
+static int exportWorkerRun(void* data) {
+    ExportWorker* w = (ExportWorker*)data;
+    ExportJob* job = w->job;
+    long long evaluations = 0;
+    int cell;
+
+    while ((cell = SDL_AtomicAdd(&job->nextCell, 1)) < job->cellCount) {
+        uint32_t cx, cy, cz;
+        mortonDecode((uint32_t)cell, &cx, &cy, &cz);
+        refineCell(job, &job->cells[cell], cx * job->cellBricks, cy * job->cellBricks,
+                   cz * job->cellBricks, (uint32_t)job->cellBricks, &evaluations);
+        SDL_AtomicSet(&job->cells[cell].done, 1);
+    }
+    job->evaluations[w->index] = evaluations;
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// File output
+// ---------------------------------------------------------------------------
+
+static uint64_t alignUp(uint64_t value) {
+    return (value + SVX_ALIGNMENT - 1) / SVX_ALIGNMENT * SVX_ALIGNMENT;
+}
+
+static bool writePadding(FILE* file, uint64_t from, uint64_t to) {
+    static const uint8_t zeros[SVX_ALIGNMENT] = {0};
+    return to == from || fwrite(zeros, 1, (size_t)(to - from), file) == to - from;
+}
+
+// Streams the voxels of each cell to disk as soon as it and every cell
+// before it are done, then appends the index and writes the header.
+// Reports the largest number of brick slots held at once.
+static bool writeVolume(ExportJob* job, uint64_t* brickCount, uint64_t* fileSize, int* peakBricks) {
+    const ExportOptions* opt = job->opt;
+    SVXHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SVX_MAGIC, 8);
+    header.version = SVX_VERSION;
+    header.brickSize = SVX_BRICK_SIZE;
+    header.resolution = (uint32_t)opt->resolution;
+    header.iterations = (uint32_t)opt->iterations;
+    header.dataOffset = alignUp(sizeof(SVXHeader));
+    header.boundsMin[0] = header.boundsMin[1] = header.boundsMin[2] = -VOXEL_EXTENT;
+    header.voxelSize = job->voxelSize;
+    header.distanceScale = VOXEL_DISTANCE_SCALE;
+    strncpy(header.kernel, job->kernel->name, sizeof(header.kernel) - 1);
+
+    // Write to a temporary name and rename, so readers never map a partial file
+    char tempPath[1024];
+    snprintf(tempPath, sizeof(tempPath), "%s.tmp", opt->outputPath);
+    FILE* file = fopen(tempPath, "wb");
+    if (!file) {
+        fprintf(stderr, "Could not open %s for writing\n", tempPath);
+        return false;
+    }
+
+    // Placeholder header, rewritten once the counts are known
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              writePadding(file, sizeof(header), header.dataOffset);
+    uint64_t count = 0;
+    *peakBricks = 0;
+    for (int c = 0; c < job->cellCount; c++) {
+        CellOutput* cell = &job->cells[c];
+        for (;;) {
+            int live = SDL_AtomicGet(&job->liveBricks);
+            if (live > *peakBricks) *peakBricks = live;
+            if (SDL_AtomicGet(&cell->done)) break;
+            SDL_Delay(1);
+        }
+        ok = ok && !cell->failed &&
+             fwrite(cell->voxels, SVX_BRICK_VOXELS, cell->count, file) == cell->count;
+        count += cell->count;
+        free(cell->voxels);
+        cell->voxels = NULL;
+        SDL_AtomicAdd(&job->liveBricks, -(int)cell->capacity);
+    }
+
+    header.brickCount = count;
+    header.indexOffset = alignUp(header.dataOffset + count * SVX_BRICK_VOXELS);
+    ok = ok && writePadding(file, header.dataOffset + count * SVX_BRICK_VOXELS, header.indexOffset);
+    for (int c = 0; c < job->cellCount && ok; c++) {
+        const CellOutput* cell = &job->cells[c];
+        ok = fwrite(cell->entries, sizeof(SVXBrickEntry), cell->count, file) == cell->count;
+    }
+    ok = ok && fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = (fclose(file) == 0) && ok;
+
+    if (ok) {
+        remove(opt->outputPath);
+        ok = rename(tempPath, opt->outputPath) == 0;
+    }
+    if (!ok) {
+        fprintf(stderr, "Failed to write %s\n", opt->outputPath);
+        remove(tempPath);
+    }
+    *brickCount = count;
+    *fileSize = header.indexOffset + count * sizeof(SVXBrickEntry);
+    return ok;
+}
+
+// Reads the file back and compares every in-band voxel of a dense
+// evaluation with the stored bricks; only practical for small grids
+static bool verifyVolume(const ExportJob* job, uint64_t fileSize) {
+    const ExportOptions* opt = job->opt;
+    FILE* file = fopen(opt->outputPath, "rb");
+    uint8_t* data = (uint8_t*)malloc((size_t)fileSize);
+    bool ok = file && data && fread(data, 1, (size_t)fileSize, file) == fileSize &&
+              svxValidHeader(data, fileSize);
+    if (file) fclose(file);
+    if (!ok) {
+        fprintf(stderr, "Verify: could not read back %s\n", opt->outputPath);
+        free(data);
+        return false;
+    }
+
+    const float v = job->voxelSize;
+    const float tolerance = 0.5f * v / VOXEL_DISTANCE_SCALE + 1e-6f;
+    long long inBand = 0, missing = 0, wrong = 0;
+    for (int z = 0; z < opt->resolution; z++) {
+        for (int y = 0; y < opt->resolution; y++) {
+            for (int x = 0; x < opt->resolution; x++) {
+                float d = voxelDistance(job, -VOXEL_EXTENT + (x + 0.5f) * v, -VOXEL_EXTENT + (y + 0.5f) * v,
+                                        -VOXEL_EXTENT + (z + 0.5f) * v);
+                float stored = svxVoxelDistance(data, (uint32_t)x, (uint32_t)y, (uint32_t)z);
+                if (d > VOXEL_BAND * v) continue;
+                inBand++;
+                if (stored < 0.0f) {
+                    missing++;
+                } else if (fabsf(stored - d) > tolerance) {
+                    wrong++;
+                }
+            }
+        }
+    }
+    free(data);
+
+    printf("Verify: %lld in-band voxels, %lld missing, %lld with wrong values\n", inBand, missing, wrong);
+    return missing == 0 && wrong == 0;
+}
+
+// ---------------------------------------------------------------------------
+// Driver
+// ---------------------------------------------------------------------------
+
+static void printUsage(const char* prog) {
+    fprintf(stderr, "Usage: %s [options]\n", prog);
+    fprintf(stderr, "  --resolution N    Voxels per axis, a power of two >= 64 (default 1024)\n");
+    fprintf(stderr, "  --kernel NAME     DE kernel (default plane-fold)\n");
+    fprintf(stderr, "  --iterations N    DE iterations (default log2(resolution) + 1)\n");
+    fprintf(stderr, "  --threads N       Worker threads (default: CPU count)\n");
+    fprintf(stderr, "  --output FILE     Output path (default sierpinski.svx)\n");
+    fprintf(stderr, "  --verify          Compare against a dense evaluation (resolution <= 512)\n");
+    fprintf(stderr, "Kernels:\n");
+    deKernelPrintList(stderr);
+}
+
+int main(int argc, char* argv[]) {
+    ExportOptions opt = {deKernelFind("plane-fold"), 1024, 0, SDL_GetCPUCount(), "sierpinski.svx", false};
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--resolution") == 0 && i + 1 < argc) {
+            opt.resolution = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--kernel") == 0 && i + 1 < argc) {
+            opt.kernel = deKernelFind(argv[++i]);
+        } else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            opt.iterations = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            opt.threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            opt.outputPath = argv[++i];
+        } else if (strcmp(argv[i], "--verify") == 0) {
+            opt.verify = true;
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    bool powerOfTwo = opt.resolution > 0 && (opt.resolution & (opt.resolution - 1)) == 0;
+    int maxResolution = SVX_BRICK_SIZE * 65536;
+    if (!powerOfTwo || opt.resolution < 64 || opt.resolution > maxResolution || opt.kernel < 0 ||
+        opt.threads < 1 || opt.threads > MAX_THREADS || opt.iterations < 0 ||
+        (opt.verify && opt.resolution > 512)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    if (opt.iterations == 0) {
+        int log2Resolution = 0;
+        while ((1 << log2Resolution) < opt.resolution) log2Resolution++;
+        opt.iterations = log2Resolution + 1;
+    }
+
+    ExportJob job;
+    memset(&job, 0, sizeof(job));
+    job.opt = &opt;
+    job.kernel = &deKernels[opt.kernel];
+    job.voxelSize = 2.0f * VOXEL_EXTENT / (float)opt.resolution;
+    int bricksPerAxis = opt.resolution / SVX_BRICK_SIZE;
+    job.cellsPerAxis = bricksPerAxis < VOXEL_TOP_CELLS ? bricksPerAxis : VOXEL_TOP_CELLS;
+    job.cellBricks = bricksPerAxis / job.cellsPerAxis;
+    job.cellCount = job.cellsPerAxis * job.cellsPerAxis * job.cellsPerAxis;
+    job.cells = (CellOutput*)calloc((size_t)job.cellCount, sizeof(CellOutput));
+    if (!job.cells) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    printf("Sparse voxel export: %d^3 voxels (%d^3 bricks of %d^3), kernel %s, %d iterations, %d threads\n",
+           opt.resolution, bricksPerAxis, SVX_BRICK_SIZE, job.kernel->name, opt.iterations, opt.threads);
+
+    SDL_Thread* threads[MAX_THREADS];
+    ExportWorker workers[MAX_THREADS];
+    double start = nowSeconds();
+    for (int t = 0; t < opt.threads; t++) {
+        workers[t].job = &job;
+        workers[t].index = t;
+        threads[t] = SDL_CreateThread(exportWorkerRun, "voxels", &workers[t]);
+        if (!threads[t]) exportWorkerRun(&workers[t]);
+    }
+
+    // Sampling and writing overlap; the writer follows the workers in Morton order
+    uint64_t brickCount = 0, fileSize = 0;
+    int peakBricks = 0;
+    bool ok = writeVolume(&job, &brickCount, &fileSize, &peakBricks);
+    long long evaluations = 0;
+    for (int t = 0; t < opt.threads; t++) {
+        if (threads[t]) SDL_WaitThread(threads[t], NULL);
+        evaluations += job.evaluations[t];
+    }
+    double seconds = nowSeconds() - start;
+
+    double denseBricks = (double)bricksPerAxis * bricksPerAxis * bricksPerAxis;
+    double denseVoxels = (double)opt.resolution * opt.resolution * opt.resolution;
+    printf("Sampled in %.2f s: %.1f M DE evaluations (%.2f%% of dense), %.1f M evals/s\n",
+           seconds, evaluations / 1e6, 100.0 * evaluations / denseVoxels, evaluations / seconds / 1e6);
+    printf("Bricks: %llu of %.0f (%.3f%%)\n",
+           (unsigned long long)brickCount, denseBricks, 100.0 * brickCount / denseBricks);
+    printf("Memory: %.1f MiB index + %.1f MiB peak brick buffers\n",
+           brickCount * sizeof(SVXBrickEntry) / (1024.0 * 1024.0),
+           peakBricks * (double)(SVX_BRICK_VOXELS + sizeof(SVXBrickEntry)) / (1024.0 * 1024.0));
+    if (ok) {
+        printf("Wrote %s: %.1f MiB (dense 8-bit volume: %.1f MiB)\n", opt.outputPath,
+               fileSize / (1024.0 * 1024.0), denseVoxels / (1024.0 * 1024.0));
+    }
+    if (ok && opt.verify) {
+        ok = verifyVolume(&job, fileSize);
+    }
+
+    for (int c = 0; c < job.cellCount; c++) {
+        free(job.cells[c].entries);
+        free(job.cells[c].voxels);
+    }
+    free(job.cells);
+    return ok ? 0 : 1;
+}